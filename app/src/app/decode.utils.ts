@@ -10,6 +10,7 @@ import {
   WiFiConnectionDetails,
   WiFiDetails,
   WiFiEncryptionType,
+  WIFI_SCAN_RESULT_VERSION,
   WiFiNetwork,
   WiFiPhaseTwoType,
   WiFiScanStatus,
@@ -23,7 +24,10 @@ import {
   WebSocketMessageType,
   WebSocketDeviceNameMessage,
   WebSocketOtaProgressMessage,
-  WebSocketHeapInfoMessage
+  WebSocketHeapInfoMessage,
+  WebSocketPowerStateMessage,
+  WebSocketWiFiScanResultMessage,
+  WebSocketWiFiScanStatusMessage
 } from './websocket.message';
 import {LightState} from '../app/light.model';
 
@@ -50,6 +54,11 @@ class BufferReader {
     return this.buffer[this.offset++];
   }
 
+  readInt8(): number {
+    const value = this.buffer[this.offset++];
+    return value > 127 ? value - 256 : value;
+  }
+
   readUint32(): number {
     const value =
       this.buffer[this.offset] |
@@ -92,15 +101,29 @@ export function decodeWiFiDetails(buffer: Uint8Array): WiFiDetails {
   return {ssid, mac, ip, gateway, subnet, dns};
 }
 
+// Firmware before the versioned layout sent a count and 15 x (encryption type, SSID).
+const LEGACY_WIFI_SCAN_RESULT_LENGTH = 1 + 15 * (1 + WIFI_SSID_MAX_LENGTH + 1);
+
 export function decodeWiFiScanResult(buffer: Uint8Array): WiFiNetwork[] {
   const reader = new BufferReader(buffer);
+  const versioned = buffer.length !== LEGACY_WIFI_SCAN_RESULT_LENGTH && buffer[0] === WIFI_SCAN_RESULT_VERSION;
+  if (versioned) {
+    reader.readByte();
+  }
   const resultCount = reader.readByte();
   const networks: WiFiNetwork[] = [];
 
   for (let i = 0; i < resultCount; i++) {
     const encryptionType = reader.readByte() as WiFiEncryptionType;
     const ssid = reader.readCString(WIFI_SSID_MAX_LENGTH + 1);
-    networks.push({ssid, encryptionType});
+    if (versioned) {
+      const rssi = reader.readInt8();
+      const channel = reader.readByte();
+      const bssidCount = reader.readByte();
+      networks.push({ssid, encryptionType, rssi, channel, bssidCount});
+    } else {
+      networks.push({ssid, encryptionType});
+    }
   }
   return networks;
 }
@@ -211,3 +234,21 @@ export function decodeWebSocketHeapInfoMessage(buffer: ArrayBuffer): WebSocketHe
     freeHeap
   };
 }
+
+export function decodeWebSocketWiFiScanStatusMessage(buffer: ArrayBuffer): WebSocketWiFiScanStatusMessage {
+  const data = new Uint8Array(buffer);
+  return {type: WebSocketMessageType.ON_WIFI_SCAN_STATUS, status: decodeWiFiScanStatus(data.subarray(1))};
+}
+
+export function decodeWebSocketWiFiScanResultMessage(buffer: ArrayBuffer): WebSocketWiFiScanResultMessage {
+  const data = new Uint8Array(buffer);
+  return {type: WebSocketMessageType.ON_WIFI_SCAN_RESULT, networks: decodeWiFiScanResult(data.subarray(1))};
+}
+
+export function decodeWebSocketPowerStateMessage(buffer: ArrayBuffer): WebSocketPowerStateMessage {
+  const data = new Uint8Array(buffer);
+  if (data.length !== 3) {
+    throw new Error(`Invalid power state message length: ${data.length}`);
+  }
+  return {type: WebSocketMessageType.ON_POWER_PROFILE, profile: data[1], effective: data[2]};
+}
@@ -19,6 +19,7 @@ import {
 } from './wifi.model';
 import {BleStatus} from './ble.model';
 import {LightState} from './light.model';
+import {PowerProfile} from './power.model';
 
 export const textEncoder = new TextEncoder();
 
@@ -153,6 +154,10 @@ export function encodeWiFiScanStatusMessage(): Uint8Array {
   return new Uint8Array([WebSocketMessageType.ON_WIFI_SCAN_STATUS]);
 }
 
+export function encodePowerProfileMessage(profile: PowerProfile): Uint8Array {
+  return new Uint8Array([WebSocketMessageType.ON_POWER_PROFILE, profile]);
+}
+
 export function encodeOtaProgressMessage(): Uint8Array {
   return new Uint8Array([WebSocketMessageType.ON_OTA_PROGRESS]);
 }
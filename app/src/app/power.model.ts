@@ -0,0 +1,10 @@
+export enum PowerProfile {
+  LOW_LATENCY = 0,
+  BALANCED = 1,
+  LOW_POWER = 2
+}
+
+export interface PowerState {
+  profile: PowerProfile;
+  effective: PowerProfile; // LOW_LATENCY while a color stream or an OTA update boosts the device
+}
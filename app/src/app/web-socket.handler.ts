@@ -7,12 +7,14 @@ import {
   encodeHeapMessage,
   encodeHttpCredentialsMessage,
   encodeOtaProgressMessage,
+  encodePowerProfileMessage,
   encodeWiFiConnectionDetailsMessage,
   encodeWiFiScanStatusMessage,
 } from "./encode.utils";
 import {} from "./decode.utils";
 import {WebSocketMessageType} from "./websocket.message";
 import {WiFiConnectionDetails} from "./wifi.model";
+import {PowerProfile} from "./power.model";
 
 const RECONNECT_INTERVAL = 1000; // ms
 
@@ -119,3 +121,8 @@ export function sendOtaProgressRequest(): void {
   const buffer = encodeOtaProgressMessage();
   send(buffer);
 }
+
+export function sendPowerProfile(profile: PowerProfile): void {
+  const buffer = encodePowerProfileMessage(profile);
+  send(buffer);
+}
@@ -1,9 +1,10 @@
 import {AlexaIntegrationSettings} from "./alexa-integration-settings.model";
 import {HttpCredentials} from "./http-credentials.model";
-import {WiFiConnectionDetails, WiFiScanStatus, WiFiStatus} from "./wifi.model";
+import {WiFiConnectionDetails, WiFiNetwork, WiFiScanStatus, WiFiStatus} from "./wifi.model";
 import {BleStatus} from './ble.model';
 import {LightState} from './light.model';
 import {OtaState} from './ota.model';
+import {PowerState} from './power.model';
 
 export enum WebSocketMessageType {
   ON_COLOR = 0,
@@ -16,6 +17,8 @@ export enum WebSocketMessageType {
   ON_WIFI_DETAILS = 7,
   ON_OTA_PROGRESS = 8,
   ON_ALEXA_INTEGRATION_SETTINGS = 9,
+  ON_WIFI_SCAN_RESULT = 10,
+  ON_POWER_PROFILE = 11,
 }
 
 export interface WebSocketColorMessage {
@@ -63,6 +66,15 @@ export interface WebSocketWiFiScanStatusMessage {
   status: WiFiScanStatus;
 }
 
+export interface WebSocketWiFiScanResultMessage {
+  type: WebSocketMessageType.ON_WIFI_SCAN_RESULT;
+  networks: WiFiNetwork[];
+}
+
+export interface WebSocketPowerStateMessage extends PowerState {
+  type: WebSocketMessageType.ON_POWER_PROFILE;
+}
+
 export interface WebSocketOtaProgressMessage extends OtaState {
   type: WebSocketMessageType.ON_OTA_PROGRESS;
 }
@@ -77,4 +89,6 @@ export type WebSocketMessage =
   | WebSocketHeapInfoMessage
   | WebSocketWiFiStatusMessage
   | WebSocketWiFiScanStatusMessage
+  | WebSocketWiFiScanResultMessage
+  | WebSocketPowerStateMessage
   | WebSocketOtaProgressMessage;
@@ -55,9 +55,14 @@ export enum WiFiPhaseTwoType {
   ESP_EAP_TTLS_PHASE2_CHAP
 }
 
+export const WIFI_SCAN_RESULT_VERSION = 2;
+
 export interface WiFiNetwork {
   ssid: string;
   encryptionType: WiFiEncryptionType;
+  rssi?: number;       // dBm of the strongest access point, absent in unversioned results
+  channel?: number;
+  bssidCount?: number; // access points advertising the SSID
 }
 
 export interface WiFiDetails {
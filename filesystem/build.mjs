@@ -1,38 +1,51 @@
-import {createGzip} from 'zlib';
-import {pipeline} from 'stream';
-import {createReadStream, createWriteStream} from 'fs';
-import {mkdir, readdir, stat, rm} from 'fs/promises';
-import {promisify} from 'util';
+import {brotliCompressSync, gzipSync, constants} from 'zlib';
+import {createHash} from 'crypto';
+import {readdir, readFile, stat, writeFile} from 'fs/promises';
 import {execSync} from 'child_process';
 import path from 'path';
 
-const pipe = promisify(pipeline);
-
 const sourceDir = path.resolve('./dist');
-const outputDir = path.resolve('../firmware/data');
+const outputFile = path.resolve('../firmware/assets.bin');
+const manifestFile = path.resolve('../firmware/assets.manifest.json');
+const partitionsFile = path.resolve('../firmware/partitions.csv');
+const partitionName = 'assets';
+
+// Must match AssetBundleHeader / AssetBundleEntry in firmware/include/asset_bundle.hh
+const BUNDLE_MAGIC = 0x42415752;
+const BUNDLE_VERSION = 2;
+const HEADER_SIZE = 16;
+const ENTRY_SIZE = 80;
+const MAX_PATH_LENGTH = 47;
+const MAX_ETAG_LENGTH = 19;
+const ENCODING_GZIP = 1;
+const ENCODING_BROTLI = 2;
+const FLAG_IMMUTABLE = 0x01;
 
 try {
     console.log('📦 Building resources with Vite...');
     execSync('npm run build:vite', {stdio: 'inherit'});
 
-    await ensureOutputDir();
-    const contentFiles = await getFilesToCompress(sourceDir);
+    const files = await getFilesToBundle(sourceDir);
+    const manifest = fingerprintFiles(files);
+    const assets = (await Promise.all(files.map(compressFile))).flat();
+    const bundle = createBundle(assets);
+
+    const partitionSize = await getPartitionSize(partitionName);
+    if (bundle.length > partitionSize) {
+        throw new Error(`Bundle is ${bundle.length} bytes, partition '${partitionName}' holds ${partitionSize}`);
+    }
 
-    await Promise.all(contentFiles.map(file => compressFile(file.input, file.output, file.name)));
-    console.log('✔ All files compressed successfully!');
-    console.log('Go to firmware/data to find the compressed files.');
-    console.log('Use platformio to upload the files to your device.');
+    await writeFile(outputFile, bundle);
+    await writeFile(manifestFile, JSON.stringify(manifest, null, 2) + '\n');
+    console.log(`✔ Asset manifest written → ${manifestFile}`);
+    console.log(`✔ Asset bundle written: ${(bundle.length / 1024).toFixed(2)}KB of ${(partitionSize / 1024).toFixed(2)}KB → ${outputFile}`);
+    console.log('Flash it with the OTA page (filesystem) or esptool.py write_flash at the assets partition offset.');
 } catch (err) {
-    console.error('✖ Failed during build or compression:', err);
+    console.error('✖ Failed during build or bundling:', err);
     process.exit(1);
 }
 
-async function ensureOutputDir() {
-    await rm(outputDir, {recursive: true, force: true});
-    await mkdir(outputDir, {recursive: true});
-}
-
-async function getFilesToCompress(dir) {
+async function getFilesToBundle(dir) {
     const entries = await readdir(dir);
     const files = [];
 
@@ -43,23 +56,121 @@ async function getFilesToCompress(dir) {
         if (!fileStat.isFile()) continue;
         if (entry.endsWith('.ts') || entry.endsWith('.tsx')) continue;
 
-        files.push({input: fullPath, output: path.join(outputDir, entry + '.gz'), name: entry});
+        files.push({path: '/' + entry, content: await readFile(fullPath)});
     }
 
     return files;
 }
 
-async function compressFile(input, output, name) {
-    try {
-        await pipe(
-            createReadStream(input),
-            createGzip(),
-            createWriteStream(output)
-        );
-        const {size} = await stat(output);
-        const kb = (size / 1024).toFixed(2);
-        console.log(`✔ Compressed: ${kb}KB ${name} → ${output}`);
-    } catch (err) {
-        console.error(`✖ Failed to compress: ${name}`, err);
+/**
+ * Renames every non-HTML asset to name.<hash>.ext and rewrites the references in the HTML pages,
+ * so those assets can be cached forever. HTML pages keep their names and are revalidated by ETag.
+ */
+function fingerprintFiles(files) {
+    const manifest = {};
+    for (const file of files.filter(file => !isHtml(file.path))) {
+        const {dir, name, ext} = path.posix.parse(file.path);
+        const fingerprinted = path.posix.join(dir, `${name}.${contentHash(file.content).substring(0, 8)}${ext}`);
+        manifest[file.path] = fingerprinted;
+        file.path = fingerprinted;
+        file.immutable = true;
+    }
+    for (const file of files.filter(file => isHtml(file.path))) {
+        let html = file.content.toString('utf8');
+        for (const [original, fingerprinted] of Object.entries(manifest)) {
+            html = html.replaceAll(`"${original}"`, `"${fingerprinted}"`);
+        }
+        file.content = Buffer.from(html, 'utf8');
+        manifest[file.path] = file.path;
+    }
+    return manifest;
+}
+
+function isHtml(file) {
+    return file.endsWith('.html');
+}
+
+function contentHash(content) {
+    return createHash('sha256').update(content).digest('hex');
+}
+
+async function compressFile(file) {
+    const flags = file.immutable ? FLAG_IMMUTABLE : 0;
+    const gzip = gzipSync(file.content, {level: constants.Z_BEST_COMPRESSION});
+    const brotli = brotliCompressSync(file.content, {
+        params: {
+            [constants.BROTLI_PARAM_QUALITY]: constants.BROTLI_MAX_QUALITY,
+            [constants.BROTLI_PARAM_SIZE_HINT]: file.content.length
+        }
+    });
+
+    const variants = [{path: file.path, etag: etag(gzip), encoding: ENCODING_GZIP, flags, data: gzip}];
+    // gzip stays mandatory: browsers only advertise br over HTTPS, and the partition is small.
+    if (brotli.length < gzip.length) {
+        variants.push({path: file.path, etag: etag(brotli), encoding: ENCODING_BROTLI, flags, data: brotli});
     }
+
+    console.log(`✔ Compressed: ${(gzip.length / 1024).toFixed(2)}KB gz, ${(brotli.length / 1024).toFixed(2)}KB br ${file.path}`
+        + (variants.length > 1 ? '' : ' (br skipped)'));
+    return variants;
+}
+
+// Strong ETags identify a representation, so every encoded variant gets its own.
+function etag(data) {
+    return '"' + contentHash(data).substring(0, 16) + '"';
+}
+
+function createBundle(assets) {
+    assets.sort((a, b) => Buffer.compare(Buffer.from(a.path), Buffer.from(b.path)) || a.encoding - b.encoding);
+
+    const indexSize = HEADER_SIZE + assets.length * ENTRY_SIZE;
+    const totalSize = assets.reduce((size, asset) => size + asset.data.length, indexSize);
+    const bundle = Buffer.alloc(totalSize);
+
+    bundle.writeUInt32LE(BUNDLE_MAGIC, 0);
+    bundle.writeUInt16LE(BUNDLE_VERSION, 4);
+    bundle.writeUInt16LE(assets.length, 6);
+    bundle.writeUInt32LE(totalSize, 8);
+    // CRC at offset 12, written once the index and data are in place.
+
+    let dataOffset = indexSize;
+    assets.forEach((asset, i) => {
+        if (asset.path.length > MAX_PATH_LENGTH) throw new Error(`Asset path too long: ${asset.path}`);
+        if (asset.etag.length > MAX_ETAG_LENGTH) throw new Error(`ETag too long: ${asset.etag}`);
+
+        const entryOffset = HEADER_SIZE + i * ENTRY_SIZE;
+        bundle.write(asset.path, entryOffset, 'ascii');
+        bundle.write(asset.etag, entryOffset + MAX_PATH_LENGTH + 1, 'ascii');
+        bundle.writeUInt32LE(dataOffset, entryOffset + 68);
+        bundle.writeUInt32LE(asset.data.length, entryOffset + 72);
+        bundle.writeUInt8(asset.encoding, entryOffset + 76);
+        bundle.writeUInt8(asset.flags, entryOffset + 77);
+
+        asset.data.copy(bundle, dataOffset);
+        dataOffset += asset.data.length;
+    });
+
+    bundle.writeUInt32LE(crc32(bundle.subarray(HEADER_SIZE)), 12);
+    return bundle;
+}
+
+// CRC-32 (IEEE, as zlib), the same the firmware computes with the ROM's crc32_le(0, ...).
+function crc32(data) {
+    let crc = 0xFFFFFFFF;
+    for (const byte of data) {
+        crc ^= byte;
+        for (let bit = 0; bit < 8; bit++) {
+            crc = (crc >>> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return (crc ^ 0xFFFFFFFF) >>> 0;
+}
+
+async function getPartitionSize(name) {
+    const csv = await readFile(partitionsFile, 'utf8');
+    const row = csv.split('\n')
+        .map(line => line.split(',').map(column => column.trim()))
+        .find(columns => columns[0] === name);
+    if (!row) throw new Error(`Partition '${name}' not found in ${partitionsFile}`);
+    return parseInt(row[4], 16);
 }
@@ -1,93 +1,212 @@
 ﻿#pragma once
 
 #include "Arduino.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <esp_mac.h>
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
-#include <WiFiUdp.h>
+#include <WiFi.h>
 #include "EspalexaDevice.h"
+#include "hue_state_parser.hh"
+#include "ssdp_notify.hh"
+#include "ssdp_responder.hh"
 
+// Light IDs are encoded as (mac24 << 7) | index, so at most 128 devices can be addressed.
+#ifndef ESPALEXA_MAXDEVICES
+#define ESPALEXA_MAXDEVICES 16
+#endif
 
 class Espalexa
 {
-    String body = "";
+public:
+    static constexpr uint8_t MAX_DEVICES = ESPALEXA_MAXDEVICES;
+    static_assert(MAX_DEVICES > 0 && MAX_DEVICES <= 128, "ESPALEXA_MAXDEVICES must be within 1..128");
+
+private:
+    static constexpr size_t LIGHT_JSON_SIZE = 512;
+    static constexpr size_t SEARCH_RESPONSE_SIZE = 384;
+    static constexpr size_t DESCRIPTION_SIZE = 1024;
+    static constexpr size_t UNIQUE_ID_SIZE = 27;
+
     uint8_t currentDeviceCount = 0;
-    bool discoverable = true;
-    bool udpConnected = false;
-    EspalexaDevice* devices[4] = {};
-    WiFiUDP espalexaUdp;
-    IPAddress ipMulti;
+    EspalexaDevice* devices[MAX_DEVICES] = {};
+    // The Hue API reads and changes the devices on the AsyncTCP task; see lockDevices().
+    mutable std::mutex deviceMutex;
+    SsdpResponder ssdpResponder{
+        [this](char* buffer, const size_t size)
+        {
+            return copySearchResponse(buffer, size);
+        },
+        [this](char* buffer, const size_t size, const bool alive, const uint8_t index)
+        {
+            return renderNotify(buffer, size, alive, index);
+        },
+        SsdpNotify::TYPE_COUNT
+    };
+    uint8_t mac[6] = {};
     uint32_t mac24 = 0;
-    String escapedMac = "";
+    char escapedMac[13] = "";
+
+    // The SSDP reply and description.xml only depend on the IP address and the MAC, so they are
+    // rendered once per IP change instead of once per request. The search response is re-rendered in
+    // place and copied out under cacheMutex; the description is rendered into a fresh immutable buffer
+    // that replaces the shared one, so a response still sending the old one keeps it alive.
+    std::atomic<bool> cacheDirty = true;
+    std::mutex cacheMutex;
+    char searchResponse[SEARCH_RESPONSE_SIZE] = "";
+    size_t searchResponseLength = 0;
+
+    struct SharedDescription
+    {
+        std::shared_ptr<const char[]> text;
+        size_t length = 0;
+    };
+
+    SharedDescription description;
+    char uniqueIds[MAX_DEVICES][UNIQUE_ID_SIZE] = {};
 
-    void respondToSearch()
+    void ensureCache()
     {
+        if (!cacheDirty.load()) return;
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        if (!cacheDirty.load()) return;
+
         IPAddress localIP = WiFi.localIP();
         char s[16];
         sprintf(s, "%d.%d.%d.%d", localIP[0], localIP[1], localIP[2], localIP[3]);
-        char buf[1024];
-        sprintf_P(buf,PSTR("HTTP/1.1 200 OK\r\n"
-                      "EXT:\r\n"
-                      "CACHE-CONTROL: max-age=100\r\n"
-                      "LOCATION: http://%s:80/description.xml\r\n"
-                      "SERVER: FreeRTOS/6.0.5, UPnP/1.0, IpBridge/1.17.0\r\n"
-                      "hue-bridgeid: %s\r\n"
-                      "ST: urn:schemas-upnp-org:device:basic:1\r\n"
-                      "USN: uuid:2f402f80-da50-11e1-9b23-%s::upnp:rootdevice\r\n"
-                      "\r\n"), s, escapedMac.c_str(), escapedMac.c_str());
-        espalexaUdp.beginPacket(espalexaUdp.remoteIP(), espalexaUdp.remotePort());
-        espalexaUdp.write(reinterpret_cast<uint8_t*>(buf), strlen(buf));
-        espalexaUdp.endPacket();
+        searchResponseLength = snprintf_P(searchResponse, sizeof(searchResponse),
+                                          PSTR("HTTP/1.1 200 OK\r\n"
+                                              "EXT:\r\n"
+                                              "CACHE-CONTROL: max-age=100\r\n"
+                                              "LOCATION: http://%s:80/description.xml\r\n"
+                                              "SERVER: FreeRTOS/6.0.5, UPnP/1.0, IpBridge/1.17.0\r\n"
+                                              "hue-bridgeid: %s\r\n"
+                                              "ST: urn:schemas-upnp-org:device:basic:1\r\n"
+                                              "USN: uuid:2f402f80-da50-11e1-9b23-%s::upnp:rootdevice\r\n"
+                                              "\r\n"), s, escapedMac, escapedMac);
+        searchResponseLength = std::min(searchResponseLength, sizeof(searchResponse) - 1);
+
+        const std::shared_ptr<char[]> rendered(new char[DESCRIPTION_SIZE]);
+        const size_t renderedLength = snprintf_P(rendered.get(), DESCRIPTION_SIZE,
+                                       PSTR("<?xml version=\"1.0\" ?>"
+                                           "<root xmlns=\"urn:schemas-upnp-org:device-1-0\">"
+                                           "<specVersion><major>1</major><minor>0</minor></specVersion>"
+                                           "<URLBase>http://%s:80/</URLBase>"
+                                           "<device>"
+                                           "<deviceType>urn:schemas-upnp-org:device:Basic:1</deviceType>"
+                                           "<friendlyName>Espalexa (%s:80)</friendlyName>"
+                                           "<manufacturer>Royal Philips Electronics</manufacturer>"
+                                           "<manufacturerURL>http://www.philips.com</manufacturerURL>"
+                                           "<modelDescription>Philips hue Personal Wireless Lighting</modelDescription>"
+                                           "<modelName>Philips hue bridge 2012</modelName>"
+                                           "<modelNumber>929000226503</modelNumber>"
+                                           "<modelURL>http://www.meethue.com</modelURL>"
+                                           "<serialNumber>%s</serialNumber>"
+                                           "<UDN>uuid:2f402f80-da50-11e1-9b23-%s</UDN>"
+                                           "<presentationURL>index.html</presentationURL>"
+                                           "</device>"
+                                           "</root>"), s, s, escapedMac, escapedMac);
+        description = {rendered, std::min(renderedLength, DESCRIPTION_SIZE - 1)};
+
+        cacheDirty = false;
+    }
+
+    size_t copySearchResponse(char* buffer, const size_t size)
+    {
+        ensureCache();
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        const size_t length = std::min(searchResponseLength, size);
+        memcpy(buffer, searchResponse, length);
+        return length;
+    }
+
+    SharedDescription shareDescription()
+    {
+        ensureCache();
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        return description;
+    }
+
+    size_t renderNotify(char* buffer, const size_t size, const bool alive, const uint8_t index) const
+    {
+        const IPAddress localIP = WiFi.localIP();
+        const uint8_t ip[4] = {localIP[0], localIP[1], localIP[2], localIP[3]};
+        return SsdpNotify::render(buffer, size, alive, index, ip, escapedMac);
+    }
+
+    void renderUniqueId(const uint8_t idx)
+    {
+        snprintf_P(uniqueIds[idx], UNIQUE_ID_SIZE, PSTR("%02X:%02X:%02X:%02X:%02X:%02X-%02X-00:11"),
+                   mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], idx + 1);
+    }
+
+    void readMac()
+    {
+        esp_read_mac(mac, ESP_MAC_WIFI_STA);
+        snprintf(escapedMac, sizeof(escapedMac), "%02x%02x%02x%02x%02x%02x",
+                 mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+        mac24 = (mac[3] << 16) | (mac[4] << 8) | mac[5];
     }
 
 public:
+    Espalexa()
+    {
+        readMac();
+    }
+
+    /**
+     * Called on every GOT_IP, so it also drops the responses rendered for the previous address.
+     */
     bool begin()
     {
-        escapedMac = WiFi.macAddress();
-        escapedMac.replace(":", "");
-        escapedMac.toLowerCase();
-        const String macSubStr = escapedMac.substring(6, 12);
-        mac24 = strtol(macSubStr.c_str(), nullptr, 16);
-        udpConnected = espalexaUdp.beginMulticast(IPAddress(239, 255, 255, 250), 1900);
-        if (udpConnected)
-        {
-            return true;
-        }
-        return false;
+        invalidateCache();
+        return ssdpResponder.begin();
     }
 
-    void loop()
+    /**
+     * Must be called whenever the IP address changes.
+     */
+    void invalidateCache()
     {
-        if (!udpConnected) return;
-        const int packetSize = espalexaUdp.parsePacket();
-        if (packetSize < 1) return;
-        unsigned char packetBuffer[packetSize + 1];
-        espalexaUdp.read(packetBuffer, packetSize);
-        packetBuffer[packetSize] = 0;
-        espalexaUdp.flush();
-        if (!discoverable) return;
-        const auto request = reinterpret_cast<const char*>(packetBuffer);
-        if (strstr(request, "M-SEARCH") == nullptr) return;
-        if (strstr(request, "ssdp:disc") != nullptr &&
-            (strstr(request, "upnp:rootd") != nullptr ||
-                strstr(request, "ssdp:all") != nullptr ||
-                strstr(request, "asic:1") != nullptr))
-        {
-            respondToSearch();
-        }
+        cacheDirty = true;
     }
 
     uint8_t addDevice(EspalexaDevice* d)
     {
-        if (currentDeviceCount >= 4) return 0;
+        if (currentDeviceCount >= MAX_DEVICES) return 0;
         if (d == nullptr) return 0;
         d->setId(currentDeviceCount);
         devices[currentDeviceCount] = d;
+        renderUniqueId(currentDeviceCount);
         return ++currentDeviceCount;
     }
 
+    [[nodiscard]] uint8_t getDeviceCount() const
+    {
+        return currentDeviceCount;
+    }
+
+    /**
+     * Held while a device is read or changed once the web server runs: by the Hue API on the AsyncTCP task
+     * (device callbacks included) and by whoever syncs the devices with the output from another task.
+     */
+    [[nodiscard]] std::unique_lock<std::mutex> lockDevices() const
+    {
+        return std::unique_lock<std::mutex>(deviceMutex);
+    }
+
     void setDiscoverable(bool d)
     {
-        discoverable = d;
+        ssdpResponder.setEnabled(d);
+    }
+
+    [[nodiscard]] const SsdpResponder::Stats& getSsdpStats() const
+    {
+        return ssdpResponder.getStats();
     }
 
     static uint8_t toPercent(const uint8_t bri)
@@ -101,42 +220,148 @@ public:
         return new AsyncAlexaWebHandler(*this);
     }
 
+    /**
+     * Fixed set of request body buffers, so concurrent Hue API calls each get their own storage
+     * without touching the heap. A slot is owned by one request until it is handled or disconnects.
+     */
+    class BodyPool
+    {
+    public:
+        static constexpr size_t POOL_SIZE = 4;
+        static constexpr size_t MAX_BODY_LENGTH = 511;
+
+        struct Slot
+        {
+            std::atomic<AsyncWebServerRequest*> owner = nullptr;
+            size_t length = 0;
+            bool overflow = false;
+            char data[MAX_BODY_LENGTH + 1] = {};
+        };
+
+        Slot* acquire(AsyncWebServerRequest* request)
+        {
+            for (auto& slot : slots)
+            {
+                AsyncWebServerRequest* expected = nullptr;
+                if (slot.owner.compare_exchange_strong(expected, request))
+                {
+                    slot.length = 0;
+                    slot.overflow = false;
+                    slot.data[0] = '\0';
+                    return &slot;
+                }
+            }
+            return nullptr;
+        }
+
+        Slot* find(const AsyncWebServerRequest* request)
+        {
+            for (auto& slot : slots)
+            {
+                if (slot.owner.load() == request)
+                    return &slot;
+            }
+            return nullptr;
+        }
+
+        /**
+         * Remembers a request whose body found no free slot, so it is answered with 503 rather than run
+         * without its body. There is a mark for every TCP connection, so one is always free.
+         */
+        void reject(AsyncWebServerRequest* request)
+        {
+            for (auto& owner : rejected)
+            {
+                AsyncWebServerRequest* expected = nullptr;
+                if (owner.compare_exchange_strong(expected, request))
+                    return;
+            }
+        }
+
+        bool isRejected(const AsyncWebServerRequest* request) const
+        {
+            for (const auto& owner : rejected)
+            {
+                if (owner.load() == request)
+                    return true;
+            }
+            return false;
+        }
+
+        void release(AsyncWebServerRequest* request)
+        {
+            for (auto& slot : slots)
+            {
+                AsyncWebServerRequest* expected = request;
+                slot.owner.compare_exchange_strong(expected, nullptr);
+            }
+            for (auto& owner : rejected)
+            {
+                AsyncWebServerRequest* expected = request;
+                owner.compare_exchange_strong(expected, nullptr);
+            }
+        }
+
+    private:
+        std::array<Slot, POOL_SIZE> slots;
+        std::array<std::atomic<AsyncWebServerRequest*>, CONFIG_LWIP_MAX_ACTIVE_TCP> rejected{};
+    };
+
     class AsyncAlexaWebHandler final : public AsyncWebHandler
     {
-        mutable String body;
-        String escapedMac;
-        uint32_t mac24;
+        static constexpr auto LOG_TAG = "AsyncAlexaWebHandler";
+
         Espalexa& espalexa;
+        BodyPool bodyPool;
 
     public:
         explicit AsyncAlexaWebHandler(Espalexa& espalexa): espalexa(espalexa)
         {
-            escapedMac = WiFi.macAddress();
-            escapedMac.replace(":", "");
-            escapedMac.toLowerCase();
-            const String macSubStr = escapedMac.substring(6, 12);
-            mac24 = strtol(macSubStr.c_str(), nullptr, 16);
         }
 
         bool canHandle(AsyncWebServerRequest* request) const override
         {
-            if (const auto& url = request->url();
-                url.startsWith("/description.xml") || url.startsWith("/api"))
-            {
-                body.clear();
-                return true;
-            }
-            return false;
+            const auto& url = request->url();
+            return url.startsWith("/description.xml") || url.startsWith("/api");
         }
 
         void handleRequest(AsyncWebServerRequest* request) override
         {
-            espalexa.body = body;
-            if (auto& url = request->url(); url == "/description.xml")
+            if (request->url() == "/description.xml")
             {
+                bodyPool.release(request);
                 return serveDescription(request);
             }
-            handleAlexaApiCall(request);
+
+            if (bodyPool.isRejected(request))
+            {
+                bodyPool.release(request);
+                request->send(503, "application/json", "{}");
+                return;
+            }
+
+            const char* body = "";
+            size_t length = 0;
+            if (request->hasParam("body", true))
+            {
+                const auto& value = request->getParam("body", true)->value();
+                body = value.c_str();
+                length = value.length();
+            }
+            else if (const auto* slot = bodyPool.find(request))
+            {
+                if (slot->overflow)
+                {
+                    bodyPool.release(request);
+                    request->send(413, "application/json", "{}");
+                    return;
+                }
+                body = slot->data;
+                length = slot->length;
+            }
+
+            handleAlexaApiCall(request, body, length);
+            bodyPool.release(request);
         }
 
         void handleBody(AsyncWebServerRequest* request,
@@ -145,161 +370,221 @@ public:
                         const size_t index,
                         const size_t total) override
         {
-            char b[len + 1];
-            b[len] = 0;
-            memcpy(b, data, len);
-            body += b;
+            auto* slot = index == 0 ? bodyPool.acquire(request) : bodyPool.find(request);
+            if (index == 0)
+            {
+                request->onDisconnect([this, request]()
+                {
+                    bodyPool.release(request);
+                });
+            }
+            if (!slot)
+            {
+                if (index == 0)
+                {
+                    ESP_LOGW(LOG_TAG, "No free body buffer, rejecting request");
+                    bodyPool.reject(request);
+                }
+                return;
+            }
+            if (slot->overflow || index + len > BodyPool::MAX_BODY_LENGTH)
+            {
+                slot->overflow = true;
+                return;
+            }
+            memcpy(slot->data + index, data, len);
+            slot->length = index + len;
+            slot->data[slot->length] = '\0';
         }
 
         void serveDescription(AsyncWebServerRequest* request) const
         {
-            IPAddress localIP = WiFi.localIP();
-            char s[16];
-            sprintf(s, "%d.%d.%d.%d", localIP[0], localIP[1], localIP[2], localIP[3]);
-            char buf[1024];
-            sprintf_P(buf,PSTR("<?xml version=\"1.0\" ?>"
-                          "<root xmlns=\"urn:schemas-upnp-org:device-1-0\">"
-                          "<specVersion><major>1</major><minor>0</minor></specVersion>"
-                          "<URLBase>http://%s:80/</URLBase>"
-                          "<device>"
-                          "<deviceType>urn:schemas-upnp-org:device:Basic:1</deviceType>"
-                          "<friendlyName>Espalexa (%s:80)</friendlyName>"
-                          "<manufacturer>Royal Philips Electronics</manufacturer>"
-                          "<manufacturerURL>http://www.philips.com</manufacturerURL>"
-                          "<modelDescription>Philips hue Personal Wireless Lighting</modelDescription>"
-                          "<modelName>Philips hue bridge 2012</modelName>"
-                          "<modelNumber>929000226503</modelNumber>"
-                          "<modelURL>http://www.meethue.com</modelURL>"
-                          "<serialNumber>%s</serialNumber>"
-                          "<UDN>uuid:2f402f80-da50-11e1-9b23-%s</UDN>"
-                          "<presentationURL>index.html</presentationURL>"
-                          "</device>"
-                          "</root>"), s, s, escapedMac.c_str(), escapedMac.c_str());
-            request->send(200, "text/xml", buf);
+            // The filler holds a reference to the rendered buffer, so an IP change while it is being sent
+            // swaps in a new one instead of changing this one.
+            const auto description = espalexa.shareDescription();
+            request->send(request->beginResponse(
+                "text/xml", description.length,
+                [description](uint8_t* buffer, const size_t maxLen, const size_t index) -> size_t
+                {
+                    const size_t length = std::min(maxLen, description.length - index);
+                    memcpy(buffer, description.text.get() + index, length);
+                    return length;
+                }));
         }
 
-        void handleAlexaApiCall(AsyncWebServerRequest* request) const
+        /**
+         * Parses the Hue API call in place: `body` points into a pooled buffer (or a request param)
+         * that stays valid until this call returns.
+         */
+        void handleAlexaApiCall(AsyncWebServerRequest* request, const char* body, const size_t length) const
         {
-            const String req = request->url();
-            if (request->hasParam("body", true))
-            {
-                body = request->getParam("body", true)->value();
-            }
-            if (body.indexOf("devicetype") > 0)
+            const char* url = request->url().c_str();
+            HueStateCommand command;
+            const bool parsed = length > 0 && HueStateParser::parse(body, length, command);
+            if (parsed && command.has(HueStateCommand::DEVICE_TYPE))
             {
-                body = "";
-                request->send(200, "application/json",
-                              F("[{\"success\":{\"username\":\"2WLEDHardQrI3WHYTHoMcXHgEspsM8ZZRpSKtBQr\"}}]"));
+                sendStatic(request, "[{\"success\":{\"username\":\"2WLEDHardQrI3WHYTHoMcXHgEspsM8ZZRpSKtBQr\"}}]");
                 return;
             }
-            if ((req.indexOf("state") > 0) && (body.length() > 0))
+            const char* lights = strstr(url, "lights");
+            if (strstr(url, "state") != nullptr && length > 0)
             {
-                request->send(200, "application/json", F("[{\"success\":{\"/lights/1/state/\": true}}]"));
-                uint32_t devId = req.substring(req.indexOf("lights") + 7).toInt();
-                unsigned idx = decodeLightKey(devId);
-                if (idx >= espalexa.currentDeviceCount) return;
-                EspalexaDevice* dev = espalexa.devices[idx];
-                dev->setPropertyChanged(EspalexaDeviceProperty::none);
-                if (body.indexOf("false") > 0)
+                if (!parsed)
                 {
-                    dev->setValue(0);
-                    dev->setPropertyChanged(EspalexaDeviceProperty::off);
-                    dev->doCallback();
+                    sendStatic(request, "[{\"error\":{\"type\":2,\"description\":\"body contains invalid json\"}}]");
                     return;
                 }
-                if (body.indexOf("true") > 0)
-                {
-                    dev->setValue(dev->getLastValue());
-                    dev->setPropertyChanged(EspalexaDeviceProperty::on);
-                }
-                if (body.indexOf("bri") > 0)
-                {
-                    uint8_t briL = body.substring(body.indexOf("bri") + 5).toInt();
-                    if (briL == 255)
-                    {
-                        dev->setValue(255);
-                    }
-                    else
-                    {
-                        dev->setValue(briL + 1);
-                    }
-                    dev->setPropertyChanged(EspalexaDeviceProperty::bri);
-                }
-                if (body.indexOf("xy") > 0)
-                {
-                    dev->setColorXY(body.substring(body.indexOf("[") + 1).toFloat(),
-                                    body.substring(body.indexOf(",0") + 1).toFloat());
-                    dev->setPropertyChanged(EspalexaDeviceProperty::xy);
-                }
-                if (body.indexOf("hue") > 0)
-                {
-                    dev->setColor(body.substring(body.indexOf("hue") + 5).toInt(),
-                                  body.substring(body.indexOf("sat") + 5).toInt());
-                    dev->setPropertyChanged(EspalexaDeviceProperty::hs);
-                }
-                if (body.indexOf("ct") > 0)
-                {
-                    dev->setColor(body.substring(body.indexOf("ct") + 4).toInt());
-                    dev->setPropertyChanged(EspalexaDeviceProperty::ct);
-                }
-                dev->doCallback();
+                sendStatic(request, "[{\"success\":{\"/lights/1/state/\": true}}]");
+                if (!lights) return;
+                const uint32_t devId = strtoul(lights + 7, nullptr, 10);
+                const unsigned idx = decodeLightKey(devId);
+                if (idx >= espalexa.currentDeviceCount) return;
+                const auto lock = espalexa.lockDevices();
+                applyStateCommand(espalexa.devices[idx], command);
                 return;
             }
-            int pos = req.indexOf("lights");
-            if (pos > 0)
+            if (lights)
             {
-                int devId = req.substring(pos + 7).toInt();
+                const uint32_t devId = strtoul(lights + 7, nullptr, 10);
                 if (devId == 0)
                 {
-                    String jsonTemp = "{";
-                    for (int i = 0; i < espalexa.currentDeviceCount; i++)
-                    {
-                        jsonTemp += '"';
-                        jsonTemp += encodeLightKey(i);
-                        jsonTemp += '"';
-                        jsonTemp += ':';
-                        char buf[512];
-                        deviceJsonString(espalexa.devices[i], buf);
-                        jsonTemp += buf;
-                        if (i < espalexa.currentDeviceCount - 1) jsonTemp += ',';
-                    }
-                    jsonTemp += '}';
-                    request->send(200, "application/json", jsonTemp);
+                    sendLightList(request);
                 }
                 else
                 {
                     unsigned idx = decodeLightKey(devId);
                     if (idx < espalexa.currentDeviceCount)
                     {
-                        char buf[512];
-                        deviceJsonString(espalexa.devices[idx], buf);
+                        char buf[LIGHT_JSON_SIZE];
+                        {
+                            const auto lock = espalexa.lockDevices();
+                            deviceJsonString(espalexa.devices[idx], buf);
+                        }
                         request->send(200, "application/json", buf);
                     }
                     else
                     {
-                        request->send(200, "application/json", "{}");
+                        sendStatic(request, "{}");
                     }
                 }
                 return;
             }
-            request->send(200, "application/json", "{}");
+            sendStatic(request, "{}");
+        }
+
+        /**
+         * State of a chunked `/lights` listing: one light is rendered at a time and copied out as the
+         * TCP window allows, so the listing never needs a buffer sized for every device.
+         */
+        struct LightListStream
+        {
+            uint8_t next = 0;
+            size_t offset = 0;
+            size_t length = 0;
+            char buf[LIGHT_JSON_SIZE + 16] = "";
+        };
+
+        void sendLightList(AsyncWebServerRequest* request) const
+        {
+            const auto stream = std::make_shared<LightListStream>();
+            request->send(request->beginChunkedResponse(
+                "application/json",
+                [this, stream](uint8_t* buffer, const size_t maxLen, size_t) -> size_t
+                {
+                    size_t written = 0;
+                    while (written < maxLen)
+                    {
+                        if (stream->offset == stream->length)
+                        {
+                            if (stream->next > espalexa.currentDeviceCount) break;
+                            stream->length = renderLightListPart(stream->next++, stream->buf);
+                            stream->offset = 0;
+                        }
+                        const size_t chunk = std::min(maxLen - written, stream->length - stream->offset);
+                        memcpy(buffer + written, stream->buf + stream->offset, chunk);
+                        stream->offset += chunk;
+                        written += chunk;
+                    }
+                    return written;
+                }));
+        }
+
+        /**
+         * Part `i` of the listing is `{"key":{...}` or `,"key":{...}`; the part after the last light closes it.
+         */
+        size_t renderLightListPart(const uint8_t i, char* buf) const
+        {
+            const uint8_t count = espalexa.currentDeviceCount;
+            if (i == count)
+                return sprintf(buf, count == 0 ? "{}" : "}");
+            const int prefix = sprintf(buf, "%s\"%d\":", i == 0 ? "{" : ",", encodeLightKey(i));
+            const auto lock = espalexa.lockDevices();
+            deviceJsonString(espalexa.devices[i], buf + prefix);
+            return strlen(buf);
+        }
+
+        static void applyStateCommand(EspalexaDevice* dev, const HueStateCommand& command)
+        {
+            dev->setPropertyChanged(EspalexaDeviceProperty::none);
+            dev->setTransitionTime(command.has(HueStateCommand::TRANSITION_TIME) ? command.transitionTime : 0);
+            if (command.has(HueStateCommand::ON) && !command.on)
+            {
+                dev->setValue(0);
+                dev->setPropertyChanged(EspalexaDeviceProperty::off);
+                dev->doCallback();
+                return;
+            }
+            if (command.has(HueStateCommand::ON))
+            {
+                dev->setValue(dev->getLastValue());
+                dev->setPropertyChanged(EspalexaDeviceProperty::on);
+            }
+            if (command.has(HueStateCommand::BRI))
+            {
+                dev->setValue(command.bri + 1);
+                dev->setPropertyChanged(EspalexaDeviceProperty::bri);
+            }
+            if (command.has(HueStateCommand::XY))
+            {
+                dev->setColorXY(command.x, command.y);
+                dev->setPropertyChanged(EspalexaDeviceProperty::xy);
+            }
+            if (command.has(HueStateCommand::HUE) || command.has(HueStateCommand::SAT))
+            {
+                dev->setColor(command.has(HueStateCommand::HUE) ? command.hue : dev->getHue(),
+                              command.has(HueStateCommand::SAT) ? command.sat : dev->getSat());
+                dev->setPropertyChanged(EspalexaDeviceProperty::hs);
+            }
+            if (command.has(HueStateCommand::CT))
+            {
+                dev->setColor(command.ct);
+                dev->setPropertyChanged(EspalexaDeviceProperty::ct);
+            }
+            dev->doCallback();
+        }
+
+        /**
+         * Sends a string literal without copying it into a response buffer.
+         */
+        static void sendStatic(AsyncWebServerRequest* request, const char* json)
+        {
+            request->send(200, "application/json", reinterpret_cast<const uint8_t*>(json), strlen(json));
         }
 
         int encodeLightKey(const uint8_t idx) const
         {
-            static_assert(4 <= 128, "");
-            return (mac24 << 7) | idx;
+            static_assert(MAX_DEVICES <= 128, "");
+            return (espalexa.mac24 << 7) | idx;
         }
 
         uint8_t decodeLightKey(int key) const
         {
-            return ((static_cast<uint32_t>(key) >> 7) == mac24) ? (key & 127U) : 255U;
+            return ((static_cast<uint32_t>(key) >> 7) == espalexa.mac24) ? (key & 127U) : 255U;
         }
 
-        static void deviceJsonString(EspalexaDevice* dev, char* buf)
+        void deviceJsonString(EspalexaDevice* dev, char* buf) const
         {
-            char buf_lightid[27];
-            encodeLightId(dev->getId() + 1, buf_lightid);
+            const char* buf_lightid = espalexa.uniqueIds[dev->getId()];
             char buf_col[80] = "";
             if (static_cast<uint8_t>(dev->getType()) > 2)
                 sprintf_P(buf_col,PSTR(",\"hue\":%u,\"sat\":%u,\"effect\":\"none\",\"xy\":[%f,%f]")
@@ -320,15 +605,6 @@ public:
                       buf_lightid);
         }
 
-        static void encodeLightId(uint8_t idx, char* out)
-        {
-            uint8_t mac[6];
-            WiFi.macAddress(mac);
-            sprintf_P(out, PSTR("%02X:%02X:%02X:%02X:%02X:%02X-%02X-00:11"), mac[0], mac[1], mac[2], mac[3], mac[4],
-                      mac[5],
-                      idx);
-        }
-
         static const char* modelidString(const EspalexaDeviceType t)
         {
             switch (t)
@@ -24,10 +24,14 @@ private:
   uint16_t _hue = 0, _ct = 0;
   float _x = 0.5, _y = 0.5;
   uint32_t _rgb = 0;
+  bool _rgbDirty = true; //_rgb must be recomputed from the current color mode
   uint8_t _id = 0;
+  uint16_t _transitionTime = 0;
   EspalexaDeviceType _type;
   EspalexaDeviceProperty _changed = EspalexaDeviceProperty::none;
   EspalexaColorMode _mode = EspalexaColorMode::xy;
+
+  uint32_t computeRGB();
   
 public:
   EspalexaDevice();
@@ -57,6 +61,7 @@ public:
   uint8_t getW();
   EspalexaColorMode getColorMode();
   EspalexaDeviceType getType();
+  uint16_t getTransitionTime(); //of the last command, in multiples of 100 ms
   
   void setId(uint8_t id);
   void setPropertyChanged(EspalexaDeviceProperty p);
@@ -68,6 +73,7 @@ public:
   void setColor(uint16_t hue, uint8_t sat);
   void setColorXY(float x, float y);
   void setColor(uint8_t r, uint8_t g, uint8_t b);
+  void setTransitionTime(uint16_t transitionTime);
   
   void doCallback();
 };
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Picks how far to stretch a client's update intervals from its link quality: the station RSSI, the measured
+ * round-trip time and the depth of the client's send queue each add levels, and every level doubles the
+ * intervals. A worse link takes effect on the next sample; recovery goes one level at a time and only after
+ * RECOVERY_SAMPLES better samples in a row, so a single good reading does not flood a marginal link again.
+ * Pure logic, fed by the caller.
+ */
+class AdaptiveRate
+{
+public:
+    static constexpr uint8_t MAX_LEVEL = 3; // intervals up to 8x
+
+private:
+    static constexpr uint8_t RECOVERY_SAMPLES = 3;
+    static constexpr float RTT_AVERAGE_ALPHA = 0.3f;
+
+    uint8_t level = 0;
+    uint8_t betterSamples = 0;
+    float rttAverageMs = 0.0f;
+
+public:
+    /**
+     * Levels a sample asks for. An RSSI of 0 (not associated) or an RTT of 0 (not measured yet) adds none.
+     */
+    [[nodiscard]] static uint8_t targetLevel(const int8_t rssi, const uint32_t rttMs, const size_t queued)
+    {
+        uint8_t target = 0;
+        if (rssi != 0)
+            target += rssi <= -80 ? 2 : rssi <= -72 ? 1 : 0;
+        target += rttMs >= 400 ? 2 : rttMs >= 150 ? 1 : 0;
+        target += queued >= 8 ? 2 : queued >= 2 ? 1 : 0;
+        return std::min(target, MAX_LEVEL);
+    }
+
+    /**
+     * Feeds one sample (about once a second) and returns the level to use.
+     */
+    uint8_t update(const int8_t rssi, const uint32_t rttMs, const size_t queued)
+    {
+        if (rttMs != 0)
+            rttAverageMs = rttAverageMs == 0.0f
+                               ? static_cast<float>(rttMs)
+                               : rttAverageMs + RTT_AVERAGE_ALPHA * (static_cast<float>(rttMs) - rttAverageMs);
+
+        const uint8_t target = targetLevel(rssi, static_cast<uint32_t>(rttAverageMs), queued);
+        if (target >= level)
+        {
+            level = target;
+            betterSamples = 0;
+        }
+        else if (++betterSamples >= RECOVERY_SAMPLES)
+        {
+            --level;
+            betterSamples = 0;
+        }
+        return level;
+    }
+
+    /**
+     * `intervalMs` stretched for the current level.
+     */
+    [[nodiscard]] uint32_t scale(const uint32_t intervalMs) const
+    {
+        return intervalMs << level;
+    }
+
+    [[nodiscard]] uint8_t getLevel() const { return level; }
+    [[nodiscard]] uint32_t getRttMs() const { return static_cast<uint32_t>(rttAverageMs); }
+};
@@ -6,83 +6,49 @@
 #include "Espalexa.h"
 #include "ArduinoJson.h"
 
+#include "alexa_model.hh"
+#include "config_store.hh"
 #include "output.hh"
+#include "output_command.hh"
 
-enum class AlexaIntegrationMode : uint8_t
-{
-    OFF = 0,
-    RGBW_DEVICE = 1,
-    RGB_DEVICE = 2,
-    MULTI_DEVICE = 3
-};
-
-#pragma pack(push, 1)
-struct AlexaIntegrationSettings
+class AlexaIntegration
 {
-    static constexpr auto MAX_DEVICE_NAME_LENGTH = 32;
-    static constexpr auto LOG_TAG = "AlexaIntegrationSettings";
-
-    AlexaIntegrationMode integrationMode = AlexaIntegrationMode::OFF;
-    char rDeviceName[MAX_DEVICE_NAME_LENGTH] = "";
-    char gDeviceName[MAX_DEVICE_NAME_LENGTH] = "";
-    char bDeviceName[MAX_DEVICE_NAME_LENGTH] = "";
-    char wDeviceName[MAX_DEVICE_NAME_LENGTH] = "";
-
-    void toJson(const JsonObject& to) const
-    {
-        to["mode"] = this->integrationModeString();
-        const auto names = to["names"].to<JsonArray>();
-        if (rDeviceName[0] != '\0') addDevice(names, rDeviceName);
-        if (gDeviceName[0] != '\0') addDevice(names, gDeviceName);
-        if (bDeviceName[0] != '\0') addDevice(names, bDeviceName);
-        if (wDeviceName[0] != '\0') addDevice(names, wDeviceName);
-    }
+    static constexpr auto LOG_TAG = "AlexaIntegration";
+    static constexpr uint8_t CHANNEL_DEVICES = 4;
 
-    [[nodiscard]] const char* integrationModeString() const
-    {
-        switch (integrationMode)
-        {
-        case AlexaIntegrationMode::OFF:
-            return "off";
-        case AlexaIntegrationMode::RGBW_DEVICE:
-            return "rgbw_device";
-        case AlexaIntegrationMode::RGB_DEVICE:
-            return "rgb_device";
-        case AlexaIntegrationMode::MULTI_DEVICE:
-            return "multi_device";
-        }
-        return "off";
-    }
+public:
+    static constexpr uint8_t MAX_SCENES = AlexaScene::MAX_SCENES;
 
 private:
-    void addDevice(const JsonArray names, const char* name) const
-    {
-        if (!names.add(rDeviceName))
-        {
-            ESP_LOGD(LOG_TAG, "Failed to add device name: %s to Json", name);
-        }
-    }
-};
-#pragma pack(pop)
-
-class AlexaIntegration
-{
-    static constexpr auto LOG_TAG = "AlexaIntegration";
+    static_assert(CHANNEL_DEVICES + MAX_SCENES <= Espalexa::MAX_DEVICES, "Raise ESPALEXA_MAXDEVICES");
 
     Output& output;
+    OutputCommandQueue& outputCommands;
     Espalexa espalexa;
 
     AlexaIntegrationSettings settings;
+    std::array<AlexaScene, MAX_SCENES> scenes = {};
+    uint8_t sceneCount = 0;
 
-    std::array<std::unique_ptr<EspalexaDevice>, 4> devices;
+    // Channel devices (indexed by Color) come first, scene devices follow.
+    std::array<std::unique_ptr<EspalexaDevice>, CHANNEL_DEVICES + MAX_SCENES> devices;
 
 public:
-    explicit AlexaIntegration(Output& output): output(output)
+    // Device callbacks run in the AsyncTCP task, so changes reach the output through the command queue.
+    AlexaIntegration(Output& output, OutputCommandQueue& outputCommands)
+        : output(output), outputCommands(outputCommands)
     {
+        // Whatever changed the output (Alexa, WS, REST, BLE, button), keep the devices reported to Alexa in sync.
+        output.changed().connect([this](bool) { updateValues(); });
     }
 
-    void begin()
+    /**
+     * Builds the device table. Needs no network; runs during setup() before Wi-Fi starts, so begin() on the
+     * event task never races with it.
+     */
+    void prepare()
     {
+        if (espalexa.getDeviceCount() != 0) return;
         loadPreferences();
         setupDevices();
         for (const auto& device : devices)
@@ -92,12 +58,19 @@ public:
                 espalexa.addDevice(device.get());
             }
         }
+    }
+
+    /**
+     * Called on every GOT_IP, after prepare(): (re)joins the SSDP multicast group for the current address.
+     */
+    void begin()
+    {
         espalexa.begin();
     }
 
-    void handle()
+    [[nodiscard]] const SsdpResponder::Stats& getSsdpStats() const
     {
-        espalexa.loop();
+        return espalexa.getSsdpStats();
     }
 
     AsyncWebHandler* createAsyncWebHandler()
@@ -116,8 +89,44 @@ public:
         savePreferences();
     }
 
+    void scenesToJson(const JsonArray& to) const
+    {
+        for (uint8_t i = 0; i < sceneCount; ++i)
+            scenes[i].toJson(to.add<JsonObject>());
+    }
+
+    /**
+     * Adds a scene, or replaces the one with the same name. Takes effect after a restart,
+     * like the other Alexa settings.
+     */
+    bool saveScene(const AlexaScene& scene)
+    {
+        if (scene.name[0] == '\0') return false;
+        const auto index = findScene(scene.name);
+        if (index < 0 && sceneCount >= MAX_SCENES) return false;
+        scenes[index < 0 ? sceneCount++ : index] = scene;
+        saveScenes();
+        return true;
+    }
+
+    bool deleteScene(const char* name)
+    {
+        const auto index = findScene(name);
+        if (index < 0) return false;
+        for (uint8_t i = index; i + 1 < sceneCount; ++i)
+            scenes[i] = scenes[i + 1];
+        scenes[--sceneCount] = {};
+        saveScenes();
+        return true;
+    }
+
+    /**
+     * Main loop: mirrors the output into the devices under Espalexa's device lock, so a Hue request on the
+     * AsyncTCP task never sees (or caches the RGB of) a half-updated device.
+     */
     void updateValues() const
     {
+        const auto lock = espalexa.lockDevices();
         switch (settings.integrationMode)
         {
         case AlexaIntegrationMode::OFF:
@@ -132,51 +141,34 @@ public:
             updateMultiDevice();
             break;
         }
+        updateSceneDevices();
     }
 
 private:
-    void loadPreferences()
+    [[nodiscard]] int findScene(const char* name) const
     {
-        Preferences prefs;
-        prefs.begin("alexa-config", true);
-
-        const auto mode = prefs.getUChar("mode", static_cast<uint8_t>(AlexaIntegrationMode::OFF));
-        if (mode <= static_cast<uint8_t>(AlexaIntegrationMode::MULTI_DEVICE))
-        {
-            settings.integrationMode = static_cast<AlexaIntegrationMode>(mode);
-        }
-        else
+        for (uint8_t i = 0; i < sceneCount; ++i)
         {
-            settings.integrationMode = AlexaIntegrationMode::OFF;
+            if (strncmp(scenes[i].name, name, AlexaIntegrationSettings::MAX_DEVICE_NAME_LENGTH) == 0)
+                return i;
         }
+        return -1;
+    }
 
-        const String r = prefs.getString("r", "");
-        const String g = prefs.getString("g", "");
-        const String b = prefs.getString("b", "");
-        const String w = prefs.getString("w", "");
-        prefs.end();
-
-        strncpy(settings.rDeviceName, r.c_str(), AlexaIntegrationSettings::MAX_DEVICE_NAME_LENGTH - 1);
-        strncpy(settings.gDeviceName, g.c_str(), AlexaIntegrationSettings::MAX_DEVICE_NAME_LENGTH - 1);
-        strncpy(settings.bDeviceName, b.c_str(), AlexaIntegrationSettings::MAX_DEVICE_NAME_LENGTH - 1);
-        strncpy(settings.wDeviceName, w.c_str(), AlexaIntegrationSettings::MAX_DEVICE_NAME_LENGTH - 1);
-
-        settings.rDeviceName[AlexaIntegrationSettings::MAX_DEVICE_NAME_LENGTH - 1] = '\0';
-        settings.gDeviceName[AlexaIntegrationSettings::MAX_DEVICE_NAME_LENGTH - 1] = '\0';
-        settings.bDeviceName[AlexaIntegrationSettings::MAX_DEVICE_NAME_LENGTH - 1] = '\0';
-        settings.wDeviceName[AlexaIntegrationSettings::MAX_DEVICE_NAME_LENGTH - 1] = '\0';
+    void loadPreferences()
+    {
+        settings = ConfigStore::get().getAlexaSettings();
+        sceneCount = ConfigStore::get().getAlexaScenes(scenes.data());
     }
 
-    void savePreferences()
+    void saveScenes() const
     {
-        Preferences prefs;
-        prefs.begin("alexa-config", false);
-        prefs.putUChar("mode", static_cast<uint8_t>(settings.integrationMode));
-        prefs.putString("r", settings.rDeviceName);
-        prefs.putString("g", settings.gDeviceName);
-        prefs.putString("b", settings.bDeviceName);
-        prefs.putString("w", settings.wDeviceName);
-        prefs.end();
+        ConfigStore::get().setAlexaScenes(scenes.data(), sceneCount);
+    }
+
+    void savePreferences() const
+    {
+        ConfigStore::get().setAlexaSettings(settings);
     }
 
     void setupDevices()
@@ -195,6 +187,43 @@ private:
             setupMultiDevice(settings);
             break;
         }
+        if (settings.integrationMode != AlexaIntegrationMode::OFF)
+            setupSceneDevices();
+    }
+
+    void setupSceneDevices()
+    {
+        for (uint8_t i = 0; i < sceneCount; ++i)
+        {
+            const size_t index = CHANNEL_DEVICES + i;
+            const AlexaScene scene = scenes[i];
+            ESP_LOGI(LOG_TAG, "Adding scene device: %s", scene.name);
+            devices[index] = std::make_unique<EspalexaDevice>(
+                scene.name,
+                [this, scene, index](const uint8_t brightness)
+                {
+                    this->handleSceneDeviceEvent(scene, index, brightness);
+                },
+                0
+            );
+        }
+    }
+
+    void handleSceneDeviceEvent(const AlexaScene& scene, const size_t index, const uint8_t brightness) const
+    {
+        ESP_LOGI(LOG_TAG, "Received %s command: brightness=%d", scene.name, brightness);
+        if (brightness == 0)
+        {
+            outputCommands.post(OutputCommands::TurnOff{});
+            return;
+        }
+        const auto scale = [brightness](const uint8_t value)
+        {
+            return static_cast<uint8_t>(value * brightness / 255);
+        };
+        outputCommands.post(OutputCommands::SetColor{
+            {scale(scene.r), scale(scene.g), scale(scene.b), scale(scene.w)}, transitionMs(index)
+        });
     }
 
     void handleRgbwDeviceEvent(const char* deviceName, const uint8_t brightness, const uint32_t color) const
@@ -212,7 +241,7 @@ private:
         r -= w;
         g -= w;
         b -= w;
-        output.setColor(r, g, b, w);
+        outputCommands.post(OutputCommands::SetColor{{r, g, b, w}, transitionMs(0)});
     }
 
     void setupRgbwDevice(const AlexaIntegrationSettings& settings)
@@ -250,9 +279,10 @@ private:
         r = static_cast<uint8_t>(static_cast<float>(r) * intensity);
         g = static_cast<uint8_t>(static_cast<float>(g) * intensity);
         b = static_cast<uint8_t>(static_cast<float>(b) * intensity);
-        output.update(Color::Red, r);
-        output.update(Color::Green, g);
-        output.update(Color::Blue, b);
+        const auto transition = transitionMs(0);
+        outputCommands.post(OutputCommands::SetChannel{Color::Red, r, transition});
+        outputCommands.post(OutputCommands::SetChannel{Color::Green, g, transition});
+        outputCommands.post(OutputCommands::SetChannel{Color::Blue, b, transition});
     }
 
     void setupRgbDevice(const AlexaIntegrationSettings& settings)
@@ -322,7 +352,17 @@ private:
     void handleSingleChangeDeviceEvent(const char* name, const Color color, const uint8_t brightness) const
     {
         ESP_LOGI(LOG_TAG, "Received %s command: brightness=%d", name, brightness);
-        output.update(color, brightness);
+        outputCommands.post(OutputCommands::SetChannel{
+            color, brightness, transitionMs(static_cast<size_t>(color))
+        });
+    }
+
+    /**
+     * Hue `transitiontime` of the last command received by the device in `index`, in milliseconds.
+     */
+    [[nodiscard]] uint32_t transitionMs(const size_t index) const
+    {
+        return devices[index] ? devices[index]->getTransitionTime() * 100U : 0;
     }
 
     void updateRgbwDevice() const
@@ -358,9 +398,19 @@ private:
         }
     }
 
+    void updateSceneDevices() const
+    {
+        if (output.anyOn()) return;
+        for (size_t i = CHANNEL_DEVICES; i < devices.size(); ++i)
+        {
+            if (devices[i])
+                devices[i]->setState(false);
+        }
+    }
+
     void updateMultiDevice() const
     {
-        for (size_t i = 0; i < devices.size(); ++i)
+        for (size_t i = 0; i < CHANNEL_DEVICES; ++i)
         {
             if (devices[i])
             {
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+enum class AlexaIntegrationMode : uint8_t
+{
+    OFF = 0,
+    RGBW_DEVICE = 1,
+    RGB_DEVICE = 2,
+    MULTI_DEVICE = 3
+};
+
+#pragma pack(push, 1)
+struct AlexaIntegrationSettings
+{
+    static constexpr auto MAX_DEVICE_NAME_LENGTH = 32;
+    static constexpr auto LOG_TAG = "AlexaIntegrationSettings";
+
+    AlexaIntegrationMode integrationMode = AlexaIntegrationMode::OFF;
+    char rDeviceName[MAX_DEVICE_NAME_LENGTH] = "";
+    char gDeviceName[MAX_DEVICE_NAME_LENGTH] = "";
+    char bDeviceName[MAX_DEVICE_NAME_LENGTH] = "";
+    char wDeviceName[MAX_DEVICE_NAME_LENGTH] = "";
+
+    void toJson(const JsonObject& to) const
+    {
+        to["mode"] = this->integrationModeString();
+        const auto names = to["names"].to<JsonArray>();
+        if (rDeviceName[0] != '\0') addDevice(names, rDeviceName);
+        if (gDeviceName[0] != '\0') addDevice(names, gDeviceName);
+        if (bDeviceName[0] != '\0') addDevice(names, bDeviceName);
+        if (wDeviceName[0] != '\0') addDevice(names, wDeviceName);
+    }
+
+    [[nodiscard]] const char* integrationModeString() const
+    {
+        switch (integrationMode)
+        {
+        case AlexaIntegrationMode::OFF:
+            return "off";
+        case AlexaIntegrationMode::RGBW_DEVICE:
+            return "rgbw_device";
+        case AlexaIntegrationMode::RGB_DEVICE:
+            return "rgb_device";
+        case AlexaIntegrationMode::MULTI_DEVICE:
+            return "multi_device";
+        }
+        return "off";
+    }
+
+private:
+    void addDevice(const JsonArray names, const char* name) const
+    {
+        if (!names.add(rDeviceName))
+        {
+            ESP_LOGD(LOG_TAG, "Failed to add device name: %s to Json", name);
+        }
+    }
+};
+
+/**
+ * A stored color preset exposed to Alexa as its own dimmable "light", e.g. "Reading" or "Movie".
+ */
+struct AlexaScene
+{
+    static constexpr uint8_t MAX_SCENES = 8;
+
+    char name[AlexaIntegrationSettings::MAX_DEVICE_NAME_LENGTH] = "";
+    uint8_t r = 0;
+    uint8_t g = 0;
+    uint8_t b = 0;
+    uint8_t w = 0;
+
+    void toJson(const JsonObject& to) const
+    {
+        to["name"] = name;
+        to["r"] = r;
+        to["g"] = g;
+        to["b"] = b;
+        to["w"] = w;
+    }
+};
+#pragma pack(pop)
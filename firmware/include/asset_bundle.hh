@@ -0,0 +1,349 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include <rom/crc.h>
+#include <cstring>
+
+#include "ESPAsyncWebServer.h"
+
+enum class AssetEncoding : uint8_t
+{
+    IDENTITY = 0,
+    GZIP = 1,
+    BROTLI = 2
+};
+
+#pragma pack(push, 1)
+struct AssetBundleHeader
+{
+    static constexpr uint32_t MAGIC = 0x42415752; // "RWAB" little-endian
+    static constexpr uint16_t VERSION = 2;
+
+    uint32_t magic;
+    uint16_t version;
+    uint16_t entryCount;
+    uint32_t totalSize;
+    uint32_t crc; // CRC-32 of everything after the header (index and data), up to totalSize
+};
+
+struct AssetBundleEntry
+{
+    static constexpr auto MAX_PATH_LENGTH = 47;
+    static constexpr auto MAX_ETAG_LENGTH = 19;
+    static constexpr uint8_t FLAG_IMMUTABLE = 0x01; // content-hashed filename, never changes
+
+    char path[MAX_PATH_LENGTH + 1];
+    char etag[MAX_ETAG_LENGTH + 1];
+    uint32_t offset;
+    uint32_t length;
+    AssetEncoding encoding;
+    uint8_t flags;
+    uint16_t reserved;
+
+    [[nodiscard]] bool isImmutable() const
+    {
+        return (flags & FLAG_IMMUTABLE) != 0;
+    }
+};
+#pragma pack(pop)
+
+static_assert(sizeof(AssetBundleHeader) == 16, "AssetBundleHeader layout must match filesystem/build.mjs");
+static_assert(sizeof(AssetBundleEntry) == 80, "AssetBundleEntry layout must match filesystem/build.mjs");
+
+/**
+ * Read-only web UI bundle produced by filesystem/build.mjs and flashed into the `assets` partition.
+ * The partition is memory-mapped once at boot, so requests are answered straight from flash without
+ * any filesystem lookup or intermediate heap buffer.
+ */
+class AssetBundle
+{
+    static constexpr auto LOG_TAG = "AssetBundle";
+    static constexpr auto PARTITION_LABEL = "assets";
+    static constexpr auto DEFAULT_FILE = "/index.html";
+
+    const uint8_t* base = nullptr;
+    const AssetBundleEntry* entries = nullptr;
+    uint16_t entryCount = 0;
+    spi_flash_mmap_handle_t mmapHandle = 0;
+
+public:
+    bool begin()
+    {
+        const auto* partition = esp_partition_find_first(
+            ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, PARTITION_LABEL);
+        if (!partition)
+        {
+            ESP_LOGE(LOG_TAG, "Partition '%s' not found", PARTITION_LABEL);
+            return false;
+        }
+
+        const void* mapped = nullptr;
+        if (const auto err = esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA,
+                                                &mapped, &mmapHandle); err != ESP_OK)
+        {
+            ESP_LOGE(LOG_TAG, "Failed to map partition '%s': %s", PARTITION_LABEL, esp_err_to_name(err));
+            return false;
+        }
+
+        const auto* header = static_cast<const AssetBundleHeader*>(mapped);
+        if (!isIntact(*header, partition->size))
+        {
+            ESP_LOGE(LOG_TAG, "Partition '%s' does not contain a valid asset bundle", PARTITION_LABEL);
+            spi_flash_munmap(mmapHandle);
+            mmapHandle = 0;
+            return false;
+        }
+
+        base = static_cast<const uint8_t*>(mapped);
+        entries = reinterpret_cast<const AssetBundleEntry*>(base + sizeof(AssetBundleHeader));
+        entryCount = header->entryCount;
+        ESP_LOGI(LOG_TAG, "Mapped %u assets (%u bytes)", entryCount, header->totalSize);
+        return true;
+    }
+
+    [[nodiscard]] bool isValid() const
+    {
+        return base != nullptr;
+    }
+
+    /**
+     * Entries are sorted by path and then by encoding at build time, so lookup is a binary search over
+     * the mapped index and all encoded variants of a path sit next to each other.
+     */
+    [[nodiscard]] const AssetBundleEntry* find(const char* path) const
+    {
+        if (!isValid()) return nullptr;
+        if (strcmp(path, "/") == 0) path = DEFAULT_FILE;
+
+        size_t low = 0;
+        size_t high = entryCount;
+        while (low < high)
+        {
+            const size_t mid = (low + high) / 2;
+            if (comparePath(entries[mid], path) < 0)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        if (low < entryCount && comparePath(entries[low], path) == 0)
+            return &entries[low];
+        return nullptr;
+    }
+
+    /**
+     * Picks the variant of `path` to send for the given Accept-Encoding header, preferring brotli.
+     * gzip is served even when not advertised, as serveStatic with setTryGzipFirst did before.
+     */
+    [[nodiscard]] const AssetBundleEntry* find(const char* path, const char* acceptEncoding) const
+    {
+        const auto* first = find(path);
+        if (!first) return nullptr;
+
+        const bool acceptsBrotli = acceptEncoding && acceptsEncoding(acceptEncoding, "br");
+        const AssetBundleEntry* best = first;
+        for (const auto* entry = first;
+             entry < entries + entryCount && comparePath(*entry, first->path) == 0;
+             ++entry)
+        {
+            if (entry->encoding == AssetEncoding::BROTLI && acceptsBrotli)
+                return entry;
+            if (entry->encoding == AssetEncoding::GZIP)
+                best = entry;
+        }
+        return best;
+    }
+
+    [[nodiscard]] const uint8_t* data(const AssetBundleEntry& entry) const
+    {
+        return base + entry.offset;
+    }
+
+    AsyncWebHandler* createAsyncWebHandler()
+    {
+        return new AsyncAssetWebHandler(*this);
+    }
+
+    static const char* contentType(const char* path)
+    {
+        const char* extension = strrchr(path, '.');
+        if (!extension) return "application/octet-stream";
+        if (strcmp(extension, ".html") == 0) return "text/html";
+        if (strcmp(extension, ".js") == 0) return "application/javascript";
+        if (strcmp(extension, ".css") == 0) return "text/css";
+        if (strcmp(extension, ".svg") == 0) return "image/svg+xml";
+        if (strcmp(extension, ".json") == 0) return "application/json";
+        if (strcmp(extension, ".webmanifest") == 0) return "application/manifest+json";
+        if (strcmp(extension, ".png") == 0) return "image/png";
+        if (strcmp(extension, ".ico") == 0) return "image/x-icon";
+        return "application/octet-stream";
+    }
+
+    static const char* contentEncoding(const AssetEncoding encoding)
+    {
+        switch (encoding)
+        {
+        case AssetEncoding::GZIP: return "gzip";
+        case AssetEncoding::BROTLI: return "br";
+        default: return nullptr;
+        }
+    }
+
+    /**
+     * Accept-Encoding is a comma separated list of `coding[;q=value]`; a q of zero means "not acceptable".
+     */
+    static bool acceptsEncoding(const char* header, const char* encoding)
+    {
+        const size_t encodingLength = strlen(encoding);
+        const char* cursor = header;
+        while (*cursor)
+        {
+            while (*cursor == ' ' || *cursor == ',') ++cursor;
+            const char* token = cursor;
+            while (*cursor && *cursor != ',' && *cursor != ';' && *cursor != ' ') ++cursor;
+            const bool matches = static_cast<size_t>(cursor - token) == encodingLength
+                && strncasecmp(token, encoding, encodingLength) == 0;
+
+            bool rejected = false;
+            while (*cursor && *cursor != ',')
+            {
+                if (*cursor == ';')
+                {
+                    ++cursor;
+                    while (*cursor == ' ') ++cursor;
+                    if ((cursor[0] == 'q' || cursor[0] == 'Q') && cursor[1] == '=')
+                        rejected = strtof(cursor + 2, nullptr) <= 0.0f;
+                    continue;
+                }
+                ++cursor;
+            }
+            if (matches) return !rejected;
+        }
+        return false;
+    }
+
+private:
+    /**
+     * An interrupted upload leaves a valid header over erased or stale data, which would then be cached for a
+     * year under its fingerprinted name: every entry must lie inside the bundle with terminated strings, and
+     * the CRC written by build.mjs must match.
+     */
+    static bool isIntact(const AssetBundleHeader& header, const size_t partitionSize)
+    {
+        const size_t indexSize = sizeof(AssetBundleHeader) + header.entryCount * sizeof(AssetBundleEntry);
+        if (header.magic != AssetBundleHeader::MAGIC
+            || header.version != AssetBundleHeader::VERSION
+            || header.totalSize > partitionSize
+            || indexSize > header.totalSize)
+            return false;
+
+        const auto* bundle = reinterpret_cast<const uint8_t*>(&header);
+        const auto* index = reinterpret_cast<const AssetBundleEntry*>(bundle + sizeof(AssetBundleHeader));
+        for (uint16_t i = 0; i < header.entryCount; ++i)
+        {
+            const auto& entry = index[i];
+            if (!memchr(entry.path, '\0', sizeof(entry.path)) || !memchr(entry.etag, '\0', sizeof(entry.etag))
+                || entry.offset < indexSize || entry.offset > header.totalSize
+                || entry.length > header.totalSize - entry.offset)
+            {
+                ESP_LOGE(LOG_TAG, "Asset entry %u is malformed", i);
+                return false;
+            }
+        }
+
+        const uint32_t crc = crc32_le(0, bundle + sizeof(AssetBundleHeader),
+                                      header.totalSize - sizeof(AssetBundleHeader));
+        if (crc != header.crc)
+        {
+            ESP_LOGE(LOG_TAG, "Asset bundle CRC mismatch (%08X, expected %08X), incomplete upload?",
+                     static_cast<unsigned>(crc), static_cast<unsigned>(header.crc));
+            return false;
+        }
+        return true;
+    }
+
+    static int comparePath(const AssetBundleEntry& entry, const char* path)
+    {
+        return strncmp(entry.path, path, AssetBundleEntry::MAX_PATH_LENGTH + 1);
+    }
+
+    class AsyncAssetWebHandler final : public AsyncWebHandler
+    {
+        static constexpr auto IMMUTABLE_CACHE_CONTROL = "immutable, max-age=31536000";
+        static constexpr auto REVALIDATE_CACHE_CONTROL = "no-cache";
+        static constexpr auto IF_NONE_MATCH_HEADER = "If-None-Match";
+        static constexpr auto ACCEPT_ENCODING_HEADER = "Accept-Encoding";
+
+        const AssetBundle& bundle;
+
+    public:
+        explicit AsyncAssetWebHandler(const AssetBundle& bundle): bundle(bundle)
+        {
+        }
+
+        bool canHandle(AsyncWebServerRequest* request) const override
+        {
+            if (request->method() != HTTP_GET && request->method() != HTTP_HEAD)
+                return false;
+            return bundle.find(request->url().c_str()) != nullptr;
+        }
+
+        void handleRequest(AsyncWebServerRequest* request) override
+        {
+            const char* acceptEncoding = request->hasHeader(ACCEPT_ENCODING_HEADER)
+                                             ? request->header(ACCEPT_ENCODING_HEADER).c_str()
+                                             : nullptr;
+            const auto* entry = bundle.find(request->url().c_str(), acceptEncoding);
+            if (!entry)
+            {
+                request->send(404, "text/plain", "Not Found");
+                return;
+            }
+
+            if (request->hasHeader(IF_NONE_MATCH_HEADER)
+                && etagMatches(request->header(IF_NONE_MATCH_HEADER).c_str(), entry->etag))
+            {
+                auto* response = request->beginResponse(304);
+                addCacheHeaders(response, *entry);
+                request->send(response);
+                return;
+            }
+
+            auto* response = request->beginResponse(200, contentType(entry->path),
+                                                    bundle.data(*entry), entry->length);
+            if (const auto* encoding = contentEncoding(entry->encoding))
+                response->addHeader("Content-Encoding", encoding);
+            addCacheHeaders(response, *entry);
+            request->send(response);
+        }
+
+    private:
+        static void addCacheHeaders(AsyncWebServerResponse* response, const AssetBundleEntry& entry)
+        {
+            response->addHeader("ETag", entry.etag);
+            response->addHeader("Vary", "Accept-Encoding");
+            response->addHeader("Cache-Control",
+                                entry.isImmutable() ? IMMUTABLE_CACHE_CONTROL : REVALIDATE_CACHE_CONTROL);
+        }
+
+        /**
+         * If-None-Match carries "*" or a comma separated list of (possibly weak) entity tags.
+         */
+        static bool etagMatches(const char* header, const char* etag)
+        {
+            const size_t etagLength = strlen(etag);
+            const char* cursor = header;
+            while (*cursor)
+            {
+                while (*cursor == ' ' || *cursor == ',') ++cursor;
+                if (*cursor == '*') return true;
+                if (strncmp(cursor, "W/", 2) == 0) cursor += 2;
+                if (strncmp(cursor, etag, etagLength) == 0
+                    && (cursor[etagLength] == '\0' || cursor[etagLength] == ',' || cursor[etagLength] == ' '))
+                    return true;
+                while (*cursor && *cursor != ',') ++cursor;
+            }
+            return false;
+        }
+    };
+};
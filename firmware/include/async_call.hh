@@ -1,4 +1,35 @@
 #pragma once
-#include <functional>
+#include <cstdint>
 
-void async_call(std::function<void()> callback, uint32_t usStackDepth, uint32_t delayMs);
+#include "inplace_function.hh"
+
+using AsyncCallback = InplaceFunction<void(), 32>;
+
+/**
+ * Identifies a scheduled call; stays invalid (and harmless to cancel) when scheduling failed.
+ */
+struct AsyncCallHandle
+{
+    uint8_t slot = UINT8_MAX;
+    uint16_t generation = 0;
+
+    [[nodiscard]] bool isValid() const
+    {
+        return slot != UINT8_MAX;
+    }
+};
+
+struct AsyncCallStats
+{
+    uint8_t queueDepth;
+    uint8_t maxQueueDepth;
+    uint32_t executed;
+    uint32_t rejected;
+    uint32_t cancelled;
+    uint32_t maxLatencyUs;
+    uint32_t maxRuntimeUs;
+};
+
+AsyncCallHandle async_call(AsyncCallback callback, uint32_t delayMs = 0);
+bool async_call_cancel(AsyncCallHandle handle);
+AsyncCallStats async_call_stats();
@@ -7,6 +7,10 @@
 
 #include "alexa_integration.hh"
 #include "async_call.hh"
+#include "control_command.hh"
+#include "output_command.hh"
+#include "power_manager.hh"
+#include "timer_service.hh"
 #include "version.hh"
 #include "wifi_manager.hh"
 #include "webserver_handler.hh"
@@ -28,6 +32,7 @@ class BleManager
         static constexpr auto FIRMWARE_VERSION_CHARACTERISTIC = "aaaaaaaa-bbbb-cccc-dddd-eeeeeeee0002";
         static constexpr auto HTTP_CREDENTIALS_CHARACTERISTIC = "aaaaaaaa-bbbb-cccc-dddd-eeeeeeee0003";
         static constexpr auto DEVICE_HEAP_CHARACTERISTIC = "aaaaaaaa-bbbb-cccc-dddd-eeeeeeee0004";
+        static constexpr auto POWER_PROFILE_CHARACTERISTIC = "aaaaaaaa-bbbb-cccc-dddd-eeeeeeee000b";
 
         static constexpr auto WIFI_SERVICE = "12345678-1234-1234-1234-1234567890ab";
         static constexpr auto WIFI_DETAILS_CHARACTERISTIC = "aaaaaaaa-bbbb-cccc-dddd-eeeeeeee0005";
@@ -42,13 +47,14 @@ class BleManager
 
     static constexpr auto LOG_TAG = "Network";
     static constexpr auto BLE_TIMEOUT_MS = 30000;
-
-    unsigned long bluetoothTimeout = 0;
+    static constexpr uint32_t HEAP_NOTIFY_INTERVAL_MS = 500;
 
     Output& output;
     WiFiManager& wifiManager;
     AlexaIntegration& alexaIntegration;
-    WebServerHandler& webServerHandler;
+    PowerManager& powerManager;
+    OutputCommandQueue& outputCommands;
+    ControlCommandQueue& controlCommands;
 
     NimBLEServer* server = nullptr;
 
@@ -58,6 +64,7 @@ class BleManager
     NimBLECharacteristic* firmwareVersionCharacteristic = nullptr;
     NimBLECharacteristic* httpCredentialsCharacteristic = nullptr;
     NimBLECharacteristic* deviceHeapCharacteristic = nullptr;
+    NimBLECharacteristic* powerProfileCharacteristic = nullptr;
 
     NimBLEService* bleWiFiService = nullptr;
     NimBLECharacteristic* wifiDetailsCharacteristic = nullptr;
@@ -69,40 +76,48 @@ class BleManager
     NimBLECharacteristic* alexaCharacteristic = nullptr;
     NimBLECharacteristic* alexaColorCharacteristic = nullptr;
 
+    Signal<void(BleStatus)> statusChangedSignal;
+
+    Timer heapTimer{[this] { notifyHeap(); }};
+    Timer timeoutTimer{[this] { onTimeout(); }};
+
 public:
-    explicit BleManager(Output& output, WiFiManager& wifiManager, AlexaIntegration& alexaIntegration,
-                        WebServerHandler& webServerHandler)
-        : output(output), wifiManager(wifiManager), alexaIntegration(alexaIntegration),
-          webServerHandler(webServerHandler)
+    // Characteristic writes arrive on the NimBLE host task and are forwarded as commands to the main loop.
+    BleManager(Output& output, WiFiManager& wifiManager, AlexaIntegration& alexaIntegration,
+               PowerManager& powerManager, OutputCommandQueue& outputCommands,
+               ControlCommandQueue& controlCommands)
+        : output(output), wifiManager(wifiManager), alexaIntegration(alexaIntegration), powerManager(powerManager),
+          outputCommands(outputCommands), controlCommands(controlCommands)
     {
     }
 
     void start()
     {
-        bluetoothTimeout = millis() + BLE_TIMEOUT_MS;
+        timeoutTimer.start(BLE_TIMEOUT_MS);
         if (server != nullptr) return;
-        wifiManager.setDetailsChangedCallback([this](WiFiDetails wiFiScanResult)
+        wifiManager.detailsChanged().connect([this](const WiFiDetails& wiFiDetails)
         {
             if (!wifiDetailsCharacteristic) return;
-            wifiDetailsCharacteristic->setValue(reinterpret_cast<uint8_t*>(&wiFiScanResult), sizeof(wiFiScanResult));
+            wifiDetailsCharacteristic->setValue(reinterpret_cast<const uint8_t*>(&wiFiDetails), sizeof(wiFiDetails));
             wifiDetailsCharacteristic->notify(); // NOLINT
         });
 
-        wifiManager.setScanResultChangedCallback([this](WiFiScanResult wiFiScanResult)
+        wifiManager.scanResultChanged().connect([this](const WiFiScanResult& wiFiScanResult)
         {
             if (!wifiScanResultCharacteristic) return;
-            wifiScanResultCharacteristic->setValue(reinterpret_cast<uint8_t*>(&wiFiScanResult), sizeof(wiFiScanResult));
+            wifiScanResultCharacteristic->setValue(reinterpret_cast<const uint8_t*>(&wiFiScanResult),
+                                                   sizeof(wiFiScanResult));
             wifiScanResultCharacteristic->notify(); // NOLINT
         });
 
-        wifiManager.setScanStatusChangedCallback([this](WifiScanStatus wifiScanStatus)
+        wifiManager.scanStatusChanged().connect([this](WifiScanStatus wifiScanStatus)
         {
             if (!wifiScanStatusCharacteristic) return;
             wifiScanStatusCharacteristic->setValue(reinterpret_cast<uint8_t*>(&wifiScanStatus), sizeof(wifiScanStatus));
             wifiScanStatusCharacteristic->notify(); // NOLINT
         });
 
-        wifiManager.setStatusChangedCallback([this](WiFiStatus wiFiScanResultStatus)
+        wifiManager.statusChanged().connect([this](WiFiStatus wiFiScanResultStatus)
         {
             if (!wifiStatusCharacteristic) return;
             wifiStatusCharacteristic->setValue(reinterpret_cast<uint8_t*>(&wiFiScanResultStatus),
@@ -110,51 +125,39 @@ public:
             wifiStatusCharacteristic->notify(); // NOLINT
         });
 
-        wifiManager.setDeviceNameChangedCallback([this](char* deviceName)
+        wifiManager.deviceNameChanged().connect([this](const char* deviceName)
         {
             if (!deviceNameCharacteristic) return;
             const auto len = std::min(strlen(deviceName), static_cast<size_t>(DEVICE_NAME_MAX_LENGTH));
-            deviceNameCharacteristic->setValue(reinterpret_cast<uint8_t*>(deviceName), len);
+            deviceNameCharacteristic->setValue(reinterpret_cast<const uint8_t*>(deviceName), len);
             deviceNameCharacteristic->notify(); // NOLINT
         });
 
-        output.setNotifyBleCallback([this]()
+        powerManager.changed().connect([this](PowerState state)
+        {
+            if (!powerProfileCharacteristic) return;
+            powerProfileCharacteristic->setValue(reinterpret_cast<uint8_t*>(&state), sizeof(state));
+            powerProfileCharacteristic->notify(); // NOLINT
+        });
+
+        output.changed().connect([this](const bool fromBle)
         {
-            if (!alexaColorCharacteristic) return;
+            if (fromBle || !alexaColorCharacteristic) return;
             auto values = output.getValues();
             alexaColorCharacteristic->setValue(values.data(), values.size());
             alexaColorCharacteristic->notify(); // NOLINT
         });
 
+        powerManager.setBluetoothActive();
         setupBle();
         const auto advertising = this->server->getAdvertising();
         advertising->setName(wifiManager.getDeviceName());
         advertising->start();
+        statusChangedSignal.emit(BleStatus::ADVERTISING);
+        heapTimer.start(HEAP_NOTIFY_INTERVAL_MS, HEAP_NOTIFY_INTERVAL_MS);
         ESP_LOGI(LOG_TAG, "BLE advertising started with device name: %s", wifiManager.getDeviceName());
     }
 
-    void handle(const unsigned long now)
-    {
-        if (!deviceHeapCharacteristic) return;
-        static auto lastSend = now;
-        if (now - lastSend >= 500)
-        {
-            lastSend = now;
-            auto heapSize = ESP.getFreeHeap();
-            deviceHeapCharacteristic->setValue(reinterpret_cast<uint8_t*>(&heapSize), sizeof(heapSize));
-            deviceHeapCharacteristic->notify(); // NOLINT
-        }
-        if (this->getStatus() == BleStatus::CONNECTED)
-        {
-            bluetoothTimeout = now + BLE_TIMEOUT_MS;
-        }
-        else if (now > bluetoothTimeout)
-        {
-            ESP_LOGW(LOG_TAG, "No BLE client connected for %d ms, stopping BLE server.", BLE_TIMEOUT_MS);
-            this->stop();
-        }
-    }
-
     void stop() const
     {
         if (server == nullptr) return;
@@ -167,6 +170,14 @@ public:
         esp_restart();
     }
 
+    /**
+     * Fired on start, connect and disconnect; connect/disconnect come from the NimBLE host task.
+     */
+    Signal<void(BleStatus)>& statusChanged()
+    {
+        return statusChangedSignal;
+    }
+
     [[nodiscard]] BleStatus getStatus() const
     {
         if (this->server == nullptr)
@@ -197,6 +208,27 @@ public:
     }
 
 private:
+    void notifyHeap()
+    {
+        if (!deviceHeapCharacteristic) return;
+        auto heapSize = ESP.getFreeHeap();
+        deviceHeapCharacteristic->setValue(reinterpret_cast<uint8_t*>(&heapSize), sizeof(heapSize));
+        deviceHeapCharacteristic->notify(); // NOLINT
+        if (this->getStatus() == BleStatus::CONNECTED)
+            timeoutTimer.start(BLE_TIMEOUT_MS);
+    }
+
+    void onTimeout()
+    {
+        if (this->getStatus() == BleStatus::CONNECTED)
+        {
+            timeoutTimer.start(BLE_TIMEOUT_MS);
+            return;
+        }
+        ESP_LOGW(LOG_TAG, "No BLE client connected for %d ms, stopping BLE server.", BLE_TIMEOUT_MS);
+        this->stop();
+    }
+
     void setupBle()
     {
         BLEDevice::init(wifiManager.getDeviceName());
@@ -240,6 +272,13 @@ private:
             new HttpCredentialsCallback(this)
         );
 
+        powerProfileCharacteristic = createCharacteristic(
+            deviceDetailsService,
+            BLE_UUID::POWER_PROFILE_CHARACTERISTIC,
+            READ | WRITE | NOTIFY,
+            new PowerProfileCallback(this)
+        );
+
         deviceHeapCharacteristic = createCharacteristic(
             deviceDetailsService,
             BLE_UUID::DEVICE_HEAP_CHARACTERISTIC,
@@ -333,7 +372,7 @@ private:
                 async_call([this]()
                 {
                     esp_restart();
-                }, 1024, 50);
+                }, 50);
             }
             else
             {
@@ -364,13 +403,16 @@ private:
             const auto data = value.data();
             const auto deviceName = reinterpret_cast<const char*>(data);
 
-            if (const auto length = pCharacteristic->getLength(); length == 0 || length > DEVICE_NAME_MAX_LENGTH)
+            const auto length = pCharacteristic->getLength();
+            if (length == 0 || length > DEVICE_NAME_MAX_LENGTH)
             {
                 ESP_LOGE(LOG_TAG, "Invalid device name length: %d", static_cast<int>(length));
                 return;
             }
 
-            net->wifiManager.setDeviceName(deviceName);
+            ControlCommands::SetDeviceName command = {};
+            memcpy(command.name, deviceName, length);
+            net->controlCommands.post(command);
         }
     };
 
@@ -401,7 +443,7 @@ private:
                 return;
             }
             memcpy(&credentials, pCharacteristic->getValue().data(), sizeof(HttpCredentials));
-            net->webServerHandler.updateCredentials(credentials);
+            net->controlCommands.post(ControlCommands::SetHttpCredentials{credentials});
         }
 
         void onRead(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) override
@@ -411,6 +453,36 @@ private:
         }
     };
 
+    /**
+     * Reads as a PowerState; a write of one PowerProfile byte selects the profile.
+     */
+    class PowerProfileCallback final : public NimBLECharacteristicCallbacks
+    {
+        BleManager* net;
+
+    public:
+        explicit PowerProfileCallback(BleManager* n) : net(n)
+        {
+        }
+
+        void onWrite(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) override
+        {
+            const auto value = pCharacteristic->getValue();
+            if (value.size() != sizeof(PowerProfile) || !PowerState::isValid(value.data()[0]))
+            {
+                ESP_LOGE(LOG_TAG, "Received invalid power profile of length %d", value.size());
+                return;
+            }
+            net->controlCommands.post(ControlCommands::SetPowerProfile{static_cast<PowerProfile>(value.data()[0])});
+        }
+
+        void onRead(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) override
+        {
+            PowerState state = net->powerManager.getState();
+            pCharacteristic->setValue(reinterpret_cast<uint8_t*>(&state), sizeof(state));
+        }
+    };
+
     class WiFiDetailsCallback final : public NimBLECharacteristicCallbacks
     {
         BleManager* net;
@@ -452,7 +524,7 @@ private:
                 return;
             }
             memcpy(&details, pCharacteristic->getValue().data(), sizeof(WiFiConnectionDetails));
-            net->wifiManager.connect(details);
+            net->controlCommands.post(ControlCommands::ConnectWiFi{details});
         }
     };
 
@@ -473,7 +545,7 @@ private:
 
         void onWrite(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) override
         {
-            net->wifiManager.triggerScan();
+            net->controlCommands.post(ControlCommands::TriggerWiFiScan{});
         }
     };
 
@@ -511,7 +583,7 @@ private:
                 return;
             }
             memcpy(&settings, pCharacteristic->getValue().data(), sizeof(AlexaIntegrationSettings));
-            net->alexaIntegration.applySettings(settings);
+            net->controlCommands.post(ControlCommands::ApplyAlexaSettings{settings});
         }
 
         void onRead(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) override
@@ -539,8 +611,7 @@ private:
                 return;
             }
             memcpy(values.data(), pCharacteristic->getValue().data(), values.size());
-            net->output.setValues(values, false);
-            net->alexaIntegration.updateValues();
+            net->outputCommands.post(OutputCommands::SetValuesFromBle{values});
         }
 
         void onRead(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) override
@@ -559,9 +630,15 @@ private:
         {
         }
 
+        void onConnect(NimBLEServer* pServer, NimBLEConnInfo& connInfo) override
+        {
+            net->statusChangedSignal.emit(BleStatus::CONNECTED);
+        }
+
         void onDisconnect(NimBLEServer* pServer, NimBLEConnInfo& connInfo, int reason) override
         {
             pServer->getAdvertising()->start();
+            net->statusChangedSignal.emit(net->getStatus());
         }
     };
 };
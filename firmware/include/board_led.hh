@@ -7,92 +7,130 @@
 #include "light.hh"
 #include "hardware.hh"
 #include "ble_manager.hh"
+#include "ota_handler.hh"
+#include "wifi_manager.hh"
 #include "wifi_model.hh"
+#include "timer_service.hh"
 
 class BoardLED
 {
     static constexpr uint8_t MAX_BRIGHTNESS = 32;
-    static constexpr unsigned long BLINK_INTERVAL_MS = 20;
+    static constexpr uint32_t BLINK_INTERVAL_MS = 20;
+    static constexpr uint32_t STEADY_INTERVAL_MS = 100;
     static constexpr int TRANSITION_STEP = 4;
 
+    BleManager& bleManager;
+    WiFiManager& wifiManager;
+    OtaHandler& otaHandler;
+
     std::array<Light, 3> leds = {
-        Light(static_cast<gpio_num_t>(static_cast<uint8_t>(Hardware::Pin::BoardLed::RED)), true),
-        Light(static_cast<gpio_num_t>(static_cast<uint8_t>(Hardware::Pin::BoardLed::GREEN)), true),
-        Light(static_cast<gpio_num_t>(static_cast<uint8_t>(Hardware::Pin::BoardLed::BLUE)), true)
+        Light(static_cast<gpio_num_t>(static_cast<uint8_t>(Hardware::Pin::BoardLed::RED)), true, false),
+        Light(static_cast<gpio_num_t>(static_cast<uint8_t>(Hardware::Pin::BoardLed::GREEN)), true, false),
+        Light(static_cast<gpio_num_t>(static_cast<uint8_t>(Hardware::Pin::BoardLed::BLUE)), true, false)
     };
 
     static_assert(static_cast<size_t>(Color::Blue) < 3, "Color enum out of bounds for BoardLED");
 
-    unsigned long lastBlinkTime = 0;
     int fadeValue = 0;
     int fadeDirection = TRANSITION_STEP;
 
+    // Ticks fast while fading and slowly while the color is steady, so it still picks up status changes.
+    uint32_t refreshInterval = 0;
+    Timer refreshTimer{[this] { refresh(); }};
+
 public:
+    BoardLED(BleManager& bleManager, WiFiManager& wifiManager, OtaHandler& otaHandler)
+        : bleManager(bleManager), wifiManager(wifiManager), otaHandler(otaHandler)
+    {
+    }
+
     void begin()
     {
         for (auto& led : leds)
             led.setup();
+        refresh();
+
+        // Status changes are signalled from other tasks: re-render on the main loop right away instead of
+        // waiting for the next steady refresh.
+        bleManager.statusChanged().connect([this](BleStatus) { refreshNow(); });
+        wifiManager.statusChanged().connect([this](WiFiStatus) { refreshNow(); });
+        wifiManager.scanStatusChanged().connect([this](WifiScanStatus) { refreshNow(); });
+        otaHandler.statusChanged().connect([this](OtaStatus) { refreshNow(); });
+    }
+
+private:
+    void refreshNow()
+    {
+        refreshTimer.start(0, refreshInterval);
     }
 
-    void handle(const unsigned long now, const BleStatus bleStatus,
-                const WifiScanStatus wifiScanStatus, const WiFiStatus wifiStatus,
-                const bool isOtaUpdateRunning)
+    void refresh()
+    {
+        const uint32_t interval = render() ? BLINK_INTERVAL_MS : STEADY_INTERVAL_MS;
+        if (interval != refreshInterval)
+        {
+            refreshInterval = interval;
+            refreshTimer.start(interval, interval);
+        }
+    }
+
+    /**
+     * Shows the current status and returns true when the pattern is a fade.
+     */
+    bool render()
     {
         // If OTA update is running, blink purple
-        if (isOtaUpdateRunning)
+        if (otaHandler.getStatus() == OtaStatus::Started)
         {
-            const uint8_t value = getFadeValue(now);
+            const uint8_t value = nextFadeValue();
             this->setColor({value, 0, value}); // Purple
-            return;
+            return true;
         }
+        const auto bleStatus = bleManager.getStatus();
         // Steady yellow: connected to a BLE client
         if (bleStatus == BleStatus::CONNECTED)
         {
             this->setColor({MAX_BRIGHTNESS, MAX_BRIGHTNESS, 0});
-            return;
+            return false;
         }
         // Blinking blue: advertising, but not connected to a client
         if (bleStatus == BleStatus::ADVERTISING)
         {
-            const uint8_t value = getFadeValue(now);
+            const uint8_t value = nextFadeValue();
             this->setColor({0, 0, value});
-            return;
+            return true;
         }
         // Blinking yellow: Wi-Fi scan running
-        if (wifiScanStatus == WifiScanStatus::RUNNING)
+        if (wifiManager.getScanStatus() == WifiScanStatus::RUNNING)
         {
-            const uint8_t value = getFadeValue(now);
+            const uint8_t value = nextFadeValue();
             this->setColor({value, value, 0});
-            return;
+            return true;
         }
         // Steady green: connected to Wi-Fi
-        if (wifiStatus == WiFiStatus::CONNECTED)
+        if (wifiManager.getStatus() == WiFiStatus::CONNECTED)
         {
             this->setColor({0, MAX_BRIGHTNESS, 0});
-            return;
+            return false;
         }
         // Steady red: not connected to Wi-Fi
         this->setColor({MAX_BRIGHTNESS, 0, 0});
+        return false;
     }
 
-private:
-    uint8_t getFadeValue(const unsigned long now)
+    uint8_t nextFadeValue()
     {
-        if (now - lastBlinkTime >= BLINK_INTERVAL_MS)
+        fadeValue += fadeDirection;
+
+        if (fadeValue >= MAX_BRIGHTNESS)
+        {
+            fadeValue = MAX_BRIGHTNESS;
+            fadeDirection = -TRANSITION_STEP;
+        }
+        else if (fadeValue <= 0)
         {
-            lastBlinkTime = now;
-            fadeValue += fadeDirection;
-
-            if (fadeValue >= MAX_BRIGHTNESS)
-            {
-                fadeValue = MAX_BRIGHTNESS;
-                fadeDirection = -TRANSITION_STEP;
-            }
-            else if (fadeValue <= 0)
-            {
-                fadeValue = 0;
-                fadeDirection = TRANSITION_STEP;
-            }
+            fadeValue = 0;
+            fadeDirection = TRANSITION_STEP;
         }
         return static_cast<uint8_t>(fadeValue);
     }
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <esp_timer.h>
+
+/**
+ * Start-up timeline: each boot phase records the esp_timer time (µs since start-up) at which it finished.
+ * Phases are marked from setup() and from Wi-Fi event callbacks, so a slot is reserved atomically before it is
+ * written; readers skip slots that are not filled in yet.
+ */
+class BootProfiler
+{
+    static constexpr uint8_t MAX_PHASES = 16;
+
+    struct Phase
+    {
+        std::atomic<const char*> name; // string literal, nullptr until the slot is written
+        uint32_t endUs;
+    };
+
+    static inline Phase phases[MAX_PHASES] = {};
+    static inline std::atomic<uint8_t> reserved{0};
+
+public:
+    /**
+     * Records that `name` (a string literal) finished now. Phases beyond MAX_PHASES are dropped.
+     */
+    static void mark(const char* name)
+    {
+        const auto now = static_cast<uint32_t>(esp_timer_get_time());
+        uint8_t index = reserved.load();
+        do
+        {
+            if (index >= MAX_PHASES) return;
+        }
+        while (!reserved.compare_exchange_weak(index, index + 1));
+        phases[index].endUs = now;
+        phases[index].name.store(name);
+    }
+
+    /**
+     * Like mark(), but only the first occurrence counts (e.g. the first GOT_IP of many).
+     */
+    static void markOnce(const char* name)
+    {
+        if (!getUs(name))
+            mark(name);
+    }
+
+    /**
+     * End time of the phase, or 0 when it has not been reached.
+     */
+    static uint32_t getUs(const char* name)
+    {
+        const uint8_t count = std::min(reserved.load(), MAX_PHASES);
+        for (uint8_t i = 0; i < count; ++i)
+            if (const char* phaseName = phases[i].name.load(); phaseName && strcmp(phaseName, name) == 0)
+                return phases[i].endUs;
+        return 0;
+    }
+
+    /**
+     * Phases in the order they finished, with the time each took since the previous one.
+     */
+    static void toJson(const JsonArray& to)
+    {
+        const uint8_t count = std::min(reserved.load(), MAX_PHASES);
+        uint32_t previousUs = 0;
+        for (uint8_t i = 0; i < count; ++i)
+        {
+            const char* name = phases[i].name.load();
+            if (!name) continue;
+            const auto phase = to.add<JsonObject>();
+            phase["name"] = name;
+            phase["endUs"] = phases[i].endUs;
+            phase["durationUs"] = phases[i].endUs > previousUs ? phases[i].endUs - previousUs : 0;
+            previousUs = std::max(previousUs, phases[i].endUs);
+        }
+    }
+};
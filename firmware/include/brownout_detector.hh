@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Spots a collapsing supply early from a stream of voltage samples. Pure logic with no Arduino dependency, so
+ * recorded traces can be replayed through it on the host.
+ *
+ * A fast moving average filters ADC noise, a slow one tracks the nominal supply. A drop is reported once
+ * when the filtered voltage falls below `dropRatio` of the nominal level, or falls faster than
+ * `maxFallVoltsPerSecond` while already below `trendRatio`. Once armed, the nominal level only follows a rising
+ * supply, so a slow sag is caught as well. It re-arms after the supply has been back above `trendRatio` for
+ * `rearmSamples` consecutive samples. A supply that is still below `minSupplyVolts` after `settleSamples` is
+ * reported as absent once; the caller can then sample rarely and start over with a fresh detector when
+ * isPlausible() sees a supply.
+ */
+class BrownoutDetector
+{
+public:
+    struct Config
+    {
+        float minSupplyVolts = 9.0f; // below this the sensor is considered absent (USB or bench powered)
+        float dropRatio = 0.85f;
+        float trendRatio = 0.95f;
+        float maxFallVoltsPerSecond = 20.0f;
+        uint16_t settleSamples = 50; // samples before the nominal level is trusted
+        uint16_t rearmSamples = 50;
+    };
+
+    enum class Event : uint8_t
+    {
+        NONE,
+        SUPPLY_VALID, // nominal supply established, drop detection is armed
+        NO_SUPPLY, // settled without a plausible reading: nothing to watch
+        DROP // the supply is collapsing: persist now
+    };
+
+private:
+    static constexpr float FAST_ALPHA = 0.25f;
+    static constexpr float SLOW_ALPHA = 1.0f / 64.0f;
+
+    Config config;
+    float fast = 0.0f;
+    float nominal = 0.0f;
+    uint32_t samples = 0;
+    uint16_t recoveredSamples = 0;
+    bool valid = false;
+    bool dropped = false;
+
+public:
+    BrownoutDetector() = default;
+
+    explicit BrownoutDetector(const Config& config) : config(config)
+    {
+    }
+
+    /**
+     * Feeds one sample taken `intervalMs` after the previous one.
+     */
+    Event sample(const float volts, const uint32_t intervalMs)
+    {
+        if (samples++ == 0)
+        {
+            fast = nominal = volts;
+            return Event::NONE;
+        }
+        const float previous = fast;
+        fast += FAST_ALPHA * (volts - fast);
+        const float fallRate = intervalMs > 0 ? (previous - fast) * 1000.0f / static_cast<float>(intervalMs) : 0.0f;
+
+        if (!valid)
+        {
+            nominal += SLOW_ALPHA * (fast - nominal);
+            if (samples >= config.settleSamples && nominal >= config.minSupplyVolts)
+            {
+                valid = true;
+                return Event::SUPPLY_VALID;
+            }
+            return samples == config.settleSamples ? Event::NO_SUPPLY : Event::NONE;
+        }
+
+        if (dropped)
+        {
+            recoveredSamples = fast >= nominal * config.trendRatio ? recoveredSamples + 1 : 0;
+            if (recoveredSamples >= config.rearmSamples)
+            {
+                dropped = false;
+                recoveredSamples = 0;
+            }
+            return Event::NONE;
+        }
+
+        const bool belowDrop = fast < nominal * config.dropRatio;
+        const bool fallingFast = fast < nominal * config.trendRatio && fallRate > config.maxFallVoltsPerSecond;
+        if (belowDrop || fallingFast)
+        {
+            dropped = true;
+            recoveredSamples = 0;
+            return Event::DROP;
+        }
+        // Once armed the nominal level only follows a rising supply: tracking a falling one, however slowly,
+        // would let a sag drag it down and never cross dropRatio.
+        if (fast > nominal)
+            nominal += SLOW_ALPHA * (fast - nominal);
+        return Event::NONE;
+    }
+
+    [[nodiscard]] bool isPlausible(const float volts) const { return volts >= config.minSupplyVolts; }
+    [[nodiscard]] bool isSupplyValid() const { return valid; }
+    [[nodiscard]] bool isDropped() const { return dropped; }
+    [[nodiscard]] float getVolts() const { return fast; }
+    [[nodiscard]] float getNominalVolts() const { return nominal; }
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstring>
+
+#include "alexa_integration.hh"
+#include "control_command.hh"
+#include "main_loop.hh"
+#include "output.hh"
+#include "output_command.hh"
+#include "power_manager.hh"
+#include "webserver_handler.hh"
+#include "wifi_manager.hh"
+
+/**
+ * Single consumer of the command queues: applies posted commands on the main loop task.
+ */
+class CommandHandler
+{
+    OutputCommandQueue& outputCommands;
+    ControlCommandQueue& controlCommands;
+    Output& output;
+    WiFiManager& wifiManager;
+    WebServerHandler& webServerHandler;
+    AlexaIntegration& alexaIntegration;
+    PowerManager& powerManager;
+
+public:
+    CommandHandler(OutputCommandQueue& outputCommands,
+                   ControlCommandQueue& controlCommands,
+                   Output& output,
+                   WiFiManager& wifiManager,
+                   WebServerHandler& webServerHandler,
+                   AlexaIntegration& alexaIntegration,
+                   PowerManager& powerManager)
+        : outputCommands(outputCommands),
+          controlCommands(controlCommands),
+          output(output),
+          wifiManager(wifiManager),
+          webServerHandler(webServerHandler),
+          alexaIntegration(alexaIntegration),
+          powerManager(powerManager)
+    {
+    }
+
+    void begin()
+    {
+        MainLoop::get().subscribe(MainLoop::COMMANDS, [this]
+        {
+            outputCommands.drain(*this);
+            controlCommands.drain(*this);
+        });
+    }
+
+    void operator()(const OutputCommands::TurnOff&) const
+    {
+        output.turnOff();
+    }
+
+    void operator()(const OutputCommands::SetState& command) const
+    {
+        output.setState(command.state);
+    }
+
+    void operator()(const OutputCommands::SetColor& command) const
+    {
+        const auto& values = command.values;
+        output.setColor(values[0], values[1], values[2], values[3], command.transitionMs);
+    }
+
+    void operator()(const OutputCommands::SetChannel& command) const
+    {
+        output.update(command.color, command.value, true, command.transitionMs);
+    }
+
+    void operator()(const OutputCommands::SetValuesFromBle& command) const
+    {
+        output.setValues(command.values, false);
+    }
+
+    void operator()(const ControlCommands::TriggerWiFiScan&) const
+    {
+        wifiManager.triggerScan();
+    }
+
+    void operator()(const ControlCommands::ConnectWiFi& command) const
+    {
+        wifiManager.connect(command.details);
+    }
+
+    void operator()(const ControlCommands::SetDeviceName& command) const
+    {
+        wifiManager.setDeviceName(command.name);
+    }
+
+    void operator()(const ControlCommands::SetHttpCredentials& command) const
+    {
+        webServerHandler.updateCredentials(command.credentials);
+    }
+
+    void operator()(const ControlCommands::ApplyAlexaSettings& command) const
+    {
+        alexaIntegration.applySettings(command.settings);
+    }
+
+    void operator()(const ControlCommands::SetPowerProfile& command) const
+    {
+        powerManager.setProfile(command.profile);
+    }
+
+    void operator()(const ControlCommands::SetStaticIp& command) const
+    {
+        wifiManager.setStaticIp(command.staticIp);
+    }
+
+    void operator()(const ControlCommands::ForgetWiFiNetwork& command) const
+    {
+        wifiManager.forgetNetwork(command.ssid);
+    }
+};
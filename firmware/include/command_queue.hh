@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <variant>
+#include <ArduinoJson.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include "main_loop.hh"
+#include "mpsc_ring.hh"
+
+/**
+ * Typed mailbox in front of a component owned by the main loop task. Network callbacks (AsyncTCP, NimBLE
+ * host, ...) post a command and return immediately; the loop task applies it, so the owner is only ever
+ * mutated from one task. `Command` is a std::variant of the accepted message types.
+ */
+template <typename Command, size_t Capacity>
+class CommandQueue
+{
+    static constexpr auto LOG_TAG = "CommandQueue";
+
+    struct Envelope
+    {
+        uint32_t enqueuedUs = 0; // low 32 bits of esp_timer time
+        Command command;
+    };
+
+    MpscRing<Envelope, Capacity> ring;
+    std::atomic<uint32_t> posted{0};
+    std::atomic<uint32_t> dropped{0};
+    uint32_t executed = 0;
+    uint32_t maxDepth = 0;
+    uint32_t lastLatencyUs = 0;
+    uint32_t maxLatencyUs = 0;
+
+public:
+    /**
+     * Safe from any task. Returns false (and counts a drop) when the queue is full.
+     */
+    bool post(Command command)
+    {
+        Envelope envelope{static_cast<uint32_t>(esp_timer_get_time()), std::move(command)};
+        if (!ring.tryPush(std::move(envelope)))
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            ESP_LOGW(LOG_TAG, "Command queue full, command dropped");
+            return false;
+        }
+        posted.fetch_add(1, std::memory_order_relaxed);
+        MainLoop::post(MainLoop::COMMANDS);
+        return true;
+    }
+
+    /**
+     * Owner task only: applies every queued command with `visitor` (one overload per command type).
+     */
+    template <typename Visitor>
+    void drain(Visitor&& visitor)
+    {
+        maxDepth = std::max<uint32_t>(maxDepth, ring.size());
+        Envelope envelope;
+        while (ring.tryPop(envelope))
+        {
+            const uint32_t latency = static_cast<uint32_t>(esp_timer_get_time()) - envelope.enqueuedUs;
+            lastLatencyUs = latency;
+            maxLatencyUs = std::max(maxLatencyUs, latency);
+            ++executed;
+            std::visit(visitor, envelope.command);
+        }
+    }
+
+    void toJson(const JsonObject& to) const
+    {
+        to["posted"] = posted.load(std::memory_order_relaxed);
+        to["dropped"] = dropped.load(std::memory_order_relaxed);
+        to["executed"] = executed;
+        to["maxDepth"] = maxDepth;
+        to["lastLatencyUs"] = lastLatencyUs;
+        to["maxLatencyUs"] = maxLatencyUs;
+    }
+};
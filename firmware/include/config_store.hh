@@ -0,0 +1,793 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ArduinoJson.h>
+#include <Preferences.h>
+#include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h> // NOLINT
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <rom/crc.h>
+
+#include "alexa_model.hh"
+#include "hardware.hh"
+#include "http_credentials.hh"
+#include "light_state.hh"
+#include "power_model.hh"
+#include "rtc_light_mirror.hh"
+#include "timer_service.hh"
+#include "wifi_model.hh"
+
+#pragma pack(push, 1)
+/**
+ * Everything the firmware persists. The layout is append-only: new fields go at the end together with a
+ * ConfigStore::VERSION bump, so an older blob loads as a prefix and the new fields keep their defaults.
+ */
+struct ConfigData
+{
+    LightState lights[Hardware::Pin::OUTPUTS.size()] = {}; // indexed like Hardware::Pin::OUTPUTS
+    char deviceName[DEVICE_NAME_TOTAL_LENGTH] = {}; // empty: derived from the MAC address
+    WiFiConnectionDetails wifi = {}; // encryptionType INVALID: no credentials stored
+    HttpCredentials http = {};
+    AlexaIntegrationSettings alexa = {};
+    uint8_t sceneCount = 0;
+    AlexaScene scenes[AlexaScene::MAX_SCENES] = {};
+    // Version 2
+    WiFiFastConnect wifiFastConnect = {}; // follows `wifi`: cleared whenever the SSID changes
+    WiFiStaticIp wifiStaticIp = {};
+    // Version 3
+    WiFiConnectionDetails wifiFallbacks[WIFI_MAX_KNOWN_NETWORKS - 1] = {}; // networks used before `wifi`, newest first
+    // Version 4
+    PowerProfile powerProfile = PowerProfile::BALANCED;
+    // Version 5
+    char wifiStaticIpSsid[WIFI_MAX_SSID_LENGTH + 1] = {}; // the network `wifiStaticIp` was configured for
+};
+
+struct ConfigHeader
+{
+    uint32_t magic = 0;
+    uint16_t version = 0;
+    uint16_t size = 0; // bytes of ConfigData following the header
+    uint32_t crc = 0; // CRC-32 of those bytes
+};
+#pragma pack(pop)
+
+/**
+ * Typed configuration held in RAM. It is read from one NVS blob at boot (migrating the legacy per-component
+ * namespaces on first start), and every change is coalesced by a write-behind timer into a single blob
+ * commit, so a burst of changes costs one flash write. The timer only hands a snapshot to a background
+ * writer task, so a slow NVS write (page erase) never runs on the main loop. Accessors are safe from any
+ * task; pending changes are also flushed from a shutdown handler before every esp_restart().
+ */
+class ConfigStore
+{
+    static constexpr auto LOG_TAG = "ConfigStore";
+    static constexpr auto PREFERENCES_NAME = "config";
+    static constexpr auto BLOB_KEY = "blob";
+    static constexpr uint32_t MAGIC = 0x57424752; // "RGBW"
+    static constexpr uint16_t VERSION = 5;
+    static constexpr uint32_t WRITE_BEHIND_MS = 1000;
+    static constexpr uint32_t FLUSH_TIMEOUT_MS = 1000;
+    static constexpr uint32_t WRITER_STACK_SIZE = 3072;
+    static constexpr BaseType_t WRITER_CORE = 0; // away from the Arduino loop task on core 1
+    static constexpr UBaseType_t WRITER_PRIORITY = tskIDLE_PRIORITY + 1;
+    // Above Wi-Fi, lwIP, BLE and esp_timer on core 0: the supply is collapsing and the write must not wait.
+    static constexpr UBaseType_t URGENT_WRITER_PRIORITY = configMAX_PRIORITIES - 1;
+
+    static_assert(sizeof(ConfigData) <= UINT16_MAX, "ConfigData too large for the header");
+
+#pragma pack(push, 1)
+    /**
+     * Queue item for the writer task; header and data are contiguous, as stored in NVS.
+     */
+    struct Snapshot
+    {
+        uint32_t generation = 0;
+        ConfigHeader header;
+        ConfigData data;
+    };
+#pragma pack(pop)
+
+    static constexpr size_t BLOB_SIZE = sizeof(ConfigHeader) + sizeof(ConfigData);
+
+    mutable std::mutex mutex; // guards live and dirty
+    Snapshot live; // the RAM copy; its generation counts changes
+    ConfigData& data = live.data;
+    bool dirty = false;
+    bool discarded = false; // a factory reset is under way: changes are neither written nor mirrored
+    uint64_t commitDueMs = 0;
+    uint32_t lightWriteDelayMs = WRITE_BEHIND_MS;
+    Timer commitTimer{[this] { enqueueSnapshot(); }};
+
+    QueueHandle_t snapshots = nullptr; // one slot, overwritten: only the newest snapshot matters
+    TaskHandle_t writer = nullptr;
+    std::atomic<bool> urgentPending{false}; // set by commitNow(), cleared when the writer takes a snapshot
+    Snapshot incoming; // only touched by the writer task
+    std::atomic<uint32_t> writtenGeneration{0};
+
+    const char* source = "defaults";
+    uint32_t loadUs = 0;
+    uint32_t updates = 0;
+    uint32_t commits = 0;
+    uint32_t failedCommits = 0;
+    uint32_t urgentCommits = 0;
+    uint32_t lastCommitUs = 0;
+    bool restoredFromRtc = false;
+
+    ConfigStore() = default;
+
+public:
+    static ConfigStore& get()
+    {
+        static ConfigStore instance;
+        return instance;
+    }
+
+    /**
+     * Loads the configuration into RAM. Call once, right after nvs_flash_init() and before any component
+     * reads its settings.
+     */
+    void begin()
+    {
+        const int64_t start = esp_timer_get_time();
+        const bool loaded = load();
+        if (!loaded)
+        {
+            source = migrateLegacy() ? "legacy" : "defaults";
+            sanitize();
+        }
+        restoreRtcMirror();
+        loadUs = static_cast<uint32_t>(esp_timer_get_time() - start);
+
+        const QueueHandle_t queue = xQueueCreate(1, sizeof(Snapshot));
+        snapshots = queue;
+        if (!queue || xTaskCreatePinnedToCore(writerTask, "ConfigWriter", WRITER_STACK_SIZE, this,
+                                              WRITER_PRIORITY, &writer, WRITER_CORE) != pdPASS)
+        {
+            ESP_LOGE(LOG_TAG, "Failed to start the writer task, writing synchronously");
+            if (queue) vQueueDelete(queue);
+            snapshots = nullptr;
+        }
+        esp_register_shutdown_handler([] { get().flush(); });
+
+        if (!loaded)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            markDirty(WRITE_BEHIND_MS);
+            lock.unlock();
+            if (flush())
+                clearLegacy();
+        }
+        ESP_LOGI(LOG_TAG, "Configuration (%u bytes) loaded from %s in %u us",
+                 static_cast<unsigned>(sizeof(ConfigData)), source, static_cast<unsigned>(loadUs));
+    }
+
+    [[nodiscard]] LightState getLight(const uint8_t index) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return data.lights[index];
+    }
+
+    /**
+     * Light changes are the frequent ones: they use their own write-behind delay (see setLightWriteDelay())
+     * and are mirrored to RTC memory right away.
+     */
+    void setLight(const uint8_t index, const LightState& state)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (data.lights[index] == state) return;
+        data.lights[index] = state;
+        if (!discarded) RtcLightMirror::set(index, state);
+        markDirty(lightWriteDelayMs);
+    }
+
+    /**
+     * Write-behind delay for light changes. The supply monitor raises it to a long fallback interval once
+     * it can warn about power loss, and commits with commitNow() when the supply collapses.
+     */
+    void setLightWriteDelay(const uint32_t delayMs)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        lightWriteDelayMs = delayMs;
+    }
+
+    /**
+     * Copies the stored device name into `out` (DEVICE_NAME_TOTAL_LENGTH bytes); false when none is stored.
+     */
+    bool getDeviceName(char* out) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (data.deviceName[0] == '\0') return false;
+        std::memcpy(out, data.deviceName, DEVICE_NAME_TOTAL_LENGTH);
+        return true;
+    }
+
+    void setDeviceName(const char* name)
+    {
+        char value[DEVICE_NAME_TOTAL_LENGTH] = {};
+        std::strncpy(value, name, DEVICE_NAME_MAX_LENGTH);
+        update(data.deviceName, value);
+    }
+
+    [[nodiscard]] std::optional<WiFiConnectionDetails> getWiFiCredentials() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (data.wifi.encryptionType == WiFiEncryptionType::INVALID) return std::nullopt;
+        return data.wifi;
+    }
+
+    /**
+     * Makes `details` the primary network. A previous primary with another SSID moves to the front of the
+     * fallbacks (the oldest one drops out), and the cached access point is dropped.
+     */
+    void setWiFiCredentials(const WiFiConnectionDetails& details)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (std::memcmp(&data.wifi, &details, sizeof(WiFiConnectionDetails)) == 0) return;
+        if (std::strcmp(data.wifi.ssid, details.ssid) != 0)
+        {
+            data.wifiFastConnect = {};
+            removeFallback(details.ssid);
+            if (data.wifi.encryptionType != WiFiEncryptionType::INVALID)
+            {
+                std::copy_backward(std::begin(data.wifiFallbacks), std::end(data.wifiFallbacks) - 1,
+                                   std::end(data.wifiFallbacks));
+                data.wifiFallbacks[0] = data.wifi;
+            }
+        }
+        data.wifi = details;
+        markDirty(WRITE_BEHIND_MS);
+    }
+
+    /**
+     * Forgets every stored network.
+     */
+    void clearWiFiCredentials()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        data.wifi = {};
+        data.wifiFastConnect = {};
+        std::fill(std::begin(data.wifiFallbacks), std::end(data.wifiFallbacks), WiFiConnectionDetails{});
+        clearStaticIp();
+        markDirty(WRITE_BEHIND_MS);
+    }
+
+    /**
+     * Forgets one network; forgetting the primary promotes the newest fallback. False when it is not stored.
+     */
+    bool forgetWiFiNetwork(const char* ssid)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (data.wifi.encryptionType != WiFiEncryptionType::INVALID && std::strcmp(data.wifi.ssid, ssid) == 0)
+        {
+            data.wifi = data.wifiFallbacks[0];
+            data.wifiFastConnect = {};
+            removeFallback(data.wifi.ssid);
+        }
+        else if (!removeFallback(ssid))
+        {
+            return false;
+        }
+        if (std::strcmp(data.wifiStaticIpSsid, ssid) == 0)
+            clearStaticIp();
+        markDirty(WRITE_BEHIND_MS);
+        return true;
+    }
+
+    /**
+     * Stored networks are kept contiguous: the primary (index 0), then the fallbacks, newest first.
+     */
+    [[nodiscard]] uint8_t getKnownWiFiNetworkCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint8_t count = 0;
+        while (count < WIFI_MAX_KNOWN_NETWORKS && knownWiFiNetwork(count).encryptionType != WiFiEncryptionType::INVALID)
+            ++count;
+        return count;
+    }
+
+    [[nodiscard]] std::optional<WiFiConnectionDetails> getKnownWiFiNetwork(const uint8_t index) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (index >= WIFI_MAX_KNOWN_NETWORKS || knownWiFiNetwork(index).encryptionType == WiFiEncryptionType::INVALID)
+            return std::nullopt;
+        return knownWiFiNetwork(index);
+    }
+
+    [[nodiscard]] WiFiFastConnect getWiFiFastConnect() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return data.wifiFastConnect;
+    }
+
+    void setWiFiFastConnect(const WiFiFastConnect& fastConnect)
+    {
+        update(data.wifiFastConnect, fastConnect);
+    }
+
+    /**
+     * Address configuration for the network `ssid`: the static one if it was configured for that network,
+     * DHCP (disabled) for any other, so a different network never gets an address from another subnet.
+     */
+    [[nodiscard]] WiFiStaticIp getWiFiStaticIp(const char* ssid) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return std::strcmp(data.wifiStaticIpSsid, ssid) == 0 ? data.wifiStaticIp : WiFiStaticIp{};
+    }
+
+    /**
+     * Address configuration for the primary network.
+     */
+    [[nodiscard]] WiFiStaticIp getWiFiStaticIp() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return std::strcmp(data.wifiStaticIpSsid, data.wifi.ssid) == 0 ? data.wifiStaticIp : WiFiStaticIp{};
+    }
+
+    /**
+     * Sets the address configuration of the primary network; one network at a time has a static address.
+     * False when a static address is set without a stored network.
+     */
+    bool setWiFiStaticIp(const WiFiStaticIp& staticIp)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (data.wifi.encryptionType == WiFiEncryptionType::INVALID) return !staticIp.enabled;
+        if (!staticIp.enabled && std::strcmp(data.wifiStaticIpSsid, data.wifi.ssid) != 0)
+            return true; // the primary already uses DHCP; another network's static address stays
+        if (std::memcmp(&data.wifiStaticIp, &staticIp, sizeof(WiFiStaticIp)) == 0
+            && std::strcmp(data.wifiStaticIpSsid, data.wifi.ssid) == 0)
+            return true;
+        data.wifiStaticIp = staticIp;
+        std::memcpy(data.wifiStaticIpSsid, data.wifi.ssid, sizeof(data.wifiStaticIpSsid));
+        markDirty(WRITE_BEHIND_MS);
+        return true;
+    }
+
+    [[nodiscard]] PowerProfile getPowerProfile() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return data.powerProfile;
+    }
+
+    void setPowerProfile(const PowerProfile profile)
+    {
+        update(data.powerProfile, profile);
+    }
+
+    [[nodiscard]] HttpCredentials getHttpCredentials() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return data.http;
+    }
+
+    void setHttpCredentials(const HttpCredentials& credentials)
+    {
+        update(data.http, credentials);
+    }
+
+    [[nodiscard]] AlexaIntegrationSettings getAlexaSettings() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return data.alexa;
+    }
+
+    void setAlexaSettings(const AlexaIntegrationSettings& settings)
+    {
+        update(data.alexa, settings);
+    }
+
+    /**
+     * Copies the stored scenes into `out` (AlexaScene::MAX_SCENES entries) and returns how many there are.
+     */
+    uint8_t getAlexaScenes(AlexaScene* out) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::copy_n(data.scenes, data.sceneCount, out);
+        return data.sceneCount;
+    }
+
+    void setAlexaScenes(const AlexaScene* scenes, const uint8_t count)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const uint8_t sceneCount = std::min(count, AlexaScene::MAX_SCENES);
+        if (sceneCount == data.sceneCount
+            && std::memcmp(data.scenes, scenes, sceneCount * sizeof(AlexaScene)) == 0)
+            return;
+        std::copy_n(scenes, sceneCount, data.scenes);
+        std::fill(data.scenes + sceneCount, data.scenes + AlexaScene::MAX_SCENES, AlexaScene{});
+        data.sceneCount = sceneCount;
+        markDirty(WRITE_BEHIND_MS);
+    }
+
+    /**
+     * Writes pending changes now instead of waiting for the write-behind timer, and waits (bounded) until
+     * the writer task has committed them. Returns false on timeout or write failure.
+     */
+    bool flush()
+    {
+        enqueueSnapshot();
+        uint32_t target;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            target = live.generation; // also covers a snapshot the timer queued earlier
+        }
+        for (uint32_t waited = 0; writtenGeneration.load() < target; ++waited)
+        {
+            if (waited >= FLUSH_TIMEOUT_MS) return false;
+            vTaskDelay(pdMS_TO_TICKS(1));
+        }
+        return true;
+    }
+
+    /**
+     * Hands pending changes to the writer task right away, without waiting for the commit, and raises the
+     * writer above everything else on its core until it has written them. Safe to call from the main loop
+     * when every millisecond counts (supply collapsing).
+     */
+    void commitNow()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!dirty) return;
+        ++urgentCommits;
+        enqueueLocked();
+        if (!writer) return;
+        urgentPending = true;
+        vTaskPrioritySet(writer, URGENT_WRITER_PRIORITY);
+    }
+
+    /**
+     * Drops pending changes and invalidates the RTC mirror; used before a factory reset erases NVS, so neither
+     * the shutdown flush nor the next boot brings the old configuration back. Later changes stay in RAM only.
+     */
+    void discardPending()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        discarded = true;
+        RtcLightMirror::clear();
+        dirty = false;
+        commitTimer.stop();
+        if (snapshots) xQueueReset(snapshots);
+        writtenGeneration.store(live.generation);
+    }
+
+    void toJson(const JsonObject& to) const
+    {
+        to["size"] = BLOB_SIZE;
+        to["source"] = source;
+        to["loadUs"] = loadUs;
+        to["updates"] = updates;
+        to["commits"] = commits;
+        to["failedCommits"] = failedCommits;
+        to["urgentCommits"] = urgentCommits;
+        to["lastCommitUs"] = lastCommitUs;
+        to["lightWriteDelayMs"] = lightWriteDelayMs;
+        to["restoredFromRtc"] = restoredFromRtc;
+        // Extrapolated from the commits since boot; each commit rewrites the whole blob.
+        const uint64_t uptimeMs = std::max<uint64_t>(TimerService::nowMs(), 1);
+        to["writesPerDay"] = static_cast<uint32_t>(static_cast<uint64_t>(commits) * 86400000ULL / uptimeMs);
+    }
+
+private:
+    template <typename T>
+    void update(T& field, const T& value)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (std::memcmp(&field, &value, sizeof(T)) == 0) return;
+        std::memcpy(&field, &value, sizeof(T));
+        markDirty(WRITE_BEHIND_MS);
+    }
+
+    // Caller holds `mutex`.
+    [[nodiscard]] const WiFiConnectionDetails& knownWiFiNetwork(const uint8_t index) const
+    {
+        return index == 0 ? data.wifi : data.wifiFallbacks[index - 1];
+    }
+
+    // Caller holds `mutex`.
+    void clearStaticIp()
+    {
+        data.wifiStaticIp = {};
+        std::fill(std::begin(data.wifiStaticIpSsid), std::end(data.wifiStaticIpSsid), '\0');
+    }
+
+    // Caller holds `mutex`. Removes the fallback with this SSID, keeping the others in order.
+    bool removeFallback(const char* ssid)
+    {
+        auto* const end = std::end(data.wifiFallbacks);
+        auto* const found = std::find_if(std::begin(data.wifiFallbacks), end, [ssid](const auto& fallback)
+        {
+            return fallback.encryptionType != WiFiEncryptionType::INVALID && std::strcmp(fallback.ssid, ssid) == 0;
+        });
+        if (found == end) return false;
+        std::copy(found + 1, end, found);
+        *(end - 1) = {};
+        return true;
+    }
+
+    // Caller holds `mutex` (or runs before any other task can reach the store). The commit happens within
+    // `delayMs`; an earlier pending deadline is kept.
+    void markDirty(const uint32_t delayMs)
+    {
+        if (discarded) return;
+        ++updates;
+        ++live.generation;
+        dirty = true;
+        const uint64_t dueMs = TimerService::nowMs() + delayMs;
+        if (!commitTimer.isActive() || dueMs < commitDueMs)
+        {
+            commitDueMs = dueMs;
+            commitTimer.start(delayMs);
+        }
+    }
+
+    /**
+     * Hands the pending changes to the writer task. Only the snapshot copy happens here (under the lock),
+     * the flash write runs on the writer task.
+     */
+    void enqueueSnapshot()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!dirty) return;
+        enqueueLocked();
+    }
+
+    void enqueueLocked()
+    {
+        dirty = false;
+        commitTimer.stop();
+        if (snapshots)
+            xQueueOverwrite(snapshots, &live);
+        else if (!write(live)) // no writer task: before begin() or it failed to start
+            retryLater();
+    }
+
+    static void writerTask(void* param)
+    {
+        auto* store = static_cast<ConfigStore*>(param);
+        while (true) // NOLINT
+        {
+            if (xQueueReceive(store->snapshots, &store->incoming, portMAX_DELAY) != pdTRUE) continue;
+            store->urgentPending = false;
+            if (!store->write(store->incoming))
+            {
+                std::lock_guard<std::mutex> lock(store->mutex);
+                store->retryLater();
+            }
+            // Back to low priority, unless commitNow() queued another snapshot meanwhile.
+            vTaskPrioritySet(nullptr, WRITER_PRIORITY);
+            if (store->urgentPending)
+                vTaskPrioritySet(nullptr, URGENT_WRITER_PRIORITY);
+        }
+    }
+
+    // Caller holds `mutex`. The retry snapshots the data again, including anything changed meanwhile.
+    void retryLater()
+    {
+        dirty = true;
+        commitDueMs = TimerService::nowMs() + WRITE_BEHIND_MS;
+        commitTimer.start(WRITE_BEHIND_MS);
+    }
+
+    /**
+     * After a reset that kept RTC memory, the mirror may hold light changes the flash never saw.
+     */
+    void restoreRtcMirror()
+    {
+        LightState mirrored[Hardware::Pin::OUTPUTS.size()];
+        if (RtcLightMirror::read(mirrored) && std::memcmp(mirrored, data.lights, sizeof(data.lights)) != 0)
+        {
+            std::copy_n(mirrored, Hardware::Pin::OUTPUTS.size(), data.lights);
+            restoredFromRtc = true;
+            markDirty(WRITE_BEHIND_MS);
+            ESP_LOGI(LOG_TAG, "Light states restored from RTC memory (reset reason %d)",
+                     static_cast<int>(esp_reset_reason()));
+        }
+        RtcLightMirror::write(data.lights);
+    }
+
+    bool write(Snapshot& snapshot)
+    {
+        snapshot.header.magic = MAGIC;
+        snapshot.header.version = VERSION;
+        snapshot.header.size = sizeof(ConfigData);
+        snapshot.header.crc = crc32_le(0, reinterpret_cast<const uint8_t*>(&snapshot.data), sizeof(ConfigData));
+
+        const int64_t start = esp_timer_get_time();
+        Preferences prefs;
+        const bool written = prefs.begin(PREFERENCES_NAME, false)
+            && prefs.putBytes(BLOB_KEY, &snapshot.header, BLOB_SIZE) == BLOB_SIZE;
+        prefs.end();
+        lastCommitUs = static_cast<uint32_t>(esp_timer_get_time() - start);
+
+        if (!written)
+        {
+            ++failedCommits;
+            ESP_LOGE(LOG_TAG, "Failed to write the configuration blob, retrying later");
+            return false;
+        }
+        ++commits;
+        writtenGeneration.store(snapshot.generation);
+        ESP_LOGD(LOG_TAG, "Configuration committed in %u us", static_cast<unsigned>(lastCommitUs));
+        return true;
+    }
+
+    bool load()
+    {
+        Preferences prefs;
+        if (!prefs.begin(PREFERENCES_NAME, true)) return false;
+        const size_t length = prefs.getBytesLength(BLOB_KEY);
+        if (length < sizeof(ConfigHeader))
+        {
+            prefs.end();
+            return false;
+        }
+        // Sized by what is stored: a blob written by a newer firmware may be larger than ours.
+        const std::unique_ptr<uint8_t[]> buffer(new uint8_t[length]);
+        const bool read = prefs.getBytes(BLOB_KEY, buffer.get(), length) == length;
+        prefs.end();
+        if (!read) return false;
+
+        ConfigHeader header;
+        std::memcpy(&header, buffer.get(), sizeof(ConfigHeader));
+        const uint8_t* payload = buffer.get() + sizeof(ConfigHeader);
+        if (header.magic != MAGIC || header.size != length - sizeof(ConfigHeader)
+            || header.crc != crc32_le(0, payload, header.size))
+        {
+            ESP_LOGE(LOG_TAG, "Configuration blob is corrupt, ignoring it");
+            return false;
+        }
+
+        std::memcpy(&data, payload, std::min<size_t>(header.size, sizeof(ConfigData)));
+        // Before version 5 the static address applied to whichever network was primary; keep it for that one.
+        if (header.version < 5 && data.wifiStaticIp.enabled)
+            std::memcpy(data.wifiStaticIpSsid, data.wifi.ssid, sizeof(data.wifiStaticIpSsid));
+        sanitize();
+        source = "blob";
+        if (header.version < VERSION)
+        {
+            ESP_LOGI(LOG_TAG, "Upgrading configuration from version %u to %u", header.version, VERSION);
+            markDirty(WRITE_BEHIND_MS);
+        }
+        return true;
+    }
+
+    void sanitize()
+    {
+        data.deviceName[DEVICE_NAME_MAX_LENGTH] = '\0';
+        data.wifi.ssid[WIFI_MAX_SSID_LENGTH] = '\0';
+        for (auto& fallback : data.wifiFallbacks)
+            fallback.ssid[WIFI_MAX_SSID_LENGTH] = '\0';
+        if (data.wifiFastConnect.channel > 14)
+            data.wifiFastConnect = {};
+        data.wifiStaticIpSsid[WIFI_MAX_SSID_LENGTH] = '\0';
+        data.wifiStaticIp.enabled = data.wifiStaticIp.enabled && data.wifiStaticIp.ip != 0
+            && data.wifiStaticIpSsid[0] != '\0';
+        if (!PowerState::isValid(static_cast<uint8_t>(data.powerProfile)))
+            data.powerProfile = PowerProfile::BALANCED;
+        data.http.username[HttpCredentials::MAX_USERNAME_LENGTH] = '\0';
+        data.http.password[HttpCredentials::MAX_PASSWORD_LENGTH] = '\0';
+        if (data.alexa.integrationMode > AlexaIntegrationMode::MULTI_DEVICE)
+            data.alexa.integrationMode = AlexaIntegrationMode::OFF;
+        for (auto* name : {data.alexa.rDeviceName, data.alexa.gDeviceName, data.alexa.bDeviceName,
+                           data.alexa.wDeviceName})
+            name[AlexaIntegrationSettings::MAX_DEVICE_NAME_LENGTH - 1] = '\0';
+        data.sceneCount = std::min(data.sceneCount, AlexaScene::MAX_SCENES);
+        for (auto& scene : data.scenes)
+            scene.name[AlexaIntegrationSettings::MAX_DEVICE_NAME_LENGTH - 1] = '\0';
+    }
+
+    // Namespaces written by firmware before the unified blob, with their original key layout.
+    static constexpr auto LEGACY_LIGHT = "light";
+    static constexpr auto LEGACY_WIFI = "wifi-config";
+    static constexpr auto LEGACY_ALEXA = "alexa-config";
+    static constexpr auto LEGACY_HTTP = "http";
+
+    /**
+     * Fills `data` from the legacy namespaces; returns false when none of them exists (a fresh device).
+     */
+    bool migrateLegacy()
+    {
+        bool found = false;
+        Preferences prefs;
+
+        if (prefs.begin(LEGACY_LIGHT, true))
+        {
+            found = true;
+            for (size_t i = 0; i < Hardware::Pin::OUTPUTS.size(); ++i)
+            {
+                char onKey[5];
+                char valueKey[5];
+                snprintf(onKey, sizeof(onKey), "%02uo", static_cast<unsigned>(Hardware::Pin::OUTPUTS[i]));
+                snprintf(valueKey, sizeof(valueKey), "%02uv", static_cast<unsigned>(Hardware::Pin::OUTPUTS[i]));
+                data.lights[i].on = prefs.getBool(onKey, false);
+                data.lights[i].value = prefs.getUChar(valueKey, 0);
+            }
+            prefs.end();
+        }
+
+        if (prefs.begin(LEGACY_WIFI, true))
+        {
+            found = true;
+            if (prefs.isKey("deviceName"))
+                prefs.getString("deviceName", data.deviceName, DEVICE_NAME_TOTAL_LENGTH);
+            auto& wifi = data.wifi;
+            wifi.encryptionType = static_cast<WiFiEncryptionType>(prefs.getUChar(
+                "encryptionType", static_cast<uint8_t>(WiFiEncryptionType::INVALID)));
+            if (wifi.encryptionType != WiFiEncryptionType::INVALID)
+            {
+                prefs.getBytes("ssid", wifi.ssid, WIFI_MAX_SSID_LENGTH + 1);
+                if (wifi.encryptionType == WiFiEncryptionType::WPA2_ENTERPRISE
+                    || wifi.encryptionType == WiFiEncryptionType::WPA3_ENT_192)
+                {
+                    prefs.getBytes("identity", wifi.credentials.eap.identity, WIFI_MAX_EAP_IDENTITY + 1);
+                    prefs.getBytes("username", wifi.credentials.eap.username, WIFI_MAX_EAP_USERNAME + 1);
+                    prefs.getBytes("eapPassword", wifi.credentials.eap.password, WIFI_MAX_EAP_PASSWORD + 1);
+                    wifi.credentials.eap.phase2Type = static_cast<WiFiPhaseTwoType>(prefs.getUChar(
+                        "phase2Type", static_cast<uint8_t>(WiFiPhaseTwoType::ESP_EAP_TTLS_PHASE2_EAP)));
+                }
+                else
+                {
+                    prefs.getBytes("password", wifi.credentials.simple.password, WIFI_MAX_PASSWORD_LENGTH + 1);
+                }
+            }
+            prefs.end();
+        }
+
+        if (prefs.begin(LEGACY_ALEXA, true))
+        {
+            found = true;
+            auto& alexa = data.alexa;
+            alexa.integrationMode = static_cast<AlexaIntegrationMode>(
+                prefs.getUChar("mode", static_cast<uint8_t>(AlexaIntegrationMode::OFF)));
+            prefs.getString("r", alexa.rDeviceName, AlexaIntegrationSettings::MAX_DEVICE_NAME_LENGTH);
+            prefs.getString("g", alexa.gDeviceName, AlexaIntegrationSettings::MAX_DEVICE_NAME_LENGTH);
+            prefs.getString("b", alexa.bDeviceName, AlexaIntegrationSettings::MAX_DEVICE_NAME_LENGTH);
+            prefs.getString("w", alexa.wDeviceName, AlexaIntegrationSettings::MAX_DEVICE_NAME_LENGTH);
+            if (const size_t length = prefs.getBytesLength("scenes");
+                length % sizeof(AlexaScene) == 0 && length <= sizeof(data.scenes))
+            {
+                prefs.getBytes("scenes", data.scenes, length);
+                data.sceneCount = length / sizeof(AlexaScene);
+            }
+            prefs.end();
+        }
+
+        if (prefs.begin(LEGACY_HTTP, true))
+        {
+            found = true;
+            prefs.getString("u", data.http.username, sizeof(data.http.username));
+            prefs.getString("p", data.http.password, sizeof(data.http.password));
+            if (data.http.username[0] == '\0')
+                std::strncpy(data.http.username, "admin", HttpCredentials::MAX_USERNAME_LENGTH);
+            prefs.end();
+        }
+        else
+        {
+            data.http = HttpCredentials::createDefault();
+        }
+        return found;
+    }
+
+    /**
+     * Erases the legacy namespaces once their content is safely in the blob, freeing their NVS entries.
+     */
+    static void clearLegacy()
+    {
+        for (const auto* name : {LEGACY_LIGHT, LEGACY_WIFI, LEGACY_ALEXA, LEGACY_HTTP})
+        {
+            Preferences prefs;
+            if (!prefs.begin(name, true)) continue;
+            prefs.end();
+            prefs.begin(name, false);
+            prefs.clear();
+            prefs.end();
+        }
+    }
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <variant>
+
+#include "alexa_integration.hh"
+#include "command_queue.hh"
+#include "power_model.hh"
+#include "webserver_handler.hh"
+#include "wifi_manager.hh"
+
+/**
+ * Configuration changes requested from network tasks; rare but large, hence a separate, shorter queue.
+ */
+namespace ControlCommands
+{
+    struct ConnectWiFi
+    {
+        WiFiConnectionDetails details;
+    };
+
+    struct TriggerWiFiScan
+    {
+    };
+
+    struct SetDeviceName
+    {
+        char name[DEVICE_NAME_TOTAL_LENGTH];
+    };
+
+    struct SetHttpCredentials
+    {
+        HttpCredentials credentials;
+    };
+
+    struct ApplyAlexaSettings
+    {
+        AlexaIntegrationSettings settings;
+    };
+
+    struct SetPowerProfile
+    {
+        PowerProfile profile;
+    };
+
+    struct SetStaticIp
+    {
+        WiFiStaticIp staticIp;
+    };
+
+    struct ForgetWiFiNetwork
+    {
+        char ssid[WIFI_MAX_SSID_LENGTH + 1];
+    };
+}
+
+using ControlCommand = std::variant<
+    ControlCommands::TriggerWiFiScan,
+    ControlCommands::ConnectWiFi,
+    ControlCommands::SetDeviceName,
+    ControlCommands::SetHttpCredentials,
+    ControlCommands::ApplyAlexaSettings,
+    ControlCommands::SetPowerProfile,
+    ControlCommands::SetStaticIp,
+    ControlCommands::ForgetWiFiNetwork>;
+
+using ControlCommandQueue = CommandQueue<ControlCommand, 4>;
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <ArduinoJson.h>
+#include <freertos/FreeRTOS.h> // NOLINT
+#include <freertos/task.h>
+
+#include "timer_service.hh"
+
+/**
+ * Samples the run time of each core's idle task once per second and reports it as idle percentage.
+ * Requires FreeRTOS run-time stats (enabled in the Arduino core); without them nothing is reported.
+ */
+class CpuLoad
+{
+    static constexpr uint32_t SAMPLE_INTERVAL_MS = 1000;
+    static constexpr uint8_t MAX_TASKS = 24;
+
+    std::array<uint32_t, portNUM_PROCESSORS> lastIdle = {};
+    uint32_t lastTotal = 0;
+    std::array<uint8_t, portNUM_PROCESSORS> idlePercent = {};
+    bool valid = false;
+
+#if configGENERATE_RUN_TIME_STATS == 1 && configUSE_TRACE_FACILITY == 1
+    std::array<TaskStatus_t, MAX_TASKS> tasks = {};
+#endif
+
+    Timer sampleTimer{[this] { sample(); }};
+
+public:
+    void begin()
+    {
+        sample();
+        sampleTimer.start(SAMPLE_INTERVAL_MS, SAMPLE_INTERVAL_MS);
+    }
+
+    void toJson(const JsonObject& to) const
+    {
+        if (!valid) return;
+        const auto idle = to["idle"].to<JsonArray>();
+        for (const auto percent : idlePercent)
+            idle.add(percent);
+    }
+
+private:
+    void sample()
+    {
+#if configGENERATE_RUN_TIME_STATS == 1 && configUSE_TRACE_FACILITY == 1
+        uint32_t total = 0;
+        const auto count = uxTaskGetSystemState(tasks.data(), tasks.size(), &total);
+        if (count == 0) return; // more tasks than MAX_TASKS
+
+        std::array<uint32_t, portNUM_PROCESSORS> idle = {};
+        for (UBaseType_t i = 0; i < count; ++i)
+        {
+            for (BaseType_t core = 0; core < portNUM_PROCESSORS; ++core)
+            {
+                if (tasks[i].xHandle == xTaskGetIdleTaskHandleForCPU(core))
+                    idle[core] = tasks[i].ulRunTimeCounter;
+            }
+        }
+
+        // The counters wrap; unsigned deltas stay correct as long as samples are less than a wrap apart.
+        if (const uint32_t elapsed = total - lastTotal; lastTotal != 0 && elapsed > 0)
+        {
+            for (uint8_t core = 0; core < portNUM_PROCESSORS; ++core)
+            {
+                const uint64_t idleDelta = idle[core] - lastIdle[core];
+                idlePercent[core] = static_cast<uint8_t>(std::min<uint64_t>(idleDelta * 100 / elapsed, 100));
+            }
+            valid = true;
+        }
+        lastIdle = idle;
+        lastTotal = total;
+#endif
+    }
+};
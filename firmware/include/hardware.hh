@@ -85,4 +85,13 @@ namespace Hardware
             default: return std::nullopt;
         }
     }
+
+    inline std::optional<uint8_t> getOutputIndex(const uint8_t pin)
+    {
+        for (uint8_t i = 0; i < Pin::OUTPUTS.size(); ++i)
+        {
+            if (Pin::OUTPUTS[i] == pin) return i;
+        }
+        return std::nullopt;
+    }
 }
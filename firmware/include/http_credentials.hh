@@ -0,0 +1,36 @@
+#pragma once
+
+#include <Arduino.h>
+
+struct HttpCredentials
+{
+    static constexpr auto MAX_USERNAME_LENGTH = 32;
+    static constexpr auto MAX_PASSWORD_LENGTH = 32;
+
+    char username[MAX_USERNAME_LENGTH + 1] = {};
+    char password[MAX_PASSWORD_LENGTH + 1] = {};
+
+    /**
+     * Factory default: user "admin" with a random password, shared with the app over BLE.
+     */
+    [[nodiscard]] static HttpCredentials createDefault()
+    {
+        HttpCredentials credentials;
+        strncpy(credentials.username, "admin", MAX_USERNAME_LENGTH);
+        strncpy(credentials.password, generateRandomPassword().c_str(), MAX_PASSWORD_LENGTH);
+        return credentials;
+    }
+
+private:
+    [[nodiscard]] static String generateRandomPassword()
+    {
+        const auto v1 = random(100000, 999999);
+        const auto v2 = random(100000, 999999);
+        String password = String(v1) + "A-b" + String(v2);
+        if (password.length() > MAX_PASSWORD_LENGTH)
+        {
+            password = password.substring(0, MAX_PASSWORD_LENGTH);
+        }
+        return password;
+    }
+};
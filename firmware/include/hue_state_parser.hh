@@ -0,0 +1,321 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Fields of a Hue `PUT /api/<user>/lights/<id>/state` body, or a `POST /api` pairing request.
+ * Only the fields listed in `fields` were present in the body.
+ */
+struct HueStateCommand
+{
+    enum Field : uint16_t
+    {
+        ON = 1 << 0,
+        BRI = 1 << 1,
+        HUE = 1 << 2,
+        SAT = 1 << 3,
+        CT = 1 << 4,
+        XY = 1 << 5,
+        TRANSITION_TIME = 1 << 6,
+        DEVICE_TYPE = 1 << 7
+    };
+
+    uint16_t fields = 0;
+    bool on = false;
+    uint8_t bri = 0;
+    uint16_t hue = 0;
+    uint8_t sat = 0;
+    uint16_t ct = 0;
+    float x = 0;
+    float y = 0;
+    uint16_t transitionTime = 0; // multiples of 100 ms
+
+    [[nodiscard]] bool has(const Field field) const
+    {
+        return (fields & field) != 0;
+    }
+};
+
+/**
+ * Single-pass, allocation-free parser for the flat JSON objects sent by Alexa to the Hue API.
+ * It works on a bounded buffer (no terminator required), skips unknown keys of any type and
+ * rejects anything that is not a well-formed object, so keys appearing inside values are never
+ * mistaken for fields.
+ */
+class HueStateParser
+{
+    static constexpr size_t MAX_KEY_LENGTH = 16;
+    static constexpr uint8_t MAX_DEPTH = 8;
+
+    const char* cursor;
+    const char* end;
+
+public:
+    static bool parse(const char* body, const size_t length, HueStateCommand& command)
+    {
+        HueStateParser parser(body, length);
+        command = {};
+        return parser.parseObject(command);
+    }
+
+private:
+    HueStateParser(const char* body, const size_t length) : cursor(body), end(body + length)
+    {
+    }
+
+    bool parseObject(HueStateCommand& command)
+    {
+        skipWhitespace();
+        if (!consume('{')) return false;
+        skipWhitespace();
+        if (consume('}')) return atEnd();
+
+        while (true)
+        {
+            char key[MAX_KEY_LENGTH + 1];
+            skipWhitespace();
+            if (!parseKey(key)) return false;
+            skipWhitespace();
+            if (!consume(':')) return false;
+            skipWhitespace();
+            if (!parseField(key, command)) return false;
+            skipWhitespace();
+            if (consume(',')) continue;
+            if (consume('}')) return atEnd();
+            return false;
+        }
+    }
+
+    bool parseField(const char* key, HueStateCommand& command)
+    {
+        if (strcmp(key, "on") == 0)
+            return parseBool(command.on) && set(command, HueStateCommand::ON);
+        if (strcmp(key, "bri") == 0)
+            return parseInteger(command.bri, 0, 254) && set(command, HueStateCommand::BRI);
+        if (strcmp(key, "hue") == 0)
+            return parseInteger(command.hue, 0, 65535) && set(command, HueStateCommand::HUE);
+        if (strcmp(key, "sat") == 0)
+            return parseInteger(command.sat, 0, 254) && set(command, HueStateCommand::SAT);
+        if (strcmp(key, "ct") == 0)
+            return parseInteger(command.ct, 153, 500) && set(command, HueStateCommand::CT);
+        if (strcmp(key, "transitiontime") == 0)
+            return parseInteger(command.transitionTime, 0, 65535) && set(command, HueStateCommand::TRANSITION_TIME);
+        if (strcmp(key, "xy") == 0)
+            return parseXY(command.x, command.y) && set(command, HueStateCommand::XY);
+        if (strcmp(key, "devicetype") == 0)
+            return skipString() && set(command, HueStateCommand::DEVICE_TYPE);
+        return skipValue(0);
+    }
+
+    static bool set(HueStateCommand& command, const HueStateCommand::Field field)
+    {
+        command.fields |= field;
+        return true;
+    }
+
+    bool parseKey(char* key)
+    {
+        if (!consume('"')) return false;
+        size_t length = 0;
+        bool truncated = false;
+        while (cursor < end && *cursor != '"')
+        {
+            if (*cursor == '\\')
+            {
+                // Escaped keys never name a field we care about; keep scanning to stay in sync.
+                if (++cursor >= end) return false;
+                truncated = true;
+            }
+            if (length < MAX_KEY_LENGTH)
+                key[length++] = *cursor;
+            else
+                truncated = true;
+            ++cursor;
+        }
+        if (!consume('"')) return false;
+        key[truncated ? 0 : length] = '\0';
+        return true;
+    }
+
+    bool parseBool(bool& value)
+    {
+        if (consumeLiteral("true"))
+        {
+            value = true;
+            return true;
+        }
+        if (consumeLiteral("false"))
+        {
+            value = false;
+            return true;
+        }
+        return false;
+    }
+
+    template <typename T>
+    bool parseInteger(T& value, const long min, const long max)
+    {
+        float number;
+        if (!parseNumber(number)) return false;
+        // Clamp before converting: a float beyond the range of long (1e30) has no defined conversion.
+        if (number <= static_cast<float>(min))
+            value = static_cast<T>(min);
+        else if (number >= static_cast<float>(max))
+            value = static_cast<T>(max);
+        else
+            value = static_cast<T>(static_cast<long>(number < 0 ? number - 0.5f : number + 0.5f));
+        return true;
+    }
+
+    bool parseXY(float& x, float& y)
+    {
+        if (!consume('[')) return false;
+        skipWhitespace();
+        if (!parseNumber(x)) return false;
+        skipWhitespace();
+        if (!consume(',')) return false;
+        skipWhitespace();
+        if (!parseNumber(y)) return false;
+        skipWhitespace();
+        if (!consume(']')) return false;
+        return x >= 0.0f && x <= 1.0f && y > 0.0f && y <= 1.0f;
+    }
+
+    /**
+     * JSON number grammar, accumulated without strtod so the buffer needs no terminator.
+     */
+    bool parseNumber(float& value)
+    {
+        bool negative = consume('-');
+        if (cursor >= end || !isDigit(*cursor)) return false;
+
+        double result = 0;
+        if (*cursor == '0')
+            ++cursor;
+        else
+            while (cursor < end && isDigit(*cursor))
+                result = result * 10 + (*cursor++ - '0');
+
+        if (consume('.'))
+        {
+            if (cursor >= end || !isDigit(*cursor)) return false;
+            double scale = 0.1;
+            while (cursor < end && isDigit(*cursor))
+            {
+                result += (*cursor++ - '0') * scale;
+                scale /= 10;
+            }
+        }
+
+        if (cursor < end && (*cursor == 'e' || *cursor == 'E'))
+        {
+            ++cursor;
+            const bool negativeExponent = consume('-');
+            if (!negativeExponent) consume('+');
+            if (cursor >= end || !isDigit(*cursor)) return false;
+            int exponent = 0;
+            while (cursor < end && isDigit(*cursor))
+            {
+                if (exponent < 100) exponent = exponent * 10 + (*cursor - '0');
+                ++cursor;
+            }
+            for (int i = 0; i < exponent; ++i)
+                result = negativeExponent ? result / 10 : result * 10;
+        }
+
+        if (result > 3.0e38) result = 3.0e38;
+        value = static_cast<float>(negative ? -result : result);
+        return true;
+    }
+
+    bool skipString()
+    {
+        if (!consume('"')) return false;
+        while (cursor < end && *cursor != '"')
+        {
+            if (*cursor == '\\' && ++cursor >= end) return false;
+            ++cursor;
+        }
+        return consume('"');
+    }
+
+    bool skipValue(const uint8_t depth)
+    {
+        if (depth > MAX_DEPTH || cursor >= end) return false;
+        float ignored;
+        switch (*cursor)
+        {
+        case '"':
+            return skipString();
+        case '{':
+        case '[':
+            {
+                const char close = *cursor == '{' ? '}' : ']';
+                ++cursor;
+                skipWhitespace();
+                if (consume(close)) return true;
+                while (true)
+                {
+                    skipWhitespace();
+                    if (close == '}')
+                    {
+                        if (!skipString()) return false;
+                        skipWhitespace();
+                        if (!consume(':')) return false;
+                        skipWhitespace();
+                    }
+                    if (!skipValue(depth + 1)) return false;
+                    skipWhitespace();
+                    if (consume(',')) continue;
+                    return consume(close);
+                }
+            }
+        case 't':
+            return consumeLiteral("true");
+        case 'f':
+            return consumeLiteral("false");
+        case 'n':
+            return consumeLiteral("null");
+        default:
+            return parseNumber(ignored);
+        }
+    }
+
+    bool consumeLiteral(const char* literal)
+    {
+        const size_t length = strlen(literal);
+        if (static_cast<size_t>(end - cursor) < length || strncmp(cursor, literal, length) != 0)
+            return false;
+        cursor += length;
+        return true;
+    }
+
+    bool consume(const char c)
+    {
+        if (cursor < end && *cursor == c)
+        {
+            ++cursor;
+            return true;
+        }
+        return false;
+    }
+
+    void skipWhitespace()
+    {
+        while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r'))
+            ++cursor;
+    }
+
+    bool atEnd()
+    {
+        skipWhitespace();
+        return cursor == end || *cursor == '\0';
+    }
+
+    static bool isDigit(const char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+};
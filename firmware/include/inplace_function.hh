@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template <typename Signature, size_t Capacity = 32>
+class InplaceFunction;
+
+/**
+ * Move-only replacement for std::function that stores the callable inside the object instead of on
+ * the heap. Callables larger than `Capacity` are rejected at compile time, so capture pointers or
+ * references rather than whole objects.
+ */
+template <typename R, typename... Args, size_t Capacity>
+class InplaceFunction<R(Args...), Capacity>
+{
+    struct Operations
+    {
+        R (*invoke)(void* storage, Args&&... args);
+        void (*move)(void* to, void* from);
+        void (*destroy)(void* storage);
+    };
+
+    template <typename F>
+    static constexpr Operations operationsFor = {
+        [](void* storage, Args&&... args) -> R
+        {
+            return (*static_cast<F*>(storage))(std::forward<Args>(args)...);
+        },
+        [](void* to, void* from)
+        {
+            new(to) F(std::move(*static_cast<F*>(from)));
+            static_cast<F*>(from)->~F();
+        },
+        [](void* storage)
+        {
+            static_cast<F*>(storage)->~F();
+        }
+    };
+
+    alignas(std::max_align_t) unsigned char storage[Capacity];
+    const Operations* operations = nullptr;
+
+public:
+    InplaceFunction() = default;
+
+    InplaceFunction(std::nullptr_t) // NOLINT(google-explicit-constructor)
+    {
+    }
+
+    template <typename F, typename Callable = std::decay_t<F>,
+              typename = std::enable_if_t<!std::is_same_v<Callable, InplaceFunction>
+                  && std::is_invocable_r_v<R, Callable&, Args...>>>
+    InplaceFunction(F&& callable) // NOLINT(google-explicit-constructor)
+    {
+        static_assert(sizeof(Callable) <= Capacity, "Callable does not fit in InplaceFunction, raise Capacity");
+        static_assert(alignof(Callable) <= alignof(std::max_align_t), "Callable is over-aligned");
+        static_assert(std::is_nothrow_move_constructible_v<Callable>, "Callable must be nothrow movable");
+        new(storage) Callable(std::forward<F>(callable));
+        operations = &operationsFor<Callable>;
+    }
+
+    InplaceFunction(InplaceFunction&& other) noexcept
+    {
+        moveFrom(other);
+    }
+
+    InplaceFunction& operator=(InplaceFunction&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    InplaceFunction& operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    InplaceFunction(const InplaceFunction&) = delete;
+    InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+    ~InplaceFunction()
+    {
+        reset();
+    }
+
+    explicit operator bool() const
+    {
+        return operations != nullptr;
+    }
+
+    R operator()(Args... args)
+    {
+        return operations->invoke(storage, std::forward<Args>(args)...);
+    }
+
+    void reset()
+    {
+        if (operations)
+        {
+            operations->destroy(storage);
+            operations = nullptr;
+        }
+    }
+
+private:
+    void moveFrom(InplaceFunction& other)
+    {
+        if (other.operations)
+        {
+            other.operations->move(storage, other.storage);
+            operations = other.operations;
+            other.operations = nullptr;
+        }
+    }
+};
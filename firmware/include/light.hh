@@ -1,91 +1,102 @@
 #pragma once
 
 #include <Arduino.h>
-#include <Preferences.h>
 #include <cmath>
 
+#include "config_store.hh"
 #include "hardware.hh"
-
-#pragma pack(push, 1)
-struct LightState
-{
-    bool on = false;
-    uint8_t value = 0;
-
-    bool operator ==(const LightState& other) const
-    {
-        return (on == other.on && value == other.value);
-    }
-
-    bool operator !=(const LightState& other) const
-    {
-        return !(*this == other);
-    }
-
-    void toJson(const JsonObject& to) const
-    {
-        to["on"] = on;
-        to["value"] = value;
-    }
-};
-#pragma pack(pop)
+#include "light_state.hh"
+#include "rtc_light_mirror.hh"
+#include "timer_service.hh"
 
 class Light
 {
 public:
     static constexpr uint8_t ON_VALUE = 255;
     static constexpr uint8_t OFF_VALUE = 0;
-    static constexpr auto PREFERENCES_NAME = "light";
 
-    void setup()
+    /**
+     * Configures the PWM channel. After a warm reset a persistent light takes its state from the RTC mirror
+     * right away and returns true; otherwise it starts off until restore().
+     */
+    bool setup()
     {
-        prefs.begin(PREFERENCES_NAME, false);
         if (const auto& channel = Hardware::getPwmChannel(pin))
         {
             pinMode(pin, OUTPUT);
             ledcSetup(channel.value(), PWM_FREQUENCY, PWM_RESOLUTION);
             ledcAttachPin(pin, channel.value());
-            restore();
+            if (configIndex && RtcLightMirror::isValid())
+            {
+                state = RtcLightMirror::get(configIndex.value());
+                lastStoredState = state;
+                warmRestored = true;
+            }
+            update();
         }
         else
         {
             ESP_LOGE("Light", "Invalid pin %d for PWM channel", static_cast<int>(pin));
         }
+        return warmRestored;
     }
 
-    void handle(const unsigned long now)
+    /**
+     * Applies the persisted state unless setup() already restored it from RTC memory. Needs the config store
+     * to be loaded.
+     */
+    void restore()
     {
-        if (state != lastPersistedState && now - lastPersistTime >= PERSIST_DEBOUNCE_MS)
-        {
-            prefs.putBool(onKey, state.on);
-            prefs.putUChar(valueKey, state.value);
-            lastPersistedState = state;
-            lastPersistTime = now;
-        }
+        if (!configIndex || warmRestored) return;
+        state = ConfigStore::get().getLight(configIndex.value());
+        lastStoredState = state;
+        update();
     }
 
 private:
     static constexpr uint32_t PWM_FREQUENCY = 25000;
     static constexpr uint8_t PWM_RESOLUTION = 8;
-    static constexpr unsigned long PERSIST_DEBOUNCE_MS = 500;
+    static constexpr uint32_t TRANSITION_STEP_MS = 10;
 
     bool invert;
+    std::optional<uint8_t> configIndex; // slot in ConfigData::lights, nullopt when not persistent
     gpio_num_t pin;
     LightState state;
 
-    char onKey[5] = "";
-    char valueKey[5] = "";
-
     std::optional<uint8_t> lastWrittenValue = std::nullopt;
+    uint8_t currentDuty = OFF_VALUE;
+
+    uint8_t transitionFrom = OFF_VALUE;
+    uint64_t transitionStart = 0;
+    uint32_t transitionDuration = 0;
+    Timer transitionTimer{[this] { update(); }};
 
-    Preferences prefs;
-    LightState lastPersistedState;
-    unsigned long lastPersistTime = 0;
+    LightState lastStoredState;
+    bool warmRestored = false;
 
     void update()
     {
         const auto& channel = Hardware::getPwmChannel(pin);
-        const auto duty = state.on ? state.value : OFF_VALUE;
+        uint8_t duty = state.on ? state.value : OFF_VALUE;
+
+        if (transitionDuration > 0)
+        {
+            if (const auto elapsed = TimerService::nowMs() - transitionStart; elapsed < transitionDuration)
+                duty = static_cast<uint8_t>(transitionFrom + (static_cast<int32_t>(duty) - transitionFrom)
+                    * static_cast<int32_t>(elapsed) / static_cast<int32_t>(transitionDuration));
+            else
+                transitionDuration = 0;
+        }
+        if (transitionDuration == 0 && transitionTimer.isActive())
+            transitionTimer.stop();
+        currentDuty = duty;
+
+        // Only updates the RAM copy; the store coalesces changes into one flash write.
+        if (configIndex && state != lastStoredState)
+        {
+            ConfigStore::get().setLight(configIndex.value(), state);
+            lastStoredState = state;
+        }
 
         if (uint8_t outputValue = invert ? ON_VALUE - duty : duty;
             !lastWrittenValue || outputValue != lastWrittenValue)
@@ -95,13 +106,6 @@ private:
         }
     }
 
-    void restore()
-    {
-        state.on = prefs.getBool(onKey, false);
-        state.value = prefs.getUChar(valueKey, OFF_VALUE);
-        update();
-    }
-
     static uint8_t perceptualBrightnessStep(const uint8_t currentValue, const bool increase)
     {
         constexpr float gamma = 2.2f;
@@ -112,20 +116,17 @@ private:
     }
 
 public:
-    explicit Light(const gpio_num_t pin, const bool invert = false) :
-        invert(invert), pin(pin)
-    {
-        snprintf(onKey, sizeof(onKey), "%02uo", static_cast<unsigned>(pin));
-        snprintf(valueKey, sizeof(valueKey), "%02uv", static_cast<unsigned>(pin));
-    }
-
-    ~Light()
+    /**
+     * Non-persistent lights (status indicators) always start off and never write to flash.
+     */
+    explicit Light(const gpio_num_t pin, const bool invert = false, const bool persistent = true) :
+        invert(invert), configIndex(persistent ? Hardware::getOutputIndex(pin) : std::nullopt), pin(pin)
     {
-        prefs.end();
     }
 
     void toggle()
     {
+        transitionDuration = 0;
         state.on = !state.on;
         if (state.on && state.value == OFF_VALUE)
         {
@@ -134,8 +135,17 @@ public:
         update();
     }
 
-    void setValue(const uint8_t value)
+    /**
+     * Sets the brightness; with a transition the output fades linearly from its current duty,
+     * stepped by a timer every TRANSITION_STEP_MS.
+     */
+    void setValue(const uint8_t value, const uint32_t transitionMs = 0)
     {
+        transitionFrom = currentDuty;
+        transitionStart = TimerService::nowMs();
+        transitionDuration = transitionMs;
+        if (transitionMs > 0)
+            transitionTimer.start(TRANSITION_STEP_MS, TRANSITION_STEP_MS);
         state.value = value;
         if (value > OFF_VALUE && !state.on)
             state.on = true;
@@ -146,6 +156,7 @@ public:
 
     void setState(const bool stateFlag)
     {
+        transitionDuration = 0;
         state.on = stateFlag;
         if (stateFlag && state.value == OFF_VALUE)
         {
@@ -156,6 +167,7 @@ public:
 
     void increaseBrightness()
     {
+        transitionDuration = 0;
         state.value = perceptualBrightnessStep(state.value, true);
         state.on = true;
         update();
@@ -163,6 +175,7 @@ public:
 
     void decreaseBrightness()
     {
+        transitionDuration = 0;
         state.value = perceptualBrightnessStep(state.value, false);
         if (state.value == OFF_VALUE)
             state.on = false;
@@ -176,6 +189,7 @@ public:
 
     void setState(const LightState& state)
     {
+        transitionDuration = 0;
         this->state = state;
         update();
     }
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <ArduinoJson.h>
+
+#pragma pack(push, 1)
+struct LightState
+{
+    bool on = false;
+    uint8_t value = 0;
+
+    bool operator ==(const LightState& other) const
+    {
+        return (on == other.on && value == other.value);
+    }
+
+    bool operator !=(const LightState& other) const
+    {
+        return !(*this == other);
+    }
+
+    void toJson(const JsonObject& to) const
+    {
+        to["on"] = on;
+        to["value"] = value;
+    }
+};
+#pragma pack(pop)
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ArduinoJson.h>
+#include <esp_attr.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h> // NOLINT
+#include <freertos/task.h>
+
+#include "cpu_load.hh"
+#include "inplace_function.hh"
+#include "timer_service.hh"
+
+/**
+ * How long each loop iteration keeps the task busy (event handlers plus due timers). Anything blocking the loop,
+ * such as a flash write, lands in the upper buckets.
+ */
+struct LoopRunHistogram
+{
+    static constexpr std::array<uint32_t, 6> BOUNDS_US = {100, 500, 1000, 5000, 10000, 50000};
+
+    std::array<uint32_t, BOUNDS_US.size() + 1> counts = {}; // last bucket: above the largest bound
+    uint32_t maxUs = 0;
+
+    void record(const uint32_t us)
+    {
+        size_t bucket = 0;
+        while (bucket < BOUNDS_US.size() && us > BOUNDS_US[bucket]) ++bucket;
+        ++counts[bucket];
+        if (us > maxUs) maxUs = us;
+    }
+
+    void toJson(const JsonObject& to) const
+    {
+        const auto bounds = to["boundsUs"].to<JsonArray>();
+        for (const auto bound : BOUNDS_US)
+            bounds.add(bound);
+        const auto buckets = to["counts"].to<JsonArray>();
+        for (const auto count : counts)
+            buckets.add(count);
+        to["maxUs"] = maxUs;
+    }
+};
+
+struct MainLoopStats
+{
+    uint32_t wakeups;
+    uint32_t events;
+    uint32_t lastEventLatencyUs;
+    uint32_t maxEventLatencyUs;
+    LoopRunHistogram runTime;
+};
+
+/**
+ * Event-driven body of the Arduino loop task. The task sleeps on its notification value until the next timer
+ * is due or another task / an ISR posts an event bit, so it no longer spins a core at 100%.
+ */
+class MainLoop
+{
+public:
+    using Handler = InplaceFunction<void(), 16>;
+
+    enum Event : uint32_t
+    {
+        TIMERS = 1 << 0, // a timer was armed from another task
+        PIN_CHANGE = 1 << 1, // GPIO edge
+        COMMANDS = 1 << 2, // a command was posted to a CommandQueue
+    };
+
+private:
+    static constexpr auto LOG_TAG = "MainLoop";
+    static constexpr uint8_t MAX_HANDLERS = 4;
+
+    struct Subscription
+    {
+        uint32_t events = 0;
+        Handler handler;
+    };
+
+    // Static so the ISR path does not go through the function-local singleton guard.
+    static inline TaskHandle_t task = nullptr;
+    // Low 32 bits of the time the oldest pending event was posted, 0 while nothing is pending.
+    static inline std::atomic<uint32_t> pendingSinceUs{0};
+
+    std::array<Subscription, MAX_HANDLERS> subscriptions = {};
+    MainLoopStats stats = {};
+    CpuLoad cpuLoad;
+
+    MainLoop() = default;
+
+public:
+    static MainLoop& get()
+    {
+        static MainLoop instance;
+        return instance;
+    }
+
+    /**
+     * Must be called from the loop task (setup()) before any event is posted.
+     */
+    void begin()
+    {
+        task = xTaskGetCurrentTaskHandle();
+        TimerService::get().setWakeHook([]
+        {
+            // Arming from the loop task itself needs no wakeup, the next wait picks up the new deadline.
+            if (xTaskGetCurrentTaskHandle() != task) post(TIMERS);
+        });
+        cpuLoad.begin();
+    }
+
+    void subscribe(const uint32_t events, Handler handler)
+    {
+        for (auto& subscription : subscriptions)
+        {
+            if (subscription.events != 0) continue;
+            subscription.events = events;
+            subscription.handler = std::move(handler);
+            return;
+        }
+        ESP_LOGE(LOG_TAG, "No free handler slot");
+    }
+
+    static void post(const uint32_t events)
+    {
+        if (!task) return;
+        markPending();
+        xTaskNotify(task, events, eSetBits);
+    }
+
+    static void IRAM_ATTR postFromIsr(const uint32_t events)
+    {
+        if (!task) return;
+        markPending();
+        BaseType_t higherPriorityTaskWoken = pdFALSE;
+        xTaskNotifyFromISR(task, events, eSetBits, &higherPriorityTaskWoken);
+        if (higherPriorityTaskWoken) portYIELD_FROM_ISR();
+    }
+
+    /**
+     * One iteration: sleep until a deadline or event, dispatch posted events, then fire due timers.
+     */
+    void run()
+    {
+        auto& timers = TimerService::get();
+        uint32_t events = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &events, timers.ticksUntilNextDeadline());
+        const int64_t wokeUs = esp_timer_get_time();
+        ++stats.wakeups;
+
+        if (const uint32_t since = pendingSinceUs.exchange(0))
+        {
+            const uint32_t latency = static_cast<uint32_t>(esp_timer_get_time()) - since;
+            ++stats.events;
+            stats.lastEventLatencyUs = latency;
+            if (latency > stats.maxEventLatencyUs) stats.maxEventLatencyUs = latency;
+        }
+
+        for (auto& subscription : subscriptions)
+        {
+            if (subscription.events & events)
+                subscription.handler();
+        }
+        timers.advance();
+        stats.runTime.record(static_cast<uint32_t>(esp_timer_get_time() - wokeUs));
+    }
+
+    [[nodiscard]] MainLoopStats getStats() const
+    {
+        return stats;
+    }
+
+    void toJson(const JsonObject& to) const
+    {
+        to["wakeups"] = stats.wakeups;
+        to["events"] = stats.events;
+        to["lastEventLatencyUs"] = stats.lastEventLatencyUs;
+        to["maxEventLatencyUs"] = stats.maxEventLatencyUs;
+        stats.runTime.toJson(to["runTime"].to<JsonObject>());
+        cpuLoad.toJson(to);
+    }
+
+private:
+    static void IRAM_ATTR markPending()
+    {
+        const uint32_t now = static_cast<uint32_t>(esp_timer_get_time()) | 1; // never 0
+        uint32_t expected = 0;
+        pendingSinceUs.compare_exchange_strong(expected, now);
+    }
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/**
+ * Bounded lock-free multi-producer / single-consumer ring (Vyukov's per-cell sequence scheme).
+ * Producers claim a cell with one CAS and publish it with a release store; they never block each other
+ * or the consumer, and a full ring fails fast instead of waiting.
+ */
+template <typename T, size_t Capacity>
+class MpscRing
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static constexpr size_t MASK = Capacity - 1;
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    Cell cells[Capacity];
+    std::atomic<size_t> enqueuePosition{0};
+    size_t dequeuePosition = 0; // only touched by the consumer
+
+public:
+    MpscRing()
+    {
+        for (size_t i = 0; i < Capacity; ++i)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    /**
+     * Safe from any task; returns false when the ring is full.
+     */
+    bool tryPush(T&& value)
+    {
+        size_t position = enqueuePosition.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true)
+        {
+            cell = &cells[position & MASK];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (diff == 0)
+            {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Consumer side only; returns false when the ring is empty (or the next cell is still being written).
+     */
+    bool tryPop(T& out)
+    {
+        Cell& cell = cells[dequeuePosition & MASK];
+        const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(dequeuePosition + 1) < 0)
+            return false;
+        out = std::move(cell.value);
+        cell.sequence.store(dequeuePosition + Capacity, std::memory_order_release);
+        ++dequeuePosition;
+        return true;
+    }
+
+    /**
+     * Consumer side; approximate number of queued elements, for statistics.
+     */
+    [[nodiscard]] size_t size() const
+    {
+        return enqueuePosition.load(std::memory_order_relaxed) - dequeuePosition;
+    }
+};
@@ -4,6 +4,7 @@
 #include <optional>
 #include <array>
 #include <atomic>
+#include "signal.hh"
 #include "webserver_handler.hh"
 
 enum class OtaStatus : uint8_t
@@ -61,7 +62,8 @@ public:
 
     void begin(WebServerHandler& webServerHandler)
     {
-        const auto handler = new AsyncOtaWebHandler(webServerHandler.getAuthenticationMiddleware());
+        const auto handler = new AsyncOtaWebHandler(webServerHandler.getAuthenticationMiddleware(),
+                                                    statusChangedSignal);
         webServerHandler.getWebServer()->addHandler(handler);
         otaWebHandler = handler;
     }
@@ -76,7 +78,17 @@ public:
         return otaWebHandler ? otaWebHandler->getStatus() : OtaStatus::Idle;
     }
 
+    /**
+     * Fired from the AsyncTCP task whenever an update starts, completes, fails or is reset.
+     */
+    Signal<void(OtaStatus)>& statusChanged()
+    {
+        return statusChangedSignal;
+    }
+
 private:
+    Signal<void(OtaStatus)> statusChangedSignal;
+
     class AsyncOtaWebHandler final : public AsyncWebHandler
     {
         static constexpr auto REALM = "rgbw-ctrl";
@@ -94,6 +106,7 @@ private:
         static constexpr auto MSG_SUCCESS = "OTA update successful";
 
         const AsyncAuthenticationMiddleware& asyncAuthenticationMiddleware;
+        Signal<void(OtaStatus)>& statusChanged;
 
         mutable std::optional<std::array<char, MAX_UPDATE_ERROR_MSG_LEN>> updateError;
         mutable bool uploadCompleted = false;
@@ -105,6 +118,12 @@ private:
         mutable volatile uint32_t totalBytesExpected = 0;
         mutable volatile uint32_t totalBytesReceived = 0;
 
+        void setStatus(const OtaStatus newStatus) const
+        {
+            if (status.exchange(newStatus) != newStatus)
+                statusChanged.emit(newStatus);
+        }
+
         bool canHandle(AsyncWebServerRequest* request) const override
         {
             if (request->url() != "/update")
@@ -125,7 +144,7 @@ private:
             }
 
             resetUpdateState();
-            status = OtaStatus::Started;
+            setStatus(OtaStatus::Started);
 
             if (request->hasHeader(CONTENT_LENGTH_HEADER))
                 totalBytesExpected = request->header(CONTENT_LENGTH_HEADER).toInt();
@@ -136,7 +155,7 @@ private:
                 if (!Update.setMD5(md5Param.c_str()))
                 {
                     setUpdateError("Invalid MD5 format");
-                    status = OtaStatus::Failed;
+                    setStatus(OtaStatus::Failed);
                     return true;
                 }
             }
@@ -164,7 +183,7 @@ private:
             }
             else
             {
-                status = OtaStatus::Failed;
+                setStatus(OtaStatus::Failed);
                 checkUpdateError();
                 ESP_LOGE(LOG_TAG, "Update.begin failed");
             }
@@ -198,7 +217,7 @@ private:
             {
                 ESP_LOGW(LOG_TAG, "OTA upload incomplete: received %u of %u bytes",
                          totalBytesReceived, totalBytesExpected);
-                status = OtaStatus::Idle;
+                setStatus(OtaStatus::Idle);
                 request->send(500, "text/plain", MSG_UPLOAD_INCOMPLETE);
                 return;
             }
@@ -207,13 +226,13 @@ private:
 
             if (Update.end(true))
             {
-                status = OtaStatus::Completed;
+                setStatus(OtaStatus::Completed);
                 ESP_LOGI(LOG_TAG, "Update successfully completed");
                 request->send(200, "text/plain", MSG_SUCCESS);
             }
             else
             {
-                status = OtaStatus::Failed;
+                setStatus(OtaStatus::Failed);
                 checkUpdateError();
                 sendErrorResponse(request);
             }
@@ -233,7 +252,7 @@ private:
 
             if (Update.write(data, len) != len)
             {
-                status = OtaStatus::Failed;
+                setStatus(OtaStatus::Failed);
                 checkUpdateError();
                 return;
             }
@@ -256,7 +275,7 @@ private:
 
             if (Update.write(data, len) != len)
             {
-                status = OtaStatus::Failed;
+                setStatus(OtaStatus::Failed);
                 checkUpdateError();
                 return;
             }
@@ -289,7 +308,7 @@ private:
 
         void resetUpdateState() const
         {
-            status = OtaStatus::Idle;
+            setStatus(OtaStatus::Idle);
             uploadCompleted = false;
             totalBytesExpected = 0;
             totalBytesReceived = 0;
@@ -310,8 +329,9 @@ private:
         }
 
     public:
-        explicit AsyncOtaWebHandler(const AsyncAuthenticationMiddleware& asyncAuthenticationMiddleware)
-            : asyncAuthenticationMiddleware(asyncAuthenticationMiddleware)
+        AsyncOtaWebHandler(const AsyncAuthenticationMiddleware& asyncAuthenticationMiddleware,
+                           Signal<void(OtaStatus)>& statusChanged)
+            : asyncAuthenticationMiddleware(asyncAuthenticationMiddleware), statusChanged(statusChanged)
         {
         }
 
@@ -3,11 +3,12 @@
 #include "color.hh"
 #include "light.hh"
 #include "hardware.hh"
+#include "signal.hh"
 
 #include <array>
 #include <Arduino.h>
 #include <algorithm>
-#include <functional>
+#include <esp_timer.h>
 
 class Output
 {
@@ -18,16 +19,17 @@ class Output
         Light(static_cast<gpio_num_t>(static_cast<uint8_t>(Hardware::Pin::Output::WHITE)))
     };
 
-    std::function<void()> notifyBleCallback;
+    bool warmRestore = false;
+    int64_t firstLightUs = 0; // esp_timer time when the output first showed its restored state
+
+    // Argument is `fromBle`: the change was written by the BLE client and must not be echoed back to it.
+    Signal<void(bool)> changedSignal;
 
     static_assert(static_cast<size_t>(Color::White) < 4, "Color enum out of bounds");
 
-    void notifyChange(const bool notifyBle = true) const
+    void notifyChange(const bool notifyBle = true)
     {
-        if (notifyBle && notifyBleCallback)
-        {
-            notifyBleCallback();
-        }
+        changedSignal.emit(!notifyBle);
     }
 
 public:
@@ -37,28 +39,47 @@ public:
                            [](const Light& light) { return light.isOn(); });
     }
 
+    /**
+     * Brings the PWM channels up. Called first thing in setup(): after a warm reset the lights show their
+     * state from RTC memory before NVS and Wi-Fi are initialized.
+     */
     void begin()
     {
+        warmRestore = true;
         for (auto& light : lights)
-            light.setup();
+            warmRestore &= light.setup();
+        if (warmRestore)
+            firstLightUs = esp_timer_get_time();
     }
 
-    void handle(const unsigned long now)
+    /**
+     * Applies the persisted state after a cold boot; a no-op for lights begin() already restored.
+     */
+    void restore()
     {
         for (auto& light : lights)
-        {
-            light.handle(now);
-        }
+            light.restore();
+        if (!warmRestore)
+            firstLightUs = esp_timer_get_time();
+    }
+
+    void bootToJson(const JsonObject& to) const
+    {
+        to["warmRestore"] = warmRestore;
+        to["firstLightUs"] = firstLightUs;
     }
 
-    void setNotifyBleCallback(const std::function<void()>& callback)
+    /**
+     * Fired after every change of the output, on the task that made it (the main loop).
+     */
+    Signal<void(bool)>& changed()
     {
-        notifyBleCallback = callback;
+        return changedSignal;
     }
 
-    void update(Color color, const uint8_t value, const bool notifyBle = true)
+    void update(Color color, const uint8_t value, const bool notifyBle = true, const uint32_t transitionMs = 0)
     {
-        lights.at(static_cast<size_t>(color)).setValue(value);
+        lights.at(static_cast<size_t>(color)).setValue(value, transitionMs);
         notifyChange(notifyBle);
     }
 
@@ -74,6 +95,7 @@ public:
     {
         for (uint8_t i = 0; i < 4; ++i)
             lights[i].setState(state[i]);
+        notifyChange();
     }
 
     [[nodiscard]] bool getState(Color color) const
@@ -140,12 +162,13 @@ public:
         notifyChange();
     }
 
-    void setColor(const uint8_t r, const uint8_t g, const uint8_t b, const uint8_t w = 0)
+    void setColor(const uint8_t r, const uint8_t g, const uint8_t b, const uint8_t w = 0,
+                  const uint32_t transitionMs = 0)
     {
-        lights.at(static_cast<size_t>(Color::Red)).setValue(r);
-        lights.at(static_cast<size_t>(Color::Green)).setValue(g);
-        lights.at(static_cast<size_t>(Color::Blue)).setValue(b);
-        lights.at(static_cast<size_t>(Color::White)).setValue(w);
+        lights.at(static_cast<size_t>(Color::Red)).setValue(r, transitionMs);
+        lights.at(static_cast<size_t>(Color::Green)).setValue(g, transitionMs);
+        lights.at(static_cast<size_t>(Color::Blue)).setValue(b, transitionMs);
+        lights.at(static_cast<size_t>(Color::White)).setValue(w, transitionMs);
         notifyChange();
     }
 
@@ -162,9 +185,8 @@ public:
     void setValues(const std::array<uint8_t, 4>& array, const bool notifyBle = true)
     {
         for (size_t i = 0; i < std::min(lights.size(), array.size()); ++i)
-        {
-            update(static_cast<Color>(i), array[i], notifyBle);
-        }
+            lights[i].setValue(array[i]);
+        notifyChange(notifyBle);
     }
 
     void toJson(const JsonArray& to) const
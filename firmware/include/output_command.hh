@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <variant>
+
+#include "color.hh"
+#include "command_queue.hh"
+#include "light.hh"
+
+/**
+ * Mutations of Output requested from network tasks; applied by CommandHandler on the main loop task.
+ */
+namespace OutputCommands
+{
+    struct SetState
+    {
+        std::array<LightState, 4> state;
+    };
+
+    struct SetColor
+    {
+        std::array<uint8_t, 4> values; // indexed by Color
+        uint32_t transitionMs;
+    };
+
+    struct SetChannel
+    {
+        Color color;
+        uint8_t value;
+        uint32_t transitionMs;
+    };
+
+    // Values written by the BLE client: not echoed back over BLE, mirrored to the Alexa devices.
+    struct SetValuesFromBle
+    {
+        std::array<uint8_t, 4> values;
+    };
+
+    struct TurnOff
+    {
+    };
+}
+
+using OutputCommand = std::variant<
+    OutputCommands::TurnOff,
+    OutputCommands::SetState,
+    OutputCommands::SetColor,
+    OutputCommands::SetChannel,
+    OutputCommands::SetValuesFromBle>;
+
+using OutputCommandQueue = CommandQueue<OutputCommand, 32>;
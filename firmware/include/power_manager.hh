@@ -0,0 +1,211 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WiFi.h>
+#include <atomic>
+#include <mutex>
+
+#include "config_store.hh"
+#include "ota_handler.hh"
+#include "power_model.hh"
+#include "signal.hh"
+#include "timer_service.hh"
+#include "wifi_manager.hh"
+
+/**
+ * Applies the selected power profile to Wi-Fi modem sleep, TX power and the CPU clock. Modem sleep makes the
+ * station wake only for DTIM beacons, which delays color commands and SSDP replies by tens to hundreds of
+ * milliseconds; while a WebSocket client streams colors or an OTA update runs the device is boosted to
+ * LOW_LATENCY regardless of the selected profile. Boosts may be taken and released from any task; the profile
+ * is applied on the main loop.
+ */
+class PowerManager
+{
+    static constexpr auto LOG_TAG = "PowerManager";
+    static constexpr uint32_t STREAM_HOLD_MS = 5000; // boost kept after the last streamed color
+    static constexpr uint32_t DEFAULT_CPU_MHZ = 240;
+    static constexpr uint32_t LOW_POWER_CPU_MHZ = 80; // lowest clock that keeps the APB (and so PWM) at 80 MHz
+
+public:
+    enum Boost : uint8_t
+    {
+        STREAMING = 1 << 0,
+        OTA = 1 << 1
+    };
+
+private:
+    WiFiManager& wifiManager;
+    OtaHandler& otaHandler;
+
+    std::atomic<uint8_t> boosts{0};
+    // Held from reading bluetoothActive to the matching WiFi.setSleep(), so apply() on the main loop cannot
+    // undo the modem sleep setBluetoothActive() just turned on from another task.
+    std::mutex modemSleepMutex;
+    bool bluetoothActive = false;
+    PowerState state; // last applied, main loop only
+    // Written on the main loop; only read for metrics.
+    uint32_t boostCount = 0;
+    uint64_t boostedSinceMs = 0;
+    uint64_t boostedMs = 0;
+
+    Signal<void(const PowerState&)> changedSignal;
+    Timer applyTimer{[this] { apply(); }};
+    Timer streamTimer{[this] { release(STREAMING); }};
+
+public:
+    PowerManager(WiFiManager& wifiManager, OtaHandler& otaHandler) : wifiManager(wifiManager), otaHandler(otaHandler)
+    {
+    }
+
+    /**
+     * Applies the stored profile. Call after WiFiManager::begin(), which starts the station.
+     */
+    void begin()
+    {
+        // A new connection restarts the station, which resets the TX power.
+        wifiManager.gotIp().connect([this] { applyTimer.start(0); });
+        otaHandler.statusChanged().connect([this](const OtaStatus status)
+        {
+            if (status == OtaStatus::Started)
+                hold(OTA);
+            else
+                release(OTA);
+        });
+        apply();
+    }
+
+    /**
+     * Selects and persists a profile (main loop).
+     */
+    void setProfile(const PowerProfile profile)
+    {
+        ConfigStore::get().setPowerProfile(profile);
+        apply();
+    }
+
+    [[nodiscard]] PowerState getState() const
+    {
+        const PowerProfile profile = ConfigStore::get().getPowerProfile();
+        return {profile, boosts.load() ? PowerProfile::LOW_LATENCY : profile};
+    }
+
+    /**
+     * A color arrived from a WebSocket client: boost until none has arrived for STREAM_HOLD_MS.
+     */
+    void streamActivity()
+    {
+        hold(STREAMING);
+        streamTimer.start(STREAM_HOLD_MS);
+    }
+
+    void hold(const Boost boost)
+    {
+        if (!(boosts.fetch_or(boost) & boost))
+            applyTimer.start(0);
+    }
+
+    void release(const Boost boost)
+    {
+        if (boosts.fetch_and(static_cast<uint8_t>(~boost)) & boost)
+            applyTimer.start(0);
+    }
+
+    /**
+     * Wi-Fi and Bluetooth share the radio: the coexistence scheduler needs modem sleep, so LOW_LATENCY drops to
+     * minimum modem sleep from here on. Called before the Bluetooth controller starts, from any task.
+     */
+    void setBluetoothActive()
+    {
+        std::lock_guard<std::mutex> lock(modemSleepMutex);
+        bluetoothActive = true;
+        if (WiFi.getSleep() == WIFI_PS_NONE)
+            WiFi.setSleep(WIFI_PS_MIN_MODEM);
+    }
+
+    /**
+     * Fired on the main loop when the selected or the effective profile changes.
+     */
+    Signal<void(const PowerState&)>& changed()
+    {
+        return changedSignal;
+    }
+
+    void toJson(const JsonObject& to) const
+    {
+        getState().toJson(to);
+        const auto active = to["boosts"].to<JsonArray>();
+        const uint8_t held = boosts.load();
+        if (held & STREAMING) active.add("streaming");
+        if (held & OTA) active.add("ota");
+        to["boostCount"] = boostCount;
+        to["boostedMs"] = boostedMs + (boostedSinceMs ? TimerService::nowMs() - boostedSinceMs : 0);
+        to["modemSleep"] = modemSleepString(WiFi.getSleep());
+        to["txPowerDbm"] = static_cast<float>(WiFi.getTxPower()) / 4;
+        to["cpuMhz"] = getCpuFrequencyMhz();
+    }
+
+private:
+    void apply()
+    {
+        const PowerState next = getState();
+
+        wifi_ps_type_t sleep = WIFI_PS_MIN_MODEM;
+        wifi_power_t txPower = WIFI_POWER_19_5dBm;
+        uint32_t cpuMhz = DEFAULT_CPU_MHZ;
+        switch (next.effective)
+        {
+        case PowerProfile::LOW_LATENCY:
+            sleep = WIFI_PS_NONE;
+            break;
+        case PowerProfile::BALANCED:
+            break;
+        case PowerProfile::LOW_POWER:
+            sleep = WIFI_PS_MAX_MODEM;
+            txPower = WIFI_POWER_15dBm;
+            cpuMhz = LOW_POWER_CPU_MHZ;
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(modemSleepMutex);
+            if (sleep == WIFI_PS_NONE && bluetoothActive)
+                sleep = WIFI_PS_MIN_MODEM;
+            WiFi.setSleep(sleep);
+        }
+        WiFi.setTxPower(txPower);
+        if (getCpuFrequencyMhz() != cpuMhz)
+            setCpuFrequencyMhz(cpuMhz);
+
+        if (boosts.load() && !boostedSinceMs)
+        {
+            ++boostCount;
+            boostedSinceMs = TimerService::nowMs();
+        }
+        else if (!boosts.load() && boostedSinceMs)
+        {
+            boostedMs += TimerService::nowMs() - boostedSinceMs;
+            boostedSinceMs = 0;
+        }
+
+        if (next == state) return;
+        ESP_LOGI(LOG_TAG, "Power profile %s, in effect %s%s", PowerState::profileString(next.profile),
+                 PowerState::profileString(next.effective), next.effective != next.profile ? " (boosted)" : "");
+        state = next;
+        changedSignal.emit(state);
+    }
+
+    static const char* modemSleepString(const wifi_ps_type_t sleep)
+    {
+        switch (sleep)
+        {
+        case WIFI_PS_NONE:
+            return "none";
+        case WIFI_PS_MIN_MODEM:
+            return "min";
+        case WIFI_PS_MAX_MODEM:
+            return "max";
+        default:
+            return "unknown";
+        }
+    }
+};
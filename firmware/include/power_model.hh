@@ -0,0 +1,69 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <cstring>
+#include <optional>
+
+/**
+ * Trade-off between latency and power draw, applied to Wi-Fi modem sleep, TX power and CPU clock.
+ */
+enum class PowerProfile : uint8_t
+{
+    LOW_LATENCY = 0, // no modem sleep, maximum TX power
+    BALANCED = 1, // the ESP32 default: minimum modem sleep
+    LOW_POWER = 2 // maximum modem sleep, CPU at 80 MHz
+};
+
+#pragma pack(push, 1)
+/**
+ * Selected profile and the one in effect, which is LOW_LATENCY while a boost (color stream, OTA update) is held.
+ */
+struct PowerState
+{
+    PowerProfile profile = PowerProfile::BALANCED;
+    PowerProfile effective = PowerProfile::BALANCED;
+
+    void toJson(const JsonObject& to) const
+    {
+        to["profile"] = profileString(profile);
+        to["effective"] = profileString(effective);
+    }
+
+    [[nodiscard]] static const char* profileString(const PowerProfile profile)
+    {
+        switch (profile)
+        {
+        case PowerProfile::LOW_LATENCY:
+            return "low-latency";
+        case PowerProfile::BALANCED:
+            return "balanced";
+        case PowerProfile::LOW_POWER:
+            return "low-power";
+        }
+        return "balanced";
+    }
+
+    [[nodiscard]] static std::optional<PowerProfile> profileFromString(const char* name)
+    {
+        for (const auto profile : {PowerProfile::LOW_LATENCY, PowerProfile::BALANCED, PowerProfile::LOW_POWER})
+            if (std::strcmp(name, profileString(profile)) == 0)
+                return profile;
+        return std::nullopt;
+    }
+
+    [[nodiscard]] static bool isValid(const uint8_t value)
+    {
+        return value <= static_cast<uint8_t>(PowerProfile::LOW_POWER);
+    }
+
+    bool operator==(const PowerState& other) const
+    {
+        return profile == other.profile && effective == other.effective;
+    }
+
+    bool operator!=(const PowerState& other) const
+    {
+        return !(*this == other);
+    }
+};
+#pragma pack(pop)
@@ -4,18 +4,25 @@
 #include <functional>
 
 #include "hardware.hh"
+#include "main_loop.hh"
+#include "timer_service.hh"
 
 class PushButton
 {
     static constexpr auto LOG_TAG = "PushButton";
     gpio_num_t pin = static_cast<gpio_num_t>(static_cast<uint8_t>(Hardware::Pin::Button::BUTTON1));
 
-    unsigned long lastDown = 0;
-    unsigned long lastChange = 0;
+    static constexpr uint32_t POLL_INTERVAL_MS = 10;
+
+    uint64_t lastDown = 0;
+    uint64_t lastChange = 0;
     bool lastState = HIGH;
     bool longPressHandled = false;
-    unsigned long longPressThresholdMs = 2500;
-    unsigned long debounceDelayMs = 50;
+    uint32_t longPressThresholdMs = 2500;
+    uint32_t debounceDelayMs = 50;
+
+    // Only runs from the first edge until the button is released and settled; idle buttons cost nothing.
+    Timer pollTimer{[this] { poll(TimerService::nowMs()); }};
 
     std::function<void()> longPressCallback;
     std::function<void()> shortPressCallback;
@@ -25,13 +32,28 @@ class PushButton
         if (cb) cb();
     }
 
+    static void IRAM_ATTR onEdge()
+    {
+        MainLoop::postFromIsr(MainLoop::PIN_CHANGE);
+    }
+
 public:
-    explicit PushButton(unsigned long thresholdMs = 2000)
+    explicit PushButton(const uint32_t thresholdMs = 2000)
         : longPressThresholdMs(thresholdMs)
     {
         pinMode(this->pin, INPUT_PULLUP);
     }
 
+    void begin()
+    {
+        MainLoop::get().subscribe(MainLoop::PIN_CHANGE, [this]
+        {
+            if (!pollTimer.isActive())
+                pollTimer.start(0, POLL_INTERVAL_MS);
+        });
+        attachInterrupt(pin, onEdge, CHANGE);
+    }
+
     void setLongPressCallback(const std::function<void()>& callback)
     {
         longPressCallback = callback;
@@ -42,7 +64,8 @@ public:
         shortPressCallback = callback;
     }
 
-    void handle(const unsigned long now)
+private:
+    void poll(const uint64_t now)
     {
         const bool currentState = digitalRead(pin);
 
@@ -80,5 +103,7 @@ public:
         }
 
         lastState = currentState;
+        if (currentState == HIGH && now - lastChange >= debounceDelayMs)
+            pollTimer.stop();
     }
 };
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+/**
+ * Exponential backoff with jitter for reconnect attempts: the n-th consecutive failure waits
+ * `baseMs * 2^(n-1)`, capped at `maxMs`, spread by ±`jitterPercent` so a site full of controllers that lost the
+ * same access point does not come back in lockstep. Pure logic; the caller supplies the random value.
+ */
+class ReconnectBackoff
+{
+public:
+    struct Config
+    {
+        uint32_t baseMs = 1000;
+        uint32_t maxMs = 60000;
+        uint8_t jitterPercent = 25;
+    };
+
+private:
+    Config config;
+    uint16_t failures = 0;
+    uint32_t lastDelayMs = 0;
+
+public:
+    ReconnectBackoff() = default;
+
+    explicit ReconnectBackoff(const Config& config) : config(config)
+    {
+    }
+
+    /**
+     * Records a failure and returns how long to wait before the next attempt.
+     */
+    uint32_t next(const uint32_t random)
+    {
+        const uint8_t exponent = static_cast<uint8_t>(std::min<uint16_t>(failures, 16));
+        if (failures < UINT16_MAX)
+            ++failures;
+        const uint32_t delay = static_cast<uint32_t>(
+            std::min<uint64_t>(static_cast<uint64_t>(config.baseMs) << exponent, config.maxMs));
+        const uint32_t spread = delay / 100 * config.jitterPercent;
+        lastDelayMs = spread == 0 ? delay : delay - spread + random % (2 * spread + 1);
+        return lastDelayMs;
+    }
+
+    void reset()
+    {
+        failures = 0;
+        lastDelayMs = 0;
+    }
+
+    [[nodiscard]] uint16_t getFailures() const { return failures; }
+    [[nodiscard]] uint32_t getLastDelayMs() const { return lastDelayMs; }
+};
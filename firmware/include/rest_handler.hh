@@ -4,14 +4,23 @@
 #include <AsyncJson.h>
 
 #include "version.hh"
+#include "config_store.hh"
 #include "wifi_manager.hh"
 #include "alexa_integration.hh"
 #include "ble_manager.hh"
 #include "ota_handler.hh"
+#include "async_call.hh"
+#include "boot_profiler.hh"
+#include "main_loop.hh"
+#include "control_command.hh"
+#include "output_command.hh"
+#include "power_manager.hh"
+#include "supply_monitor.hh"
+#include "websocket_handler.hh"
 
 enum class RestEndpoint
 {
-    State, Color, Bluetooth, Restart, Reset, Unknown
+    State, Metrics, Color, Bluetooth, WiFiIp, WiFiNetworks, Power, Scenes, SaveScene, DeleteScene, Restart, Reset, Unknown
 };
 
 class RestHandler
@@ -21,6 +30,11 @@ class RestHandler
     WiFiManager& wifiManager;
     AlexaIntegration& alexaIntegration;
     BleManager& bleManager;
+    PowerManager& powerManager;
+    OutputCommandQueue& outputCommands;
+    ControlCommandQueue& controlCommands;
+    SupplyMonitor& supplyMonitor;
+    WebSocketHandler& webSocketHandler;
 
 public:
     RestHandler(
@@ -28,14 +42,24 @@ public:
         OtaHandler& otaHandler,
         WiFiManager& wifiManager,
         AlexaIntegration& alexaIntegration,
-        BleManager& bleManager
+        BleManager& bleManager,
+        PowerManager& powerManager,
+        OutputCommandQueue& outputCommands,
+        ControlCommandQueue& controlCommands,
+        SupplyMonitor& supplyMonitor,
+        WebSocketHandler& webSocketHandler
     )
         :
         output(output),
         otaHandler(otaHandler),
         wifiManager(wifiManager),
         alexaIntegration(alexaIntegration),
-        bleManager(bleManager)
+        bleManager(bleManager),
+        powerManager(powerManager),
+        outputCommands(outputCommands),
+        controlCommands(controlCommands),
+        supplyMonitor(supplyMonitor),
+        webSocketHandler(webSocketHandler)
     {
     }
 
@@ -57,6 +81,45 @@ public:
         output.toJson(doc["output"].to<JsonArray>());
         bleManager.toJson(doc["ble"].to<JsonObject>());
         otaHandler.getState().toJson(doc["ota"].to<JsonObject>());
+        powerManager.getState().toJson(doc["power"].to<JsonObject>());
+
+        response->addHeader("Cache-Control", "no-store");
+        response->setLength();
+        request->send(response);
+    }
+
+    void handleMetricsRequest(AsyncWebServerRequest* request) const
+    {
+        const auto response = new AsyncJsonResponse();
+        const auto doc = response->getRoot().to<JsonObject>();
+        doc["uptime"] = millis();
+        const auto boot = doc["boot"].to<JsonObject>();
+        boot["resetReason"] = static_cast<int>(esp_reset_reason());
+        output.bootToJson(boot);
+        boot["networkReadyUs"] = BootProfiler::getUs("gotIp");
+        BootProfiler::toJson(boot["phases"].to<JsonArray>());
+        alexaIntegration.getSsdpStats().toJson(doc["ssdp"].to<JsonObject>());
+
+        const auto asyncCall = doc["asyncCall"].to<JsonObject>();
+        const auto asyncCallStats = async_call_stats();
+        asyncCall["queueDepth"] = asyncCallStats.queueDepth;
+        asyncCall["maxQueueDepth"] = asyncCallStats.maxQueueDepth;
+        asyncCall["executed"] = asyncCallStats.executed;
+        asyncCall["rejected"] = asyncCallStats.rejected;
+        asyncCall["cancelled"] = asyncCallStats.cancelled;
+        asyncCall["maxLatencyUs"] = asyncCallStats.maxLatencyUs;
+        asyncCall["maxRuntimeUs"] = asyncCallStats.maxRuntimeUs;
+
+        MainLoop::get().toJson(doc["mainLoop"].to<JsonObject>());
+
+        const auto commands = doc["commands"].to<JsonObject>();
+        outputCommands.toJson(commands["output"].to<JsonObject>());
+        controlCommands.toJson(commands["control"].to<JsonObject>());
+        ConfigStore::get().toJson(doc["config"].to<JsonObject>());
+        wifiManager.metricsToJson(doc["wifi"].to<JsonObject>());
+        supplyMonitor.toJson(doc["supply"].to<JsonObject>());
+        powerManager.toJson(doc["power"].to<JsonObject>());
+        webSocketHandler.metricsToJson(doc["websocket"].to<JsonObject>());
 
         response->addHeader("Cache-Control", "no-store");
         response->setLength();
@@ -77,6 +140,7 @@ public:
     {
         request->onDisconnect([this]()
         {
+            ConfigStore::get().discardPending();
             nvs_flash_erase();
             delay(300);
             bleManager.stop();
@@ -108,14 +172,177 @@ public:
             request->send(200, "text/plain", "Bluetooth disabled, device will restart");
     }
 
+    /**
+     * Without parameters returns the stored configuration; `mode=dhcp` or `mode=static&ip=...&subnet=...`
+     * (optionally `gateway`, `dns`) replaces it for the next connection and returns the new configuration.
+     */
+    void handleWiFiIpRequest(AsyncWebServerRequest* request) const
+    {
+        WiFiStaticIp staticIp = ConfigStore::get().getWiFiStaticIp();
+        if (request->hasParam("mode"))
+        {
+            staticIp = {};
+            staticIp.enabled = request->getParam("mode")->value() == "static";
+            if (staticIp.enabled
+                && !(extractAddress(request, "ip", staticIp.ip)
+                    && extractAddress(request, "subnet", staticIp.subnet)
+                    && extractAddress(request, "gateway", staticIp.gateway)
+                    && extractAddress(request, "dns", staticIp.dns)))
+            {
+                request->send(400, "text/plain", "Invalid address");
+                return;
+            }
+            if (!WiFiManager::acceptsStaticIp(staticIp))
+            {
+                request->send(400, "text/plain", "Static mode needs ip, subnet and a stored network");
+                return;
+            }
+            if (!controlCommands.post(ControlCommands::SetStaticIp{staticIp}))
+            {
+                request->send(503, "text/plain", "Busy, try again");
+                return;
+            }
+        }
+
+        const auto response = new AsyncJsonResponse();
+        staticIp.toJson(response->getRoot().to<JsonObject>());
+        response->addHeader("Cache-Control", "no-store");
+        response->setLength();
+        request->send(response);
+    }
+
+    /**
+     * Lists the stored networks, the one in use first; `forget=<ssid>` removes one of them and lists the
+     * networks that remain.
+     */
+    void handleWiFiNetworksRequest(AsyncWebServerRequest* request) const
+    {
+        ControlCommands::ForgetWiFiNetwork forget = {};
+        if (request->hasParam("forget"))
+        {
+            const auto& ssid = request->getParam("forget")->value();
+            if (ssid.length() > WIFI_MAX_SSID_LENGTH || WiFiManager::knownNetworkIndex(ssid.c_str()) < 0)
+            {
+                request->send(404, "text/plain", "Network not found");
+                return;
+            }
+            strncpy(forget.ssid, ssid.c_str(), WIFI_MAX_SSID_LENGTH);
+            if (!controlCommands.post(forget))
+            {
+                request->send(503, "text/plain", "Busy, try again");
+                return;
+            }
+        }
+
+        const auto response = new AsyncJsonResponse(true);
+        const auto networks = response->getRoot().to<JsonArray>();
+        const auto& configStore = ConfigStore::get();
+        for (uint8_t i = 0; i < configStore.getKnownWiFiNetworkCount(); ++i)
+        {
+            const auto details = configStore.getKnownWiFiNetwork(i);
+            if (details && strcmp(details->ssid, forget.ssid) != 0) // already on its way out
+                networks.add(details->ssid);
+        }
+        response->addHeader("Cache-Control", "no-store");
+        response->setLength();
+        request->send(response);
+    }
+
+    /**
+     * Without parameters returns the selected and effective profile; `profile=low-latency|balanced|low-power`
+     * selects one.
+     */
+    void handlePowerRequest(AsyncWebServerRequest* request) const
+    {
+        if (request->hasParam("profile"))
+        {
+            const auto profile = PowerState::profileFromString(request->getParam("profile")->value().c_str());
+            if (!profile)
+                request->send(400, "text/plain", "Unknown profile");
+            else if (controlCommands.post(ControlCommands::SetPowerProfile{profile.value()}))
+                request->send(200, "text/plain", "Power profile set");
+            else
+                request->send(503, "text/plain", "Busy, try again");
+            return;
+        }
+
+        const auto response = new AsyncJsonResponse();
+        powerManager.getState().toJson(response->getRoot().to<JsonObject>());
+        response->addHeader("Cache-Control", "no-store");
+        response->setLength();
+        request->send(response);
+    }
+
     void handleColorRequest(AsyncWebServerRequest* request) const
     {
         const auto r = extractParam(request, "r", Color::Red);
         const auto g = extractParam(request, "g", Color::Green);
         const auto b = extractParam(request, "b", Color::Blue);
         const auto w = extractParam(request, "w", Color::White);
-        output.setColor(r, g, b, w);
-        request->send(200, "text/plain", "Color set");
+        if (outputCommands.post(OutputCommands::SetColor{{r, g, b, w}, 0}))
+            request->send(200, "text/plain", "Color set");
+        else
+            request->send(503, "text/plain", "Busy, try again");
+    }
+
+    void handleScenesRequest(AsyncWebServerRequest* request) const
+    {
+        const auto response = new AsyncJsonResponse(true);
+        alexaIntegration.scenesToJson(response->getRoot().to<JsonArray>());
+        response->addHeader("Cache-Control", "no-store");
+        response->setLength();
+        request->send(response);
+    }
+
+    void handleSaveSceneRequest(AsyncWebServerRequest* request) const
+    {
+        if (!request->hasParam("name"))
+        {
+            request->send(400, "text/plain", "Missing parameter: name");
+            return;
+        }
+
+        AlexaScene scene;
+        strncpy(scene.name, request->getParam("name")->value().c_str(), sizeof(scene.name) - 1);
+        if (scene.name[0] == '\0')
+        {
+            request->send(400, "text/plain", "Empty scene name");
+            return;
+        }
+        scene.r = extractParam(request, "r", Color::Red);
+        scene.g = extractParam(request, "g", Color::Green);
+        scene.b = extractParam(request, "b", Color::Blue);
+        scene.w = extractParam(request, "w", Color::White);
+        if (alexaIntegration.saveScene(scene))
+            request->send(200, "text/plain", "Scene saved, restart to apply");
+        else
+            request->send(409, "text/plain", "Scene limit reached");
+    }
+
+    void handleDeleteSceneRequest(AsyncWebServerRequest* request) const
+    {
+        if (!request->hasParam("name"))
+        {
+            request->send(400, "text/plain", "Missing parameter: name");
+            return;
+        }
+
+        if (alexaIntegration.deleteScene(request->getParam("name")->value().c_str()))
+            request->send(200, "text/plain", "Scene deleted, restart to apply");
+        else
+            request->send(404, "text/plain", "Scene not found");
+    }
+
+    /**
+     * A missing parameter leaves `to` at 0; false only for a malformed address.
+     */
+    static bool extractAddress(const AsyncWebServerRequest* req, const char* key, uint32_t& to)
+    {
+        if (!req->hasParam(key)) return true;
+        IPAddress address;
+        if (!address.fromString(req->getParam(key)->value())) return false;
+        to = static_cast<uint32_t>(address);
+        return true;
     }
 
     uint8_t extractParam(const AsyncWebServerRequest* req, const char* key, const Color color) const
@@ -149,12 +376,33 @@ public:
             case RestEndpoint::State:
                 restHandler->handleStateRequest(request);
                 break;
+            case RestEndpoint::Metrics:
+                restHandler->handleMetricsRequest(request);
+                break;
             case RestEndpoint::Color:
                 restHandler->handleColorRequest(request);
                 break;
             case RestEndpoint::Bluetooth:
                 restHandler->handleBluetoothRequest(request);
                 break;
+            case RestEndpoint::WiFiIp:
+                restHandler->handleWiFiIpRequest(request);
+                break;
+            case RestEndpoint::WiFiNetworks:
+                restHandler->handleWiFiNetworksRequest(request);
+                break;
+            case RestEndpoint::Power:
+                restHandler->handlePowerRequest(request);
+                break;
+            case RestEndpoint::Scenes:
+                restHandler->handleScenesRequest(request);
+                break;
+            case RestEndpoint::SaveScene:
+                restHandler->handleSaveSceneRequest(request);
+                break;
+            case RestEndpoint::DeleteScene:
+                restHandler->handleDeleteSceneRequest(request);
+                break;
             case RestEndpoint::Restart:
                 restHandler->handleRestartRequest(request);
                 break;
@@ -169,8 +417,15 @@ public:
         static RestEndpoint getEndpoint(const String& path)
         {
             if (path == "/state") return RestEndpoint::State;
+            if (path == "/metrics") return RestEndpoint::Metrics;
             if (path == "/color") return RestEndpoint::Color;
             if (path == "/bluetooth") return RestEndpoint::Bluetooth;
+            if (path == "/wifi/ip") return RestEndpoint::WiFiIp;
+            if (path == "/wifi/networks") return RestEndpoint::WiFiNetworks;
+            if (path == "/power") return RestEndpoint::Power;
+            if (path == "/alexa/scenes") return RestEndpoint::Scenes;
+            if (path == "/alexa/scenes/save") return RestEndpoint::SaveScene;
+            if (path == "/alexa/scenes/delete") return RestEndpoint::DeleteScene;
             if (path == "/system/restart") return RestEndpoint::Restart;
             if (path == "/system/reset") return RestEndpoint::Reset;
             return RestEndpoint::Unknown;
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <esp_attr.h>
+#include <esp_system.h>
+#include <rom/crc.h>
+
+#include "hardware.hh"
+#include "light_state.hh"
+
+/**
+ * Output light states in RTC slow memory (RTC_NOINIT_ATTR), guarded by a magic and a CRC. RTC memory survives
+ * software, panic, watchdog and brownout resets but not a power-on or EN-pin reset, so after a restart the
+ * output can be restored at the very start of setup(), before NVS or Wi-Fi are touched.
+ */
+class RtcLightMirror
+{
+    static constexpr uint32_t MAGIC = 0x4C474852; // "RHGL"
+    static constexpr size_t COUNT = Hardware::Pin::OUTPUTS.size();
+
+    struct Content
+    {
+        uint32_t magic;
+        LightState lights[COUNT];
+        uint32_t crc;
+    };
+
+    static inline RTC_NOINIT_ATTR Content content;
+
+    static uint32_t checksum()
+    {
+        return crc32_le(0, reinterpret_cast<const uint8_t*>(content.lights), sizeof(content.lights));
+    }
+
+public:
+    /**
+     * True when the last reset kept RTC memory and the mirror is intact.
+     */
+    static bool isValid()
+    {
+        switch (esp_reset_reason())
+        {
+        case ESP_RST_POWERON:
+        case ESP_RST_EXT:
+        case ESP_RST_UNKNOWN:
+            return false;
+        default:
+            return content.magic == MAGIC && content.crc == checksum();
+        }
+    }
+
+    static LightState get(const size_t index)
+    {
+        return content.lights[index];
+    }
+
+    /**
+     * Copies the mirrored states into `out` (COUNT entries); false when the mirror is not valid.
+     */
+    static bool read(LightState* out)
+    {
+        if (!isValid()) return false;
+        std::copy_n(content.lights, COUNT, out);
+        return true;
+    }
+
+    static void set(const size_t index, const LightState& state)
+    {
+        content.lights[index] = state;
+        content.magic = MAGIC;
+        content.crc = checksum();
+    }
+
+    static void write(const LightState* lights)
+    {
+        std::copy_n(lights, COUNT, content.lights);
+        content.magic = MAGIC;
+        content.crc = checksum();
+    }
+
+    /**
+     * Invalidates the mirror, so the next boot falls back to NVS; the restart after a factory reset is a
+     * software reset, which would otherwise bring the old states back.
+     */
+    static void clear()
+    {
+        content.magic = 0;
+    }
+};
@@ -9,6 +9,10 @@ private:
 
 public:
     explicit Sensor(const gpio_num_t pin) : pin(pin)
+    {
+    }
+
+    void begin() const
     {
         pinMode(pin, INPUT);
     }
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <esp_log.h>
+
+#include "inplace_function.hh"
+
+template <typename Signature, size_t MaxSlots = 4, size_t SlotCapacity = 16>
+class Signal;
+
+/**
+ * Fixed-capacity multi-subscriber notification. Slots are stored inline (no heap) and are append-only:
+ * subscribers are long-lived components wired at startup. connect() publishes a slot with a release store,
+ * so emitting from another task concurrently with connect() is safe; connect() itself must not race with
+ * another connect().
+ * Slots run synchronously on the emitting task; anything heavy or thread-affine should post or arm a timer.
+ */
+template <typename... Args, size_t MaxSlots, size_t SlotCapacity>
+class Signal<void(Args...), MaxSlots, SlotCapacity>
+{
+public:
+    using Slot = InplaceFunction<void(Args...), SlotCapacity>;
+
+private:
+    Slot slots[MaxSlots];
+    std::atomic<uint8_t> count{0};
+
+public:
+    Signal() = default;
+    Signal(const Signal&) = delete;
+    Signal& operator=(const Signal&) = delete;
+
+    bool connect(Slot slot)
+    {
+        const uint8_t index = count.load(std::memory_order_relaxed);
+        if (index >= MaxSlots)
+        {
+            ESP_LOGE("Signal", "No free slot, subscriber dropped");
+            return false;
+        }
+        slots[index] = std::move(slot);
+        count.store(index + 1, std::memory_order_release);
+        return true;
+    }
+
+    void emit(const Args&... args)
+    {
+        const uint8_t connected = count.load(std::memory_order_acquire);
+        for (uint8_t i = 0; i < connected; ++i)
+            slots[i](args...);
+    }
+
+    [[nodiscard]] uint8_t size() const
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * NOTIFY messages the emulated Hue bridge multicasts as a UPnP root device: one per notification type (root
+ * device, device UUID, device type). Pure formatting, shared by the firmware and the host test.
+ */
+struct SsdpNotify
+{
+    static constexpr uint8_t TYPE_COUNT = 3;
+    static constexpr uint32_t MAX_AGE_S = 100;
+
+    /**
+     * Renders message `index` for the bridge at `ip` (four bytes) with the lower-case hex MAC `escapedMac`;
+     * returns the length snprintf reports.
+     */
+    static size_t render(char* buffer, const size_t size, const bool alive, const uint8_t index, const uint8_t* ip,
+                         const char* escapedMac)
+    {
+        char nt[48];
+        const char* usnSuffix = "";
+        switch (index)
+        {
+        case 0:
+            snprintf(nt, sizeof(nt), "upnp:rootdevice");
+            usnSuffix = "::upnp:rootdevice";
+            break;
+        case 1:
+            snprintf(nt, sizeof(nt), "uuid:2f402f80-da50-11e1-9b23-%s", escapedMac);
+            break;
+        default:
+            snprintf(nt, sizeof(nt), "urn:schemas-upnp-org:device:basic:1");
+            usnSuffix = "::urn:schemas-upnp-org:device:basic:1";
+            break;
+        }
+
+        const int length = snprintf(buffer, size,
+                                    "NOTIFY * HTTP/1.1\r\n"
+                                    "HOST: 239.255.255.250:1900\r\n"
+                                    "CACHE-CONTROL: max-age=%u\r\n"
+                                    "LOCATION: http://%u.%u.%u.%u:80/description.xml\r\n"
+                                    "SERVER: FreeRTOS/6.0.5, UPnP/1.0, IpBridge/1.17.0\r\n"
+                                    "NTS: %s\r\n"
+                                    "hue-bridgeid: %s\r\n"
+                                    "NT: %s\r\n"
+                                    "USN: uuid:2f402f80-da50-11e1-9b23-%s%s\r\n"
+                                    "\r\n",
+                                    static_cast<unsigned>(MAX_AGE_S), ip[0], ip[1], ip[2], ip[3],
+                                    alive ? "ssdp:alive" : "ssdp:byebye", escapedMac, nt, escapedMac, usnSuffix);
+        return length > 0 ? static_cast<size_t>(length) : 0;
+    }
+};
@@ -0,0 +1,372 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <cstring>
+#include <algorithm>
+
+#include <Arduino.h>
+#include <AsyncUDP.h>
+#include <ArduinoJson.h>
+#include <freertos/FreeRTOS.h> // NOLINT
+#include <freertos/task.h>
+#include <esp_system.h>
+
+// Interval of the periodic ssdp:alive announcements; must stay well below the advertised max-age.
+#ifndef SSDP_NOTIFY_INTERVAL_MS
+#define SSDP_NOTIFY_INTERVAL_MS 30000
+#endif
+
+/**
+ * Answers SSDP M-SEARCH requests for the emulated Hue bridge.
+ *
+ * Packets are received by AsyncUDP on the network stack task, so a multicast flood never reaches the
+ * main loop. Each source gets a token bucket, and accepted searches are answered from a small task
+ * after a random delay of up to MX seconds, as the UPnP device architecture requires.
+ *
+ * The same task multicasts ssdp:alive NOTIFY messages on begin() (boot and every IP change) and
+ * periodically, and ssdp:byebye is sent from a shutdown handler, so every esp_restart() path
+ * (BLE stop, OTA, REST restart) withdraws the bridge before the device goes away.
+ */
+class SsdpResponder
+{
+public:
+    /**
+     * Copies the M-SEARCH reply into `buffer`; returns its length.
+     */
+    using ResponseProvider = std::function<size_t(char* buffer, size_t size)>;
+    /**
+     * Renders NOTIFY message `index` (one per notification type) into `buffer`; returns its length.
+     */
+    using NotifyRenderer = std::function<size_t(char* buffer, size_t size, bool alive, uint8_t index)>;
+
+    struct Stats
+    {
+        std::atomic<uint32_t> handled = 0;
+        std::atomic<uint32_t> ignored = 0;
+        std::atomic<uint32_t> rateLimited = 0;
+        std::atomic<uint32_t> announcements = 0;
+
+        void toJson(const JsonObject& to) const
+        {
+            to["handled"] = handled.load();
+            to["ignored"] = ignored.load();
+            to["rateLimited"] = rateLimited.load();
+            to["announcements"] = announcements.load();
+        }
+    };
+
+private:
+    static constexpr auto LOG_TAG = "SsdpResponder";
+    static constexpr auto TASK_NAME = "SsdpResponder";
+    static constexpr uint32_t TASK_STACK_SIZE = 3072;
+    static constexpr uint16_t SSDP_PORT = 1900;
+    static constexpr size_t MAX_PACKET_SIZE = 512;
+    static constexpr uint8_t MAX_SOURCES = 8;
+    static constexpr uint8_t MAX_PENDING = 8;
+    static constexpr uint8_t BUCKET_CAPACITY = 4;
+    static constexpr uint32_t BUCKET_REFILL_INTERVAL_MS = 1000;
+    static constexpr uint8_t DEFAULT_MX = 1;
+    static constexpr uint8_t MAX_MX = 5;
+    static constexpr uint32_t IDLE_WAIT_MS = 1000;
+    static constexpr uint32_t NOTIFY_INTERVAL_MS = SSDP_NOTIFY_INTERVAL_MS;
+    static constexpr size_t MAX_NOTIFY_SIZE = 384;
+    static constexpr uint32_t BYEBYE_FLUSH_MS = 20;
+
+    static inline SsdpResponder* shutdownInstance = nullptr;
+
+    struct Source
+    {
+        uint32_t ip = 0;
+        uint8_t tokens = 0;
+        unsigned long lastRefill = 0;
+        unsigned long lastSeen = 0;
+    };
+
+    struct PendingReply
+    {
+        bool used = false;
+        uint32_t ip = 0;
+        uint16_t port = 0;
+        unsigned long dueAt = 0;
+    };
+
+    AsyncUDP udp;
+    ResponseProvider responseProvider;
+    NotifyRenderer notifyRenderer;
+    uint8_t notifyCount;
+    std::atomic<bool> enabled = true;
+    std::atomic<bool> listening = false;
+    std::atomic<bool> announceRequested = false;
+    unsigned long lastAnnounce = 0;
+    TaskHandle_t taskHandle = nullptr;
+
+    std::mutex mutex;
+    Source sources[MAX_SOURCES] = {};
+    PendingReply pending[MAX_PENDING] = {};
+
+    Stats stats;
+
+public:
+    SsdpResponder(ResponseProvider responseProvider, NotifyRenderer notifyRenderer, const uint8_t notifyCount)
+        : responseProvider(std::move(responseProvider)),
+          notifyRenderer(std::move(notifyRenderer)),
+          notifyCount(notifyCount)
+    {
+    }
+
+    /**
+     * Safe to call on every GOT_IP: the socket is re-bound and the multicast group re-joined.
+     */
+    bool begin()
+    {
+        if (!taskHandle && xTaskCreate(replyTask, TASK_NAME, TASK_STACK_SIZE, this, 1, &taskHandle) != pdPASS)
+        {
+            ESP_LOGE(LOG_TAG, "Failed to create task");
+            taskHandle = nullptr;
+            return false;
+        }
+        if (!shutdownInstance)
+        {
+            shutdownInstance = this;
+            esp_register_shutdown_handler(onShutdown);
+        }
+
+        listening = false;
+        udp.close();
+        if (!udp.listenMulticast(multicastAddress(), SSDP_PORT))
+        {
+            ESP_LOGE(LOG_TAG, "Failed to join the SSDP multicast group");
+            return false;
+        }
+        udp.onPacket([this](AsyncUDPPacket& packet)
+        {
+            handlePacket(packet);
+        });
+        listening = true;
+        announceRequested = true;
+        xTaskNotifyGive(taskHandle);
+        return true;
+    }
+
+    /**
+     * Multicasts ssdp:byebye for every notification type; called before a restart.
+     */
+    void byebye()
+    {
+        if (listening && enabled)
+            announce(false);
+    }
+
+    void setEnabled(const bool enabled)
+    {
+        this->enabled = enabled;
+    }
+
+    [[nodiscard]] const Stats& getStats() const
+    {
+        return stats;
+    }
+
+private:
+    static IPAddress multicastAddress()
+    {
+        return {239, 255, 255, 250};
+    }
+
+    static void onShutdown()
+    {
+        shutdownInstance->byebye();
+        vTaskDelay(pdMS_TO_TICKS(BYEBYE_FLUSH_MS)); // let the stack hand the packets to the driver
+    }
+
+    void announce(const bool alive)
+    {
+        char buffer[MAX_NOTIFY_SIZE];
+        for (uint8_t i = 0; i < notifyCount; ++i)
+        {
+            const size_t length = std::min(notifyRenderer(buffer, sizeof(buffer), alive, i), sizeof(buffer) - 1);
+            if (length > 0)
+                udp.writeTo(reinterpret_cast<const uint8_t*>(buffer), length, multicastAddress(), SSDP_PORT);
+        }
+        if (alive) ++stats.announcements;
+    }
+
+    /**
+     * Announces when begin() asked for it or the interval elapsed; returns the time left until the next one.
+     */
+    uint32_t announceIfDue()
+    {
+        const unsigned long now = millis();
+        if (!listening || !enabled) return NOTIFY_INTERVAL_MS;
+        if (announceRequested.exchange(false) || now - lastAnnounce >= NOTIFY_INTERVAL_MS)
+        {
+            announce(true);
+            lastAnnounce = now;
+            return NOTIFY_INTERVAL_MS;
+        }
+        return NOTIFY_INTERVAL_MS - (now - lastAnnounce);
+    }
+
+    void handlePacket(AsyncUDPPacket& packet)
+    {
+        const auto* data = reinterpret_cast<const char*>(packet.data());
+        const size_t length = packet.length();
+        if (!enabled || length > MAX_PACKET_SIZE || !isDiscoveryRequest(data, length))
+        {
+            ++stats.ignored;
+            return;
+        }
+
+        const uint32_t ip = packet.remoteIP();
+        const unsigned long now = millis();
+        const unsigned long delayMs = esp_random() % (parseMx(data, length) * 1000UL);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!takeToken(ip, now))
+        {
+            ++stats.rateLimited;
+            return;
+        }
+        PendingReply* slot = nullptr;
+        for (auto& reply : pending)
+        {
+            if (!reply.used)
+            {
+                slot = &reply;
+                break;
+            }
+        }
+        if (!slot)
+        {
+            ++stats.rateLimited;
+            return;
+        }
+        *slot = {true, ip, packet.remotePort(), now + delayMs};
+        ++stats.handled;
+        xTaskNotifyGive(taskHandle);
+    }
+
+    static bool isDiscoveryRequest(const char* data, const size_t length)
+    {
+        return length >= 8 && strncmp(data, "M-SEARCH", 8) == 0
+            && contains(data, length, "ssdp:disc")
+            && (contains(data, length, "upnp:rootd")
+                || contains(data, length, "ssdp:all")
+                || contains(data, length, "asic:1"));
+    }
+
+    /**
+     * MX is the upper bound, in seconds, of the random reply delay; values above 5 are treated as 5.
+     */
+    static uint8_t parseMx(const char* data, const size_t length)
+    {
+        for (size_t i = 0; i + 4 < length; ++i)
+        {
+            if (data[i] != '\n' || (data[i + 1] != 'M' && data[i + 1] != 'm')
+                || (data[i + 2] != 'X' && data[i + 2] != 'x') || data[i + 3] != ':')
+                continue;
+
+            size_t cursor = i + 4;
+            while (cursor < length && data[cursor] == ' ') ++cursor;
+            uint32_t mx = 0;
+            bool found = false;
+            while (cursor < length && data[cursor] >= '0' && data[cursor] <= '9' && mx <= MAX_MX)
+            {
+                mx = mx * 10 + (data[cursor++] - '0');
+                found = true;
+            }
+            if (!found || mx == 0) return DEFAULT_MX;
+            return mx > MAX_MX ? MAX_MX : static_cast<uint8_t>(mx);
+        }
+        return DEFAULT_MX;
+    }
+
+    static bool contains(const char* data, const size_t length, const char* needle)
+    {
+        const size_t needleLength = strlen(needle);
+        for (size_t i = 0; i + needleLength <= length; ++i)
+        {
+            if (memcmp(data + i, needle, needleLength) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    bool takeToken(const uint32_t ip, const unsigned long now)
+    {
+        Source* source = nullptr;
+        for (auto& candidate : sources)
+        {
+            if (candidate.ip == ip)
+            {
+                source = &candidate;
+                break;
+            }
+            if (!source || candidate.lastSeen < source->lastSeen)
+                source = &candidate; // least recently seen, evicted if ip is unknown
+        }
+        if (source->ip != ip)
+            *source = {ip, BUCKET_CAPACITY, now, now};
+
+        const unsigned long refill = (now - source->lastRefill) / BUCKET_REFILL_INTERVAL_MS;
+        if (refill > 0)
+        {
+            source->tokens = std::min<unsigned long>(BUCKET_CAPACITY, source->tokens + refill);
+            source->lastRefill += refill * BUCKET_REFILL_INTERVAL_MS;
+        }
+        source->lastSeen = now;
+
+        if (source->tokens == 0) return false;
+        --source->tokens;
+        return true;
+    }
+
+    [[noreturn]] static void replyTask(void* arg)
+    {
+        auto* responder = static_cast<SsdpResponder*>(arg);
+        while (true)
+        {
+            const uint32_t waitMs = std::min(responder->sendDueReplies(), responder->announceIfDue());
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+        }
+    }
+
+    /**
+     * Sends every reply whose delay has elapsed and returns how long to sleep until the next one.
+     */
+    uint32_t sendDueReplies()
+    {
+        uint32_t waitMs = IDLE_WAIT_MS;
+        PendingReply due[MAX_PENDING];
+        uint8_t dueCount = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const unsigned long now = millis();
+            for (auto& reply : pending)
+            {
+                if (!reply.used) continue;
+                const auto remaining = static_cast<long>(reply.dueAt - now);
+                if (remaining <= 0)
+                {
+                    due[dueCount++] = reply;
+                    reply.used = false;
+                }
+                else if (static_cast<uint32_t>(remaining) < waitMs)
+                {
+                    waitMs = remaining;
+                }
+            }
+        }
+
+        if (dueCount == 0) return waitMs;
+        char response[MAX_PACKET_SIZE];
+        const size_t length = responseProvider(response, sizeof(response));
+        for (uint8_t i = 0; i < dueCount && length > 0; ++i)
+        {
+            udp.writeTo(reinterpret_cast<const uint8_t*>(response), length, IPAddress(due[i].ip), due[i].port);
+        }
+        return waitMs;
+    }
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <esp_log.h>
+
+#include "brownout_detector.hh"
+#include "config_store.hh"
+#include "hardware.hh"
+#include "sensor.hh"
+#include "timer_service.hh"
+
+/**
+ * Samples the supply voltage divider on GPIO34 from the main loop and drives power-aware persistence: once a
+ * nominal supply is established, light changes stay in RAM (and RTC memory) and only reach flash at a long
+ * fallback interval, or right away when the supply starts collapsing. Without a plausible supply reading
+ * (sensor not fitted, USB powered) the config store keeps its normal write-behind delay, and the divider is
+ * only checked every few seconds instead of waking the main loop every 10 ms.
+ */
+class SupplyMonitor
+{
+    static constexpr auto LOG_TAG = "SupplyMonitor";
+    static constexpr uint32_t SAMPLE_INTERVAL_MS = 10;
+    static constexpr uint32_t RECHECK_INTERVAL_MS = 5000; // while no supply is seen
+    static constexpr uint32_t FALLBACK_WRITE_DELAY_MS = 15 * 60 * 1000;
+
+    Sensor sensor{static_cast<gpio_num_t>(static_cast<uint8_t>(Hardware::Pin::Input::VOLTAGE))};
+    BrownoutDetector detector;
+    uint32_t drops = 0;
+    Timer sampleTimer{[this] { sample(); }};
+    Timer recheckTimer{[this] { recheck(); }};
+
+public:
+    void begin()
+    {
+        sensor.begin();
+        sampleTimer.start(SAMPLE_INTERVAL_MS, SAMPLE_INTERVAL_MS);
+    }
+
+    void toJson(const JsonObject& to) const
+    {
+        to["volts"] = detector.getVolts();
+        to["nominalVolts"] = detector.getNominalVolts();
+        to["powerAware"] = detector.isSupplyValid();
+        to["drops"] = drops;
+    }
+
+private:
+    void sample()
+    {
+        switch (detector.sample(sensor.readVoltage(), SAMPLE_INTERVAL_MS))
+        {
+        case BrownoutDetector::Event::SUPPLY_VALID:
+            ESP_LOGI(LOG_TAG, "Supply at %.1f V, deferring light persistence", detector.getNominalVolts());
+            ConfigStore::get().setLightWriteDelay(FALLBACK_WRITE_DELAY_MS);
+            break;
+        case BrownoutDetector::Event::NO_SUPPLY:
+            ESP_LOGI(LOG_TAG, "No supply reading (%.1f V), checking every %u s", detector.getVolts(),
+                     static_cast<unsigned>(RECHECK_INTERVAL_MS / 1000));
+            sampleTimer.stop();
+            recheckTimer.start(RECHECK_INTERVAL_MS, RECHECK_INTERVAL_MS);
+            break;
+        case BrownoutDetector::Event::DROP:
+            ++drops;
+            ConfigStore::get().commitNow();
+            ESP_LOGW(LOG_TAG, "Supply dropping (%.1f V of %.1f V), configuration committed",
+                     detector.getVolts(), detector.getNominalVolts());
+            break;
+        case BrownoutDetector::Event::NONE:
+            break;
+        }
+    }
+
+    /**
+     * A supply showed up (divider fitted later, adapter plugged in next to USB): settle on it from scratch.
+     */
+    void recheck()
+    {
+        if (!detector.isPlausible(sensor.readVoltage())) return;
+        recheckTimer.stop();
+        detector = BrownoutDetector();
+        sampleTimer.start(SAMPLE_INTERVAL_MS, SAMPLE_INTERVAL_MS);
+    }
+};
@@ -1,31 +1,37 @@
 #pragma once
 
+#include <cstdint>
+
 template <typename T>
 class ThrottledValue
 {
     T lastValue;
-    unsigned long lastSendTime = 0;
-    const unsigned long throttleInterval;
+    uint64_t lastSendTime = 0;
+    const uint32_t throttleInterval;
 
 public:
-    explicit ThrottledValue(unsigned long intervalMs)
+    explicit ThrottledValue(const uint32_t intervalMs)
         : throttleInterval(intervalMs)
     {
     }
 
-    bool shouldSend(const unsigned long now, const T& newValue)
+    /**
+     * `shift` stretches the interval by a power of two, for slow links.
+     */
+    bool shouldSend(const uint64_t now, const T& newValue, const uint8_t shift = 0)
     {
-        if (newValue == lastValue || (now - lastSendTime) < throttleInterval)
+        if (newValue == lastValue || (now - lastSendTime) < getInterval(shift))
             return false;
         return true;
     }
 
-    void setLastSent(const unsigned long time, const T& value)
+    void setLastSent(const uint64_t time, const T& value)
     {
         this->lastValue = value;
         this->lastSendTime = time;
     }
 
     const T& getLastValue() const { return lastValue; }
-    unsigned long getLastSendTime() const { return lastSendTime; }
+    uint64_t getLastSendTime() const { return lastSendTime; }
+    uint32_t getInterval(const uint8_t shift = 0) const { return throttleInterval << shift; }
 };
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h> // NOLINT
+
+#include "inplace_function.hh"
+
+class TimerService;
+
+/**
+ * One-shot or periodic timer owned by the subsystem that uses it. The service links it into its wheel
+ * intrusively, so arming and cancelling never allocate. Callbacks run on the task calling
+ * TimerService::advance() (the main loop).
+ */
+class Timer
+{
+    friend class TimerService;
+
+public:
+    using Callback = InplaceFunction<void(), 32>;
+
+    explicit Timer(Callback callback): callback(std::move(callback))
+    {
+    }
+
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+    ~Timer();
+
+    /**
+     * (Re)arms the timer to fire after `delayMs`, then every `periodMs` if it is non-zero.
+     */
+    void start(uint32_t delayMs, uint32_t periodMs = 0);
+    void stop();
+
+    [[nodiscard]] bool isActive() const
+    {
+        return bucket != nullptr;
+    }
+
+private:
+    Callback callback;
+    Timer* prev = nullptr;
+    Timer* next = nullptr;
+    Timer** bucket = nullptr; // head of the list this timer is linked into, nullptr when idle
+    uint64_t deadline = 0;
+    uint32_t periodMs = 0;
+};
+
+/**
+ * Hierarchical timing wheel on the 64-bit esp_timer clock with 1 ms ticks: 4 levels of 64 slots cover
+ * about 4.6 hours directly, longer timers are re-cascaded. Insert and cancel are O(1), and advance()
+ * skips empty stretches using per-level occupancy bitmaps, so a long idle period costs a few steps.
+ */
+class TimerService
+{
+    static constexpr uint8_t LEVELS = 4;
+    static constexpr uint8_t SLOT_BITS = 6;
+    static constexpr uint8_t SLOTS = 1 << SLOT_BITS;
+    static constexpr uint64_t SLOT_MASK = SLOTS - 1;
+    static constexpr uint64_t MAX_SPAN = (1ULL << (SLOT_BITS * LEVELS)) - 1;
+    static constexpr uint32_t MAX_WAIT_MS = 60000;
+
+public:
+    using WakeHook = void (*)();
+
+private:
+    std::mutex mutex;
+    WakeHook wakeHook = nullptr;
+    uint64_t currentTick = nowMs();
+    Timer* wheel[LEVELS][SLOTS] = {};
+    uint64_t occupied[LEVELS] = {};
+    Timer* expired = nullptr;
+
+    TimerService() = default;
+
+public:
+    static TimerService& get()
+    {
+        static TimerService instance;
+        return instance;
+    }
+
+    /**
+     * Milliseconds since boot; unlike millis() it does not wrap after 49 days.
+     */
+    static uint64_t nowMs()
+    {
+        return static_cast<uint64_t>(esp_timer_get_time()) / 1000;
+    }
+
+    /**
+     * Called after a timer is armed, so the task sleeping until the previous deadline can recompute its wait.
+     */
+    void setWakeHook(const WakeHook hook)
+    {
+        wakeHook = hook;
+    }
+
+    void schedule(Timer& timer, const uint32_t delayMs, const uint32_t periodMs)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            unlink(timer);
+            timer.periodMs = periodMs;
+            timer.deadline = std::max(nowMs() + delayMs, currentTick + 1);
+            insert(timer);
+        }
+        if (wakeHook) wakeHook();
+    }
+
+    void cancel(Timer& timer)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        unlink(timer);
+    }
+
+    /**
+     * Fires every timer whose deadline has passed. Callbacks run without the lock held, so they may
+     * arm or stop any timer, including their own.
+     */
+    void advance()
+    {
+        const uint64_t target = nowMs();
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            if (Timer* timer = expired)
+            {
+                unlink(*timer);
+                if (timer->periodMs > 0)
+                {
+                    // Missed periods are skipped rather than replayed back to back.
+                    timer->deadline += timer->periodMs;
+                    if (timer->deadline <= target)
+                        timer->deadline += ((target - timer->deadline) / timer->periodMs + 1) * timer->periodMs;
+                    insert(*timer);
+                }
+                lock.unlock();
+                timer->callback();
+                lock.lock();
+                continue;
+            }
+            if (currentTick >= target) break;
+            currentTick = nextStop(target);
+            processTick();
+        }
+    }
+
+    [[nodiscard]] TickType_t ticksUntilNextDeadline()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (expired) return 0;
+        const uint64_t stop = nextStop(UINT64_MAX);
+        if (stop == UINT64_MAX) return portMAX_DELAY;
+        const uint64_t now = nowMs();
+        return stop <= now ? 0 : pdMS_TO_TICKS(static_cast<uint32_t>(std::min<uint64_t>(stop - now, MAX_WAIT_MS)));
+    }
+
+private:
+    static uint64_t span(const uint8_t level)
+    {
+        return 1ULL << (SLOT_BITS * level);
+    }
+
+    void insert(Timer& timer)
+    {
+        const uint64_t delta = timer.deadline > currentTick ? timer.deadline - currentTick : 0;
+        uint8_t level = 0;
+        while (level < LEVELS - 1 && delta >= span(level + 1)) ++level;
+        // Beyond the wheel's range, park in the last level and re-cascade when that slot comes round.
+        const uint64_t placement = currentTick + std::min(delta, MAX_SPAN);
+        link(timer, level, (placement >> (SLOT_BITS * level)) & SLOT_MASK);
+    }
+
+    void link(Timer& timer, const uint8_t level, const uint8_t slot)
+    {
+        Timer** head = &wheel[level][slot];
+        occupied[level] |= 1ULL << slot;
+        pushFront(timer, head);
+    }
+
+    static void pushFront(Timer& timer, Timer** head)
+    {
+        timer.bucket = head;
+        timer.prev = nullptr;
+        timer.next = *head;
+        if (*head) (*head)->prev = &timer;
+        *head = &timer;
+    }
+
+    void unlink(Timer& timer)
+    {
+        if (!timer.bucket) return;
+        if (timer.prev)
+            timer.prev->next = timer.next;
+        else
+            *timer.bucket = timer.next;
+        if (timer.next) timer.next->prev = timer.prev;
+
+        if (!*timer.bucket && timer.bucket != &expired)
+        {
+            const auto index = timer.bucket - &wheel[0][0];
+            occupied[index / SLOTS] &= ~(1ULL << (index % SLOTS));
+        }
+        timer.bucket = nullptr;
+        timer.prev = nullptr;
+        timer.next = nullptr;
+    }
+
+    /**
+     * Next tick (at most `limit`) where something can happen: an occupied level-0 slot, or the
+     * boundary at which the lowest occupied upper level cascades.
+     */
+    [[nodiscard]] uint64_t nextStop(const uint64_t limit) const
+    {
+        uint64_t stop = limit;
+        if (occupied[0])
+        {
+            const uint8_t base = (currentTick + 1) & SLOT_MASK;
+            const uint64_t rotated = base == 0 ? occupied[0] : (occupied[0] >> base) | (occupied[0] << (SLOTS - base));
+            stop = std::min(stop, currentTick + 1 + __builtin_ctzll(rotated));
+        }
+        for (uint8_t level = 1; level < LEVELS; ++level)
+        {
+            if (!occupied[level]) continue;
+            stop = std::min(stop, (currentTick / span(level) + 1) * span(level));
+            break;
+        }
+        return stop;
+    }
+
+    void processTick()
+    {
+        for (uint8_t level = LEVELS - 1; level > 0; --level)
+        {
+            if (currentTick & (span(level) - 1)) continue;
+            cascade(level, (currentTick >> (SLOT_BITS * level)) & SLOT_MASK);
+        }
+        const uint8_t slot = currentTick & SLOT_MASK;
+        while (Timer* timer = wheel[0][slot])
+        {
+            unlink(*timer);
+            pushFront(*timer, &expired);
+        }
+    }
+
+    void cascade(const uint8_t level, const uint8_t slot)
+    {
+        while (Timer* timer = wheel[level][slot])
+        {
+            unlink(*timer);
+            insert(*timer);
+        }
+    }
+};
+
+inline Timer::~Timer()
+{
+    if (isActive()) stop();
+}
+
+inline void Timer::start(const uint32_t delayMs, const uint32_t periodMs)
+{
+    TimerService::get().schedule(*this, delayMs, periodMs);
+}
+
+inline void Timer::stop()
+{
+    TimerService::get().cancel(*this);
+}
@@ -2,27 +2,22 @@
 
 #include "ESPAsyncWebServer.h"
 
-struct HttpCredentials
-{
-    static constexpr auto MAX_USERNAME_LENGTH = 32;
-    static constexpr auto MAX_PASSWORD_LENGTH = 32;
-
-    char username[MAX_USERNAME_LENGTH + 1] = {};
-    char password[MAX_PASSWORD_LENGTH + 1] = {};
-};
+#include "config_store.hh"
+#include "http_credentials.hh"
 
 class WebServerHandler
 {
-    static constexpr auto PREFERENCES_NAME = "http";
-    static constexpr auto PREFERENCES_USERNAME_KEY = "u";
-    static constexpr auto PREFERENCES_PASSWORD_KEY = "p";
-
     AsyncWebServer webServer = AsyncWebServer(80);
 
     AsyncAuthenticationMiddleware authMiddleware;
 
 public:
-    void begin(AsyncWebHandler* alexaHandler, AsyncWebHandler* ws, AsyncWebHandler* restHandler)
+    /**
+     * Registers the handlers and starts listening. Called once from setup(): the server listens on all
+     * interfaces, so it can start before Wi-Fi has an address and answers as soon as one is bound.
+     */
+    void begin(AsyncWebHandler* alexaHandler, AsyncWebHandler* ws, AsyncWebHandler* restHandler,
+               AsyncWebHandler* assetHandler)
     {
         webServer.addHandler(ws)
                  .addMiddleware(&authMiddleware);
@@ -33,9 +28,7 @@ public:
         webServer.addHandler(alexaHandler);
         // Alexa can't have authentication middleware
 
-        webServer.serveStatic("/", LittleFS, "/")
-                 .setDefaultFile("index.html")
-                 .setTryGzipFirst(true)
+        webServer.addHandler(assetHandler)
                  .addMiddleware(&authMiddleware);
 
         updateServerCredentials(getCredentials());
@@ -54,34 +47,13 @@ public:
 
     void updateCredentials(const HttpCredentials& credentials)
     {
-        Preferences prefs;
-        prefs.begin(PREFERENCES_NAME, false);
-        prefs.putString(PREFERENCES_USERNAME_KEY, credentials.username);
-        prefs.putString(PREFERENCES_PASSWORD_KEY, credentials.password);
-        prefs.end();
+        ConfigStore::get().setHttpCredentials(credentials);
         updateServerCredentials(credentials);
     }
 
     [[nodiscard]] static HttpCredentials getCredentials()
     {
-        HttpCredentials credentials;
-        if (Preferences prefs; prefs.begin(PREFERENCES_NAME, true))
-        {
-            strncpy(credentials.username, prefs.getString(PREFERENCES_USERNAME_KEY, "admin").c_str(),
-                    HttpCredentials::MAX_USERNAME_LENGTH);
-            strncpy(credentials.password, prefs.getString(PREFERENCES_PASSWORD_KEY, "").c_str(),
-                    HttpCredentials::MAX_PASSWORD_LENGTH);
-            prefs.end();
-            return credentials;
-        }
-        Preferences prefs;
-        prefs.begin(PREFERENCES_NAME, false);
-        strncpy(credentials.username, "admin", HttpCredentials::MAX_USERNAME_LENGTH);
-        strncpy(credentials.password, generateRandomPassword().c_str(), HttpCredentials::MAX_PASSWORD_LENGTH);
-        prefs.putString(PREFERENCES_USERNAME_KEY, credentials.username);
-        prefs.putString(PREFERENCES_PASSWORD_KEY, credentials.password);
-        prefs.end();
-        return credentials;
+        return ConfigStore::get().getHttpCredentials();
     }
 
 private:
@@ -94,16 +66,4 @@ private:
         authMiddleware.setAuthType(AUTH_BASIC);
         authMiddleware.generateHash();
     }
-
-    [[nodiscard]] static String generateRandomPassword()
-    {
-        const auto v1 = random(100000, 999999);
-        const auto v2 = random(100000, 999999);
-        String password = String(v1) + "A-b" + String(v2);
-        if (password.length() > HttpCredentials::MAX_PASSWORD_LENGTH)
-        {
-            password = password.substring(0, HttpCredentials::MAX_PASSWORD_LENGTH);
-        }
-        return password;
-    }
 };
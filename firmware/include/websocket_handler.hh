@@ -1,8 +1,16 @@
 #pragma once
 
+#include <atomic>
+#include <mutex>
+
+#include "adaptive_rate.hh"
 #include "wifi_model.hh"
 #include "ble_manager.hh"
 #include "throttled_value.hh"
+#include "timer_service.hh"
+#include "control_command.hh"
+#include "output_command.hh"
+#include "power_manager.hh"
 
 enum class WebSocketMessageType : uint8_t
 {
@@ -16,43 +24,101 @@ enum class WebSocketMessageType : uint8_t
     ON_WIFI_DETAILS,
     ON_OTA_PROGRESS,
     ON_ALEXA_INTEGRATION_SETTINGS,
+    ON_WIFI_SCAN_RESULT,
+    ON_POWER_PROFILE,
 };
 
 class WebSocketHandler
 {
     static constexpr auto LOG_TAG = "WebSocketHandler";
+    static constexpr uint32_t BROADCAST_INTERVAL_MS = 50;
+    static constexpr uint8_t MAX_CLIENTS = DEFAULT_MAX_WS_CLIENTS;
+    static constexpr uint32_t PING_INTERVAL_MS = 2000;
+    static constexpr uint32_t PING_TIMEOUT_MS = 10000; // an unanswered ping is given up after this
+    static constexpr uint32_t RATE_UPDATE_INTERVAL_MS = 1000;
+    static constexpr size_t MAX_QUEUED_MESSAGES = 8; // beyond this, updates for a client are held back
+    // Differs from the library's keep-alive payload, whose pongs are not reported.
+    static constexpr uint8_t PING_PAYLOAD[] = {'r', 't', 't'};
 
     Output& output;
     OtaHandler& otaHandler;
     WiFiManager& wifiManager;
-    WebServerHandler& webServerHandler;
-    AlexaIntegration& alexaIntegration;
     BleManager& bleManager;
+    PowerManager& powerManager;
+    OutputCommandQueue& outputCommands;
+    ControlCommandQueue& controlCommands;
 
     AsyncWebSocket ws = AsyncWebSocket("/ws");
 
-    ThrottledValue<std::array<LightState, 4>> outputThrottle{100};
-    ThrottledValue<BleStatus> bleStatusThrottle{100};
-    ThrottledValue<std::array<char, DEVICE_NAME_TOTAL_LENGTH>> deviceNameThrottle{100};
-    ThrottledValue<OtaState> otaStateThrottle{100};
-    ThrottledValue<uint32_t> heapInfoThrottle{500};
+    /**
+     * What the periodic updates carry, read once per broadcast for all clients.
+     */
+    struct Snapshot
+    {
+        std::array<LightState, 4> output;
+        BleStatus bleStatus;
+        std::array<char, DEVICE_NAME_TOTAL_LENGTH> deviceName;
+        OtaState otaState;
+        uint32_t freeHeap;
+    };
+
+    /**
+     * Send state of one client. Each client has its own throttles, stretched by AdaptiveRate from the station
+     * RSSI, the ping round trip and its send queue, so a slow client gets fewer, coalesced updates without
+     * slowing down the others. `id` and `client` are claimed on the AsyncTCP task when the client connects and
+     * released when the library destroys it, both under `linksMutex`; the ping timing is handed over through
+     * atomics. Everything else belongs to the main loop (and is read for metrics).
+     */
+    struct ClientLink
+    {
+        std::atomic<uint32_t> id{0}; // 0: free
+        AsyncWebSocketClient* client = nullptr; // only valid while `linksMutex` is held
+        std::atomic<uint32_t> pingSentMs{0}; // 0: no ping outstanding
+        std::atomic<uint32_t> rttMs{0}; // last measured round trip
+        std::atomic<uint32_t> ip{0};
+
+        uint32_t servedId = 0; // client the state below belongs to
+        AdaptiveRate rate;
+        uint64_t lastRateUpdateMs = 0;
+        uint64_t lastPingMs = 0;
+        size_t queued = 0;
+        uint32_t sent = 0;
+        uint32_t held = 0; // updates postponed because the client's queue was full
+
+        ThrottledValue<std::array<LightState, 4>> outputThrottle{100};
+        ThrottledValue<BleStatus> bleStatusThrottle{100};
+        ThrottledValue<std::array<char, DEVICE_NAME_TOTAL_LENGTH>> deviceNameThrottle{100};
+        ThrottledValue<OtaState> otaStateThrottle{100};
+        ThrottledValue<uint32_t> heapInfoThrottle{500};
+    };
+
+    ClientLink links[MAX_CLIENTS];
+    // The library destroys a client on the AsyncTCP task (or in cleanupClients) and reports WS_EVT_DISCONNECT from
+    // its destructor. That event waits for this lock, so a client is never freed while the main loop serves it.
+    // Never call into `ws` while holding it: the library raises events under its own lock.
+    mutable std::mutex linksMutex;
+
+    // Runs only while clients are connected; the first connection arms it.
+    Timer broadcastTimer{[this] { broadcast(); }};
 
 public:
     WebSocketHandler(
         Output& output,
         OtaHandler& otaHandler,
         WiFiManager& wifiManager,
-        WebServerHandler& webServerHandler,
-        AlexaIntegration& alexaIntegration,
-        BleManager& bleManager
+        BleManager& bleManager,
+        PowerManager& powerManager,
+        OutputCommandQueue& outputCommands,
+        ControlCommandQueue& controlCommands
     )
         :
         output(output),
         otaHandler(otaHandler),
         wifiManager(wifiManager),
-        webServerHandler(webServerHandler),
-        alexaIntegration(alexaIntegration),
-        bleManager(bleManager)
+        bleManager(bleManager),
+        powerManager(powerManager),
+        outputCommands(outputCommands),
+        controlCommands(controlCommands)
     {
         ws.onEvent([this](AsyncWebSocket* server, AsyncWebSocketClient* client,
                           const AwsEventType type, void* arg, const uint8_t* data,
@@ -60,20 +126,174 @@ public:
         {
             this->handleWebSocketEvent(server, client, type, arg, data, len);
         });
+        // Scan updates come from the scan task; they are rare, so they go out right away, unthrottled.
+        wifiManager.scanStatusChanged().connect([this](const WifiScanStatus status)
+        {
+            sendMessage(WiFiScanStatusMessage(status));
+        });
+        wifiManager.scanResultChanged().connect([this](const WiFiScanResult& result)
+        {
+            sendMessage(WiFiScanResultMessage(result));
+        });
+        powerManager.changed().connect([this](const PowerState& state)
+        {
+            sendMessage(PowerStateMessage(state));
+        });
     }
 
-    void handle(const unsigned long now)
+    AsyncWebHandler* getAsyncWebHandler()
     {
-        ws.cleanupClients();
-        sendAllMessages(now);
+        return &ws;
     }
 
-    AsyncWebHandler* getAsyncWebHandler()
+    /**
+     * Per-client adaptation: level (each one doubles the intervals), averaged round trip, queued messages,
+     * updates sent and held back, and the current output and heap intervals.
+     */
+    void metricsToJson(const JsonObject& to) const
     {
-        return &ws;
+        to["clients"] = ws.count();
+        std::lock_guard<std::mutex> lock(linksMutex);
+        const auto clients = to["links"].to<JsonArray>();
+        for (const auto& link : links)
+        {
+            const uint32_t id = link.id.load();
+            if (id == 0 || link.servedId != id) continue;
+            const uint8_t level = link.rate.getLevel();
+            const auto client = clients.add<JsonObject>();
+            client["id"] = id;
+            client["ip"] = IPAddress(link.ip.load()).toString();
+            client["level"] = level;
+            client["rttMs"] = link.rate.getRttMs();
+            client["queued"] = link.queued;
+            client["sent"] = link.sent;
+            client["held"] = link.held;
+            client["outputIntervalMs"] = link.outputThrottle.getInterval(level);
+            client["heapIntervalMs"] = link.heapInfoThrottle.getInterval(level);
+        }
     }
 
 private:
+    void broadcast()
+    {
+        ws.cleanupClients();
+        const uint64_t now = TimerService::nowMs();
+        const Snapshot snapshot = takeSnapshot();
+        const int8_t rssi = WiFi.RSSI();
+        {
+            std::lock_guard<std::mutex> lock(linksMutex);
+            for (auto& link : links)
+                serve(link, snapshot, now, rssi);
+        }
+        if (ws.count() == 0)
+            broadcastTimer.stop();
+    }
+
+    /**
+     * Brings one client up to date: a new client gets the full state, a known one what its throttles allow.
+     * Called with `linksMutex` held, which keeps `link.client` alive.
+     */
+    void serve(ClientLink& link, const Snapshot& snapshot, const uint64_t now, const int8_t rssi)
+    {
+        const uint32_t id = link.id.load();
+        AsyncWebSocketClient* client = link.client;
+        if (id == 0 || !client || client->status() != WS_CONNECTED) return; // free, or closing
+
+        if (link.servedId != id)
+        {
+            link.servedId = id;
+            link.rate = AdaptiveRate();
+            link.lastRateUpdateMs = now;
+            link.lastPingMs = 0;
+            link.queued = 0;
+            link.sent = 0;
+            link.held = 0;
+            sendAllMessages(link, client, snapshot, now, true);
+            sendPowerStateMessage(client);
+            return;
+        }
+
+        measureLink(link, client, now, rssi);
+        sendAllMessages(link, client, snapshot, now, false);
+    }
+
+    /**
+     * Pings the client for its round trip and re-evaluates its rate about once a second. A pong still
+     * outstanding counts as a round trip of at least the time waited so far.
+     */
+    void measureLink(ClientLink& link, AsyncWebSocketClient* client, const uint64_t now, const int8_t rssi)
+    {
+        if (now - link.lastRateUpdateMs < RATE_UPDATE_INTERVAL_MS) return;
+        link.lastRateUpdateMs = now;
+
+        const auto nowMs = static_cast<uint32_t>(now);
+        uint32_t rttMs = link.rttMs.load();
+        if (const uint32_t pingSentMs = link.pingSentMs.load())
+        {
+            rttMs = std::max(rttMs, nowMs - pingSentMs);
+            if (nowMs - pingSentMs >= PING_TIMEOUT_MS)
+                link.pingSentMs = 0;
+        }
+        else if (now - link.lastPingMs >= PING_INTERVAL_MS)
+        {
+            link.lastPingMs = now;
+            link.pingSentMs = nowMs;
+            client->ping(PING_PAYLOAD, sizeof(PING_PAYLOAD));
+        }
+        link.queued = client->queueLen();
+        link.rate.update(rssi, rttMs, link.queued);
+    }
+
+    /**
+     * AsyncTCP task: a new client takes a free slot; the main loop sends it the full state on its next round.
+     */
+    void claimLink(AsyncWebSocketClient* client)
+    {
+        {
+            std::lock_guard<std::mutex> lock(linksMutex);
+            for (auto& link : links)
+            {
+                if (link.id.load() != 0) continue;
+                link.pingSentMs = 0;
+                link.rttMs = 0;
+                link.ip = static_cast<uint32_t>(client->remoteIP());
+                link.servedId = 0;
+                link.client = client;
+                link.id = client->id();
+                return;
+            }
+        }
+        ESP_LOGW(LOG_TAG, "No free slot for WebSocket client %u, closing it", client->id());
+        client->close();
+    }
+
+    /**
+     * Raised from the client's destructor: frees its slot before the memory goes. Waits for a running broadcast.
+     */
+    void releaseLink(const AsyncWebSocketClient* client)
+    {
+        std::lock_guard<std::mutex> lock(linksMutex);
+        for (auto& link : links)
+        {
+            if (link.client != client) continue;
+            link.client = nullptr;
+            link.servedId = 0;
+            link.id = 0;
+            return;
+        }
+    }
+
+    void handlePong(const AsyncWebSocketClient* client)
+    {
+        for (auto& link : links)
+        {
+            if (link.id.load() != client->id()) continue;
+            if (const uint32_t pingSentMs = link.pingSentMs.exchange(0))
+                link.rttMs = static_cast<uint32_t>(TimerService::nowMs()) - pingSentMs;
+            return;
+        }
+    }
+
     void handleWebSocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client,
                               const AwsEventType type, void* arg, const uint8_t* data,
                               const size_t len)
@@ -82,13 +302,17 @@ private:
         {
         case WS_EVT_CONNECT:
             ESP_LOGD(LOG_TAG, "WebSocket client connected: %s", client->remoteIP().toString().c_str());
-            sendAllMessages(millis(), client);
+            claimLink(client);
+            // The first round sends the full state to the new client.
+            broadcastTimer.start(0, BROADCAST_INTERVAL_MS);
             break;
         case WS_EVT_DISCONNECT:
             ESP_LOGD(LOG_TAG, "WebSocket client disconnected: %s", client->remoteIP().toString().c_str());
+            releaseLink(client);
             break;
         case WS_EVT_PONG:
             ESP_LOGD(LOG_TAG, "WebSocket pong received from client: %s", client->remoteIP().toString().c_str());
+            handlePong(client);
             break;
         case WS_EVT_ERROR:
             ESP_LOGE(LOG_TAG, "WebSocket error: %s", client->remoteIP().toString().c_str());
@@ -139,7 +363,7 @@ private:
         }
 
         const uint8_t messageTypeRaw = data[0];
-        if (messageTypeRaw > static_cast<uint8_t>(WebSocketMessageType::ON_ALEXA_INTEGRATION_SETTINGS))
+        if (messageTypeRaw > static_cast<uint8_t>(WebSocketMessageType::ON_POWER_PROFILE))
         {
             ESP_LOGD(LOG_TAG, "Received unknown WebSocket message type: %d", messageTypeRaw);
             return;
@@ -201,6 +425,14 @@ private:
             handleAlexaIntegrationSettingsMessage(client, data, len);
             break;
 
+        case WebSocketMessageType::ON_WIFI_SCAN_RESULT:
+            handleWiFiScanResultMessage(client);
+            break;
+
+        case WebSocketMessageType::ON_POWER_PROFILE:
+            handlePowerProfileMessage(client, data, len);
+            break;
+
         default:
             client->text("Unknown message type");
             break;
@@ -211,21 +443,24 @@ private:
     {
         if (len < sizeof(ColorMessage)) return;
         const auto* message = reinterpret_cast<const ColorMessage*>(data);
-        output.setState(message->values);
+        powerManager.streamActivity();
+        outputCommands.post(OutputCommands::SetState{message->values});
     }
 
     void handleHttpCredentialsMessage(AsyncWebSocketClient* client, const uint8_t* data, const size_t len) const
     {
         if (len < sizeof(HttpCredentialsMessage)) return;
         const auto* message = reinterpret_cast<const HttpCredentialsMessage*>(data);
-        webServerHandler.updateCredentials(message->credentials);
+        controlCommands.post(ControlCommands::SetHttpCredentials{message->credentials});
     }
 
     void handleDeviceNameMessage(AsyncWebSocketClient* client, const uint8_t* data, const size_t len) const
     {
         if (len < sizeof(DeviceNameMessage)) return;
         const auto* message = reinterpret_cast<const DeviceNameMessage*>(data);
-        wifiManager.setDeviceName(message->deviceName);
+        ControlCommands::SetDeviceName command = {};
+        strncpy(command.name, message->deviceName, DEVICE_NAME_MAX_LENGTH);
+        controlCommands.post(command);
     }
 
     static void handleHeapMessage(AsyncWebSocketClient* client)
@@ -245,7 +480,7 @@ private:
             async_call([this]()
             {
                 bleManager.start();
-            }, 4096, 0);
+            });
             break;
         case BleStatus::OFF:
             async_call([client,this]()
@@ -253,7 +488,7 @@ private:
                 client->close();
                 delay(100);
                 bleManager.stop();
-            }, 2048, 0);
+            });
             break;
         default:
             break;
@@ -264,12 +499,30 @@ private:
     {
         if (len < sizeof(WiFiConnectionDetailsMessage)) return;
         const auto* message = reinterpret_cast<const WiFiConnectionDetailsMessage*>(data);
-        wifiManager.connect(message->details);
+        controlCommands.post(ControlCommands::ConnectWiFi{message->details});
     }
 
     void handleWiFiScanStatusMessage(AsyncWebSocketClient* client) const
     {
-        wifiManager.triggerScan();
+        controlCommands.post(ControlCommands::TriggerWiFiScan{});
+    }
+
+    /**
+     * Sends the last scan result to the requesting client, e.g. after a page load.
+     */
+    void handleWiFiScanResultMessage(AsyncWebSocketClient* client) const
+    {
+        const WiFiScanResultMessage message(wifiManager.getScanResult());
+        client->binary(reinterpret_cast<const uint8_t*>(&message), sizeof(message));
+    }
+
+    /**
+     * Selects a profile: the type byte followed by the PowerProfile byte. The new state is pushed to all clients.
+     */
+    void handlePowerProfileMessage(AsyncWebSocketClient* client, const uint8_t* data, const size_t len) const
+    {
+        if (len < sizeof(Message) + sizeof(PowerProfile) || !PowerState::isValid(data[1])) return;
+        controlCommands.post(ControlCommands::SetPowerProfile{static_cast<PowerProfile>(data[1])});
     }
 
     static void handleWiFiDetailsMessage(AsyncWebSocketClient* client, const uint8_t* data, const size_t len)
@@ -287,70 +540,71 @@ private:
     {
         if (len < sizeof(AlexaIntegrationSettingsMessage)) return;
         const auto* message = reinterpret_cast<const AlexaIntegrationSettingsMessage*>(data);
-        alexaIntegration.applySettings(message->settings);
+        controlCommands.post(ControlCommands::ApplyAlexaSettings{message->settings});
     }
 
+    /**
+     * Sends `state` to one client when its throttle allows, or unconditionally with `force`. While the client's
+     * queue is backed up the update is held back; the throttle keeps the old value, so the latest state goes out
+     * once the queue drains.
+     */
     template <typename TState, typename TMessage, typename TThrottle>
-    void sendThrottledMessage(const TState& state, TThrottle& throttle, const unsigned long now,
-                              AsyncWebSocketClient* client = nullptr)
+    static void sendThrottledMessage(ClientLink& link, AsyncWebSocketClient* client, const TState& state,
+                                     TThrottle& throttle, const uint64_t now, const bool force)
     {
-        if (!throttle.shouldSend(now, state) && !client)
+        if (!force && !throttle.shouldSend(now, state, link.rate.getLevel()))
             return;
-
-        const TMessage message(state);
-        const auto data = reinterpret_cast<const uint8_t*>(&message);
-        constexpr size_t len = sizeof(TMessage);
-
-        if (client)
+        if (!force && client->queueLen() >= MAX_QUEUED_MESSAGES)
         {
-            client->binary(data, len);
+            ++link.held;
+            return;
         }
-        else if (AsyncWebSocket::SendStatus::ENQUEUED == ws.binaryAll(data, len))
+
+        const TMessage message(state);
+        if (client->binary(reinterpret_cast<const uint8_t*>(&message), sizeof(TMessage)))
         {
             throttle.setLastSent(now, state);
+            ++link.sent;
         }
     }
 
-    void sendAllMessages(const unsigned long now, AsyncWebSocketClient* client = nullptr)
+    template <typename TMessage>
+    void sendMessage(const TMessage& message)
     {
-        sendOutputColorMessage(now, client);
-        sendBleStatusMessage(now, client);
-        sendDeviceNameMessage(now, client);
-        sendOtaProgressMessage(now, client);
-        sendHeapInfoMessage(now, client);
+        if (ws.count() > 0)
+            ws.binaryAll(reinterpret_cast<const uint8_t*>(&message), sizeof(TMessage));
     }
 
-    void sendOutputColorMessage(const unsigned long now, AsyncWebSocketClient* client = nullptr)
+    [[nodiscard]] Snapshot takeSnapshot()
     {
-        sendThrottledMessage<std::array<LightState, 4>, ColorMessage>(
-            output.getState(), outputThrottle, now, client);
+        Snapshot snapshot = {};
+        snapshot.output = output.getState();
+        snapshot.bleStatus = bleManager.getStatus();
+        strncpy(snapshot.deviceName.data(), wifiManager.getDeviceName(), DEVICE_NAME_MAX_LENGTH);
+        snapshot.otaState = otaHandler.getState();
+        snapshot.freeHeap = ESP.getFreeHeap();
+        return snapshot;
     }
 
-    void sendBleStatusMessage(const unsigned long now, AsyncWebSocketClient* client = nullptr)
+    static void sendAllMessages(ClientLink& link, AsyncWebSocketClient* client, const Snapshot& snapshot,
+                                const uint64_t now, const bool force)
     {
+        sendThrottledMessage<std::array<LightState, 4>, ColorMessage>(
+            link, client, snapshot.output, link.outputThrottle, now, force);
         sendThrottledMessage<BleStatus, BleStatusMessage>(
-            bleManager.getStatus(), bleStatusThrottle, now, client);
-    }
-
-    void sendDeviceNameMessage(const unsigned long now, AsyncWebSocketClient* client = nullptr)
-    {
-        std::array<char, DEVICE_NAME_TOTAL_LENGTH> deviceName = {};
-        strncpy(deviceName.data(), wifiManager.getDeviceName(), DEVICE_NAME_MAX_LENGTH);
+            link, client, snapshot.bleStatus, link.bleStatusThrottle, now, force);
         sendThrottledMessage<std::array<char, DEVICE_NAME_TOTAL_LENGTH>, DeviceNameMessage>(
-            deviceName, deviceNameThrottle, now, client);
-    }
-
-    void sendOtaProgressMessage(const unsigned long now, AsyncWebSocketClient* client = nullptr)
-    {
+            link, client, snapshot.deviceName, link.deviceNameThrottle, now, force);
         sendThrottledMessage<OtaState, OtaProgressMessage>(
-            otaHandler.getState(), otaStateThrottle, now, client);
+            link, client, snapshot.otaState, link.otaStateThrottle, now, force);
+        sendThrottledMessage<uint32_t, HeapMessage>(
+            link, client, snapshot.freeHeap, link.heapInfoThrottle, now, force);
     }
 
-    void sendHeapInfoMessage(const unsigned long now, AsyncWebSocketClient* client = nullptr)
+    void sendPowerStateMessage(AsyncWebSocketClient* client) const
     {
-        const auto freeHeap = ESP.getFreeHeap();
-        sendThrottledMessage<uint32_t, HeapMessage>(
-            freeHeap, heapInfoThrottle, now, client);
+        const PowerStateMessage message(powerManager.getState());
+        client->binary(reinterpret_cast<const uint8_t*>(&message), sizeof(message));
     }
 
 #pragma pack(push, 1)
@@ -443,6 +697,36 @@ private:
         }
     };
 
+    struct WiFiScanStatusMessage : Message
+    {
+        WifiScanStatus status;
+
+        explicit WiFiScanStatusMessage(const WifiScanStatus status)
+            : Message(WebSocketMessageType::ON_WIFI_SCAN_STATUS), status(status)
+        {
+        }
+    };
+
+    struct WiFiScanResultMessage : Message
+    {
+        WiFiScanResult result;
+
+        explicit WiFiScanResultMessage(const WiFiScanResult& result)
+            : Message(WebSocketMessageType::ON_WIFI_SCAN_RESULT), result(result)
+        {
+        }
+    };
+
+    struct PowerStateMessage : Message
+    {
+        PowerState state;
+
+        explicit PowerStateMessage(const PowerState& state)
+            : Message(WebSocketMessageType::ON_POWER_PROFILE), state(state)
+        {
+        }
+    };
+
     struct HeapMessage : Message
     {
         uint32_t freeHeap;
@@ -1,57 +1,136 @@
 #pragma once
 
 #include <WiFi.h>
+#include <esp_system.h>
+#include <esp_timer.h>
 #include <esp_wpa2.h>
-#include <Preferences.h>
 #include <cstring>
 #include <atomic>
 #include <mutex>
 
 #include "AsyncJson.h"
+#include "config_store.hh"
+#include "reconnect_backoff.hh"
+#include "signal.hh"
+#include "timer_service.hh"
 #include "wifi_model.hh"
-
-#define DEVICE_NAME_MAX_LENGTH 28
-#define DEVICE_NAME_TOTAL_LENGTH (DEVICE_NAME_MAX_LENGTH + 1)
-#define DEVICE_BASE_NAME "rgbw-ctrl-"
+#include "wifi_scan_collector.hh"
 
 class WiFiManager
 {
     static constexpr auto LOG_TAG = "WiFiManager";
-    static constexpr auto PREFERENCES_NAME = "wifi-config";
 
     std::atomic<WiFiStatus> wifiStatus = WiFiStatus::DISCONNECTED;
     std::atomic<WifiScanStatus> scanStatus = WifiScanStatus::COMPLETED;
 
+    static constexpr uint32_t SCAN_TIMEOUT_MS = 15000;
+
+    // The queue only wakes the scan task; what to scan for is in the flags, so a user scan queued behind a
+    // roaming scan (or the other way round) is neither rejected nor merged into the other one.
     QueueHandle_t wifiScanQueue = nullptr;
+    std::atomic<bool> userScanPending{false};
+    std::atomic<bool> roamScanPending{false};
+    TaskHandle_t scanTask = nullptr; // notified by SCAN_DONE
+    WiFiScanCollector scanCollector; // only touched by the scan task
     WiFiScanResult scanResult;
+    uint32_t lastScanUs = 0;
 
-    std::function<void(WiFiDetails)> detailsChanged;
-    std::function<void(WiFiScanResult)> scanResultChanged;
-    std::function<void(WifiScanStatus)> scanStatusChanged;
-    std::function<void(WiFiStatus)> statusChanged;
-    std::function<void(char*)> deviceNameChanged;
-    std::function<void()> gotIpChanged;
+    // Emitted from the Wi-Fi event task, the scan task or the command handler.
+    Signal<void(const WiFiDetails&)> detailsChangedSignal;
+    Signal<void(const WiFiScanResult&)> scanResultChangedSignal;
+    Signal<void(WifiScanStatus)> scanStatusChangedSignal;
+    Signal<void(WiFiStatus)> statusChangedSignal;
+    Signal<void(const char*)> deviceNameChangedSignal;
+    Signal<void()> gotIpSignal;
 
     char deviceName[DEVICE_NAME_TOTAL_LENGTH] = {};
 
+    // Connection timing, written from connect() and the Wi-Fi event task; only read for metrics.
+    int64_t attemptStartUs = 0;
+    int64_t associatedUs = 0; // set between association and the address of the current attempt
+    uint32_t connectUs = 0;
+    uint32_t dhcpUs = 0;
+    enum class AttemptKind : uint8_t
+    {
+        SCAN, // the driver scans for the SSID
+        FAST_CONNECT, // straight to the access point cached for the primary
+        ROAM // straight to a stronger access point found by a roaming scan
+    };
+
+    AttemptKind attemptKind = AttemptKind::SCAN;
+    bool lastConnectFast = false;
+    uint32_t fastConnects = 0;
+    uint32_t fastConnectFallbacks = 0;
+    uint32_t roamConnects = 0;
+    uint32_t roamFallbacks = 0;
+
+    static constexpr uint32_t CONNECT_TIMEOUT_MS = 20000;
+    static constexpr uint8_t ATTEMPTS_PER_NETWORK = 2; // before moving on to the next stored network
+    static constexpr uint32_t QUALITY_INTERVAL_MS = 10000;
+    static constexpr float RSSI_AVERAGE_ALPHA = 0.2f;
+    static constexpr int8_t ROAM_RSSI_THRESHOLD = -75; // averaged RSSI below which a roaming scan runs
+    static constexpr int8_t ROAM_HYSTERESIS_DB = 8; // how much stronger another access point must be
+    static constexpr uint32_t ROAM_SCAN_INTERVAL_MS = 120000;
+
+    enum class LinkState : uint8_t
+    {
+        IDLE, // no stored network, or waiting for connect()
+        CONNECTING,
+        CONNECTED,
+        BACKOFF // waiting for the next attempt
+    };
+
+    // Reconnect state machine: Wi-Fi events move it on the event task, the timers on the main loop.
+    mutable std::mutex linkMutex;
+    LinkState linkState = LinkState::IDLE;
+    ReconnectBackoff backoff;
+    uint8_t networkIndex = 0; // stored network of the current attempt, 0 is the primary
+    uint8_t attemptsOnNetwork = 0;
+    uint8_t lastDisconnectReason = 0;
+    uint32_t disconnects = 0; // connection losses, not failed attempts
+    uint32_t reconnects = 0;
+    uint32_t roams = 0;
+    uint32_t roamScans = 0;
+    uint64_t connectedSinceMs = 0;
+    float rssiAverage = 0.0f;
+    int8_t rssiMin = 0;
+    uint64_t lastRoamScanMs = 0;
+    Timer reconnectTimer{[this] { reconnect(); }};
+    Timer attemptTimer{[this] { attemptTimedOut(); }};
+    Timer qualityTimer{[this] { sampleQuality(); }};
+
 public:
     void begin()
     {
         WiFi.persistent(false);
+        WiFi.setAutoReconnect(false); // the reconnect state machine below takes over
         WiFi.mode(WIFI_MODE_STA); // NOLINT
         WiFi.onEvent([this](const WiFiEvent_t event, const WiFiEventInfo_t& info)
         {
             switch (event)
             {
             case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+                associatedUs = esp_timer_get_time();
+                connectUs = static_cast<uint32_t>(associatedUs - attemptStartUs);
                 setStatus(WiFiStatus::CONNECTED_NO_IP);
-                ESP_LOGI(LOG_TAG, "Connected to AP"); // NOLINT
+                ESP_LOGI(LOG_TAG, "Connected to AP in %u ms%s", connectUs / 1000, // NOLINT
+                         attemptKind == AttemptKind::FAST_CONNECT ? " (fast connect)"
+                         : attemptKind == AttemptKind::ROAM ? " (roam)" : "");
                 break;
 
             case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+                if (associatedUs)
+                    dhcpUs = static_cast<uint32_t>(esp_timer_get_time() - associatedUs);
+                associatedUs = 0;
                 ESP_LOGI(LOG_TAG, "Got IP: %s", WiFi.localIP().toString().c_str()); // NOLINT
+                linkEstablished();
                 setStatus(WiFiStatus::CONNECTED);
-                if (gotIpChanged) gotIpChanged();
+                gotIpSignal.emit();
+                break;
+
+            case ARDUINO_EVENT_WIFI_SCAN_DONE:
+                if (scanTask)
+                    xTaskNotifyGive(scanTask);
                 break;
 
             case ARDUINO_EVENT_WIFI_STA_LOST_IP:
@@ -61,6 +140,10 @@ public:
 
             case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
                 ESP_LOGW(LOG_TAG, "Disconnected from AP. Reason: %d", info.wifi_sta_disconnected.reason); // NOLINT
+                // ASSOC_LEAVE is our own disconnect() ahead of a new attempt.
+                if (info.wifi_sta_disconnected.reason != WIFI_REASON_ASSOC_LEAVE
+                    && linkLost(info.wifi_sta_disconnected.reason))
+                    break;
                 switch (info.wifi_sta_disconnected.reason)
                 {
                 case WIFI_REASON_AUTH_FAIL:
@@ -81,16 +164,17 @@ public:
             }
         });
         startTasks();
+        qualityTimer.start(QUALITY_INTERVAL_MS, QUALITY_INTERVAL_MS);
     }
 
     bool triggerScan() // NOLINT
     {
-        constexpr auto event = WifiScanEvent::StartScan;
-        if (const BaseType_t success = xQueueSend(wifiScanQueue, &event, 0); success == errQUEUE_FULL)
+        if (userScanPending.exchange(true))
         {
-            ESP_LOGW(LOG_TAG, "Scan request ignored: already in progress or queued");
+            ESP_LOGW(LOG_TAG, "Scan request ignored: already queued");
             return false;
         }
+        wakeScanTask();
         return true;
     }
 
@@ -148,34 +232,34 @@ public:
         return scanResult;
     }
 
-    void setDetailsChangedCallback(std::function<void(WiFiDetails)> cb)
+    Signal<void(const WiFiDetails&)>& detailsChanged()
     {
-        detailsChanged = std::move(cb);
+        return detailsChangedSignal;
     }
 
-    void setScanResultChangedCallback(std::function<void(WiFiScanResult)> cb)
+    Signal<void(const WiFiScanResult&)>& scanResultChanged()
     {
-        scanResultChanged = std::move(cb);
+        return scanResultChangedSignal;
     }
 
-    void setScanStatusChangedCallback(std::function<void(WifiScanStatus)> cb)
+    Signal<void(WifiScanStatus)>& scanStatusChanged()
     {
-        scanStatusChanged = std::move(cb);
+        return scanStatusChangedSignal;
     }
 
-    void setStatusChangedCallback(std::function<void(WiFiStatus)> cb)
+    Signal<void(WiFiStatus)>& statusChanged()
     {
-        statusChanged = std::move(cb);
+        return statusChangedSignal;
     }
 
-    void setDeviceNameChangedCallback(std::function<void(char*)> cb)
+    Signal<void(const char*)>& deviceNameChanged()
     {
-        deviceNameChanged = std::move(cb);
+        return deviceNameChangedSignal;
     }
 
-    void setGotIpCallback(std::function<void()> cb)
+    Signal<void()>& gotIp()
     {
-        gotIpChanged = std::move(cb);
+        return gotIpSignal;
     }
 
     const char* getDeviceName()
@@ -201,19 +285,13 @@ public:
         if (std::strncmp(deviceName, safeName, DEVICE_NAME_MAX_LENGTH) == 0)
             return;
 
-        Preferences prefs;
-        prefs.begin(PREFERENCES_NAME, false);
-        prefs.putString("deviceName", safeName);
-        prefs.end();
+        ConfigStore::get().setDeviceName(safeName);
 
         deviceName[0] = '\0'; // Invalidate cached name
         WiFiClass::setHostname(safeName);
         WiFi.reconnect();
 
-        if (deviceNameChanged)
-        {
-            deviceNameChanged(safeName);
-        }
+        deviceNameChangedSignal.emit(safeName);
     }
 
     void toJson(const JsonObject& to) const
@@ -222,50 +300,48 @@ public:
         to["status"] = getStatusString();
     }
 
+    /**
+     * Timing of the last connection: `connectUs` covers scan, association and authentication (the driver
+     * reports them as one event), `dhcpUs` the address assignment after that.
+     */
+    void metricsToJson(const JsonObject& to) const
+    {
+        to["fastConnect"] = lastConnectFast;
+        to["fastConnects"] = fastConnects;
+        to["fastConnectFallbacks"] = fastConnectFallbacks;
+        to["staticIp"] = ConfigStore::get().getWiFiStaticIp().enabled;
+        to["connectUs"] = connectUs;
+        to["dhcpUs"] = dhcpUs;
+        to["lastScanUs"] = lastScanUs;
+
+        std::lock_guard<std::mutex> lock(linkMutex);
+        to["state"] = linkStateString(linkState);
+        to["network"] = networkIndex;
+        to["knownNetworks"] = ConfigStore::get().getKnownWiFiNetworkCount();
+        to["connectedForMs"] = linkState == LinkState::CONNECTED ? TimerService::nowMs() - connectedSinceMs : 0;
+        to["rssiAverage"] = rssiAverage;
+        to["rssiMin"] = rssiMin;
+        to["disconnects"] = disconnects;
+        to["lastDisconnectReason"] = lastDisconnectReason;
+        to["reconnects"] = reconnects;
+        to["failedAttempts"] = backoff.getFailures();
+        to["backoffMs"] = backoff.getLastDelayMs();
+        to["roamScans"] = roamScans;
+        to["roams"] = roams;
+        to["roamConnects"] = roamConnects;
+        to["roamFallbacks"] = roamFallbacks;
+        to["channel"] = WiFi.channel();
+        to["rssi"] = WiFi.RSSI();
+    }
+
     [[nodiscard]] static std::optional<WiFiConnectionDetails> loadCredentials()
     {
-        WiFiConnectionDetails config = {};
-        Preferences prefs;
-        prefs.begin(PREFERENCES_NAME, true);
-        config.encryptionType = static_cast<WiFiEncryptionType>(prefs.getUChar(
-            "encryptionType", static_cast<uint8_t>(WiFiEncryptionType::INVALID)));
-        if (config.encryptionType == WiFiEncryptionType::INVALID)
-        {
-            prefs.end();
-            return std::nullopt; // No valid credentials found
-        }
-        if (isEap(config.encryptionType))
-        {
-            prefs.getBytes("identity", config.credentials.eap.identity, WIFI_MAX_EAP_IDENTITY + 1);
-            prefs.getBytes("username", config.credentials.eap.username, WIFI_MAX_EAP_USERNAME + 1);
-            prefs.getBytes("eapPassword", config.credentials.eap.password, WIFI_MAX_EAP_PASSWORD + 1);
-            config.credentials.eap.phase2Type = static_cast<WiFiPhaseTwoType>(prefs.getUChar(
-                "phase2Type", static_cast<uint8_t>(WiFiPhaseTwoType::ESP_EAP_TTLS_PHASE2_EAP)));
-            prefs.getBytes("ssid", config.ssid, WIFI_MAX_SSID_LENGTH + 1);
-        }
-        else
-        {
-            prefs.getBytes("ssid", config.ssid, WIFI_MAX_SSID_LENGTH + 1);
-            prefs.getBytes("password", config.credentials.simple.password, WIFI_MAX_PASSWORD_LENGTH + 1);
-        }
-        prefs.end();
-        return config;
+        return ConfigStore::get().getWiFiCredentials();
     }
 
     static void clearCredentials()
     {
-        Preferences prefs;
-        prefs.begin(PREFERENCES_NAME, false);
-
-        prefs.remove("encryptionType");
-        prefs.remove("ssid");
-        prefs.remove("password");
-        prefs.remove("identity");
-        prefs.remove("username");
-        prefs.remove("eapPassword");
-        prefs.remove("phase2Type");
-
-        prefs.end();
+        ConfigStore::get().clearWiFiCredentials();
     }
 
     static bool isEap(const WiFiConnectionDetails& details)
@@ -285,6 +361,10 @@ public:
         }
     }
 
+    /**
+     * Goes straight to the access point of the last successful connection when one is cached for this SSID,
+     * and falls back to a full scan if that fails.
+     */
     void connect(const WiFiConnectionDetails& details)
     {
         if (details.ssid[0] == '\0')
@@ -292,7 +372,7 @@ public:
             ESP_LOGE(LOG_TAG, "Cannot connect: SSID is empty");
             return;
         }
-        saveCredentials(details);
+        ConfigStore::get().setWiFiCredentials(details);
         WiFiClass::setHostname(getDeviceName());
 
         if (const int result = WiFi.scanComplete(); result == WIFI_SCAN_RUNNING || result >= 0)
@@ -301,56 +381,84 @@ public:
         WiFi.mode(WIFI_STA); // NOLINT
         WiFi.disconnect(true);
 
-        if (isEap(details))
-            connect(details.ssid, details.credentials.eap);
-        else
-            connect(details.ssid, details.credentials.simple);
+        std::lock_guard<std::mutex> lock(linkMutex);
+        reconnectTimer.stop();
+        backoff.reset();
+        networkIndex = 0;
+        attemptsOnNetwork = 0;
+        attempt();
     }
 
-private:
-    static void saveCredentials(const WiFiConnectionDetails& details)
+    /**
+     * Position of `ssid` among the stored networks, -1 when it is not stored.
+     */
+    static int knownNetworkIndex(const char* ssid)
     {
-        Preferences prefs;
-        prefs.begin(PREFERENCES_NAME, false);
-        prefs.putUChar("encryptionType", static_cast<uint8_t>(details.encryptionType));
-        if (isEap(details))
+        const auto& configStore = ConfigStore::get();
+        for (uint8_t i = 0; i < WIFI_MAX_KNOWN_NETWORKS; ++i)
         {
-            prefs.putBytes("identity", details.credentials.eap.identity, WIFI_MAX_EAP_IDENTITY + 1);
-            prefs.putBytes("username", details.credentials.eap.username, WIFI_MAX_EAP_USERNAME + 1);
-            prefs.putBytes("eapPassword", details.credentials.eap.password, WIFI_MAX_EAP_PASSWORD + 1);
-            prefs.putUChar("phase2Type", static_cast<uint8_t>(details.credentials.eap.phase2Type));
-            prefs.putBytes("ssid", details.ssid, WIFI_MAX_SSID_LENGTH + 1);
-            prefs.remove("password");
+            const auto details = configStore.getKnownWiFiNetwork(i);
+            if (!details) break;
+            if (std::strcmp(details->ssid, ssid) == 0) return i;
         }
-        else
+        return -1;
+    }
+
+    /**
+     * Main loop: forgets a stored network; false when it is not stored. Holds `linkMutex`, so the reconnect
+     * state machine never indexes into the list while it shifts, and `networkIndex` keeps pointing at the
+     * network being attempted.
+     */
+    bool forgetNetwork(const char* ssid)
+    {
+        std::lock_guard<std::mutex> lock(linkMutex);
+        const int index = knownNetworkIndex(ssid);
+        if (index < 0 || !ConfigStore::get().forgetWiFiNetwork(ssid)) return false;
+        if (index < networkIndex)
+            --networkIndex;
+        else if (index == networkIndex)
+            attemptsOnNetwork = 0; // the next network moves into this slot
+        return true;
+    }
+
+    /**
+     * Whether setStaticIp() takes `staticIp`: an enabled configuration needs an address, a subnet and a stored
+     * network. Lets a handler on another task answer before the command is applied.
+     */
+    static bool acceptsStaticIp(const WiFiStaticIp& staticIp)
+    {
+        return !staticIp.enabled
+            || (staticIp.ip != 0 && staticIp.subnet != 0 && ConfigStore::get().getKnownWiFiNetworkCount() > 0);
+    }
+
+    /**
+     * Main loop: stored for the next connection to the primary network. Holds `linkMutex`, so the primary
+     * cannot change under it while a fallback is being promoted.
+     */
+    bool setStaticIp(const WiFiStaticIp& staticIp)
+    {
+        std::lock_guard<std::mutex> lock(linkMutex);
+        if (!acceptsStaticIp(staticIp) || !ConfigStore::get().setWiFiStaticIp(staticIp))
         {
-            prefs.putBytes("ssid", details.ssid, WIFI_MAX_SSID_LENGTH + 1);
-            prefs.putBytes("password", details.credentials.simple.password, WIFI_MAX_PASSWORD_LENGTH + 1);
-            prefs.remove("identity");
-            prefs.remove("username");
-            prefs.remove("eapPassword");
-            prefs.remove("phase2Type");
+            ESP_LOGW(LOG_TAG, "Static IP rejected: needs ip, subnet and a stored network");
+            return false;
         }
-        prefs.end();
+        return true;
     }
 
+private:
     void setStatus(WiFiStatus newStatus)
     {
         if (newStatus == wifiStatus) return;
         ESP_LOGI(LOG_TAG, "WiFi status changed: %d -> %d",
                  static_cast<int>(wifiStatus.load()), static_cast<int>(newStatus));
         wifiStatus = newStatus;
-        if (statusChanged)
-        {
-            statusChanged(wifiStatus);
-        }
-        if (detailsChanged && (
-            newStatus == WiFiStatus::CONNECTED
+        statusChangedSignal.emit(newStatus);
+        if (newStatus == WiFiStatus::CONNECTED
             || newStatus == WiFiStatus::DISCONNECTED
-            || newStatus == WiFiStatus::CONNECTED_NO_IP
-        ))
+            || newStatus == WiFiStatus::CONNECTED_NO_IP)
         {
-            detailsChanged(WiFiDetails::fromWiFi());
+            detailsChangedSignal.emit(WiFiDetails::fromWiFi());
         }
     }
 
@@ -358,10 +466,7 @@ private:
     {
         if (status == scanStatus) return;
         this->scanStatus = status;
-        if (scanStatusChanged)
-        {
-            scanStatusChanged(status);
-        }
+        scanStatusChangedSignal.emit(status);
     }
 
     void setScanResult(const WiFiScanResult& r)
@@ -370,10 +475,7 @@ private:
         if (r != scanResult)
         {
             scanResult = r;
-            if (scanResultChanged)
-            {
-                scanResultChanged(r);
-            }
+            scanResultChangedSignal.emit(r);
         }
     }
 
@@ -389,13 +491,278 @@ private:
         return mutex;
     }
 
-    static void connect(const char* ssid, const WiFiConnectionDetails::SimpleWiFiConnectionCredentials& details)
+    static const char* linkStateString(const LinkState state)
+    {
+        switch (state)
+        {
+        case LinkState::IDLE: return "IDLE";
+        case LinkState::CONNECTING: return "CONNECTING";
+        case LinkState::CONNECTED: return "CONNECTED";
+        case LinkState::BACKOFF: return "BACKOFF";
+        default: return "UNKNOWN";
+        }
+    }
+
+    /**
+     * Starts an attempt on the stored network `networkIndex`; the primary goes to its cached access point
+     * first. Caller holds `linkMutex`.
+     */
+    void attempt()
+    {
+        const auto details = ConfigStore::get().getKnownWiFiNetwork(networkIndex);
+        if (!details)
+        {
+            linkState = LinkState::IDLE;
+            return;
+        }
+        applyStaticIp(details->ssid);
+        const auto fastConnect = networkIndex == 0 ? ConfigStore::get().getWiFiFastConnect() : WiFiFastConnect{};
+        if (fastConnect.isValid())
+            begin(details.value(), &fastConnect, AttemptKind::FAST_CONNECT);
+        else
+            begin(details.value(), nullptr, AttemptKind::SCAN);
+    }
+
+    /**
+     * Backoff expired (main loop): next attempt, moving on to the next stored network after
+     * ATTEMPTS_PER_NETWORK failures or a rejected password.
+     */
+    void reconnect()
+    {
+        std::lock_guard<std::mutex> lock(linkMutex);
+        if (linkState != LinkState::BACKOFF) return;
+        const uint8_t count = ConfigStore::get().getKnownWiFiNetworkCount();
+        if (count == 0)
+        {
+            linkState = LinkState::IDLE;
+            return;
+        }
+        if (attemptsOnNetwork >= ATTEMPTS_PER_NETWORK || lastDisconnectReason == WIFI_REASON_AUTH_FAIL)
+        {
+            networkIndex = (networkIndex + 1) % count;
+            attemptsOnNetwork = 0;
+        }
+        networkIndex %= count;
+        ++reconnects;
+        ESP_LOGI(LOG_TAG, "Reconnecting, network %u of %u, attempt %u", networkIndex + 1, count,
+                 attemptsOnNetwork + 1);
+        attempt();
+    }
+
+    /**
+     * An attempt failed or an established link dropped (event task). Returns true when the event was consumed
+     * by the fallback of a fast connect or roam.
+     */
+    bool linkLost(const uint8_t reason)
+    {
+        std::lock_guard<std::mutex> lock(linkMutex);
+        attemptTimer.stop();
+        if (attemptKind != AttemptKind::SCAN && !associatedUs && reason != WIFI_REASON_AUTH_FAIL)
+        {
+            fallBackToScan();
+            return true;
+        }
+        if (linkState == LinkState::CONNECTED)
+        {
+            ++disconnects;
+            attemptsOnNetwork = 0; // a working network gets its full share of attempts again
+        }
+        else
+        {
+            ++attemptsOnNetwork;
+        }
+        lastDisconnectReason = reason;
+        linkState = LinkState::BACKOFF;
+        attemptKind = AttemptKind::SCAN;
+        const uint32_t delayMs = backoff.next(esp_random());
+        ESP_LOGI(LOG_TAG, "Next attempt in %u ms", static_cast<unsigned>(delayMs));
+        reconnectTimer.start(delayMs);
+        return false;
+    }
+
+    /**
+     * GOT_IP (event task): resets the backoff, and a fallback network that worked becomes the primary.
+     */
+    void linkEstablished()
+    {
+        std::lock_guard<std::mutex> lock(linkMutex);
+        attemptTimer.stop();
+        reconnectTimer.stop();
+        if (networkIndex != 0)
+        {
+            if (const auto details = ConfigStore::get().getKnownWiFiNetwork(networkIndex))
+                ConfigStore::get().setWiFiCredentials(details.value());
+            networkIndex = 0;
+        }
+        rememberAccessPoint();
+        if (linkState != LinkState::CONNECTED)
+        {
+            connectedSinceMs = TimerService::nowMs();
+            rssiAverage = static_cast<float>(WiFi.RSSI());
+            rssiMin = WiFi.RSSI();
+        }
+        linkState = LinkState::CONNECTED;
+        backoff.reset();
+        attemptsOnNetwork = 0;
+    }
+
+    /**
+     * Safety net for attempts that end without a DISCONNECTED event (main loop).
+     */
+    void attemptTimedOut()
+    {
+        {
+            std::lock_guard<std::mutex> lock(linkMutex);
+            if (linkState != LinkState::CONNECTING) return;
+            ESP_LOGW(LOG_TAG, "No connection after %u ms, giving up on this attempt",
+                     static_cast<unsigned>(CONNECT_TIMEOUT_MS));
+        }
+        WiFi.disconnect(); // reported as ASSOC_LEAVE, which the event handler ignores
+        linkLost(WIFI_REASON_UNSPECIFIED);
+    }
+
+    /**
+     * Tracks the link quality (main loop) and starts a roaming scan while the signal stays weak. Roaming scans
+     * are internal: they neither change the scan status nor publish their result.
+     */
+    void sampleQuality()
+    {
+        std::lock_guard<std::mutex> lock(linkMutex);
+        if (linkState != LinkState::CONNECTED) return;
+        const int8_t rssi = WiFi.RSSI();
+        rssiAverage += RSSI_AVERAGE_ALPHA * (static_cast<float>(rssi) - rssiAverage);
+        rssiMin = std::min(rssiMin, rssi);
+
+        const uint64_t now = TimerService::nowMs();
+        if (rssiAverage >= ROAM_RSSI_THRESHOLD
+            || (lastRoamScanMs != 0 && now - lastRoamScanMs < ROAM_SCAN_INTERVAL_MS))
+            return;
+        lastRoamScanMs = now;
+        if (roamScanPending.exchange(true)) return;
+        ++roamScans;
+        wakeScanTask();
+    }
+
+    /**
+     * After a roaming scan (scan task): moves to a clearly stronger access point of the same SSID.
+     */
+    void considerRoaming(const WiFiScanCollector& collector)
+    {
+        std::lock_guard<std::mutex> lock(linkMutex);
+        wifi_ap_record_t current;
+        if (linkState != LinkState::CONNECTED || esp_wifi_sta_get_ap_info(&current) != ESP_OK) return;
+
+        const auto* ssid = reinterpret_cast<const char*>(current.ssid);
+        const auto candidate = collector.strongest(ssid);
+        if (!candidate || std::memcmp(candidate->bssid, current.bssid, sizeof(current.bssid)) == 0
+            || candidate->rssi < current.rssi + ROAM_HYSTERESIS_DB)
+            return;
+        const auto details = ConfigStore::get().getKnownWiFiNetwork(networkIndex);
+        if (!details || std::strcmp(details->ssid, ssid) != 0) return;
+
+        ++roams;
+        ESP_LOGI(LOG_TAG, "Roaming from %d dBm to %02X:%02X:%02X:%02X:%02X:%02X at %d dBm on channel %u",
+                 current.rssi, candidate->bssid[0], candidate->bssid[1], candidate->bssid[2], candidate->bssid[3],
+                 candidate->bssid[4], candidate->bssid[5], candidate->rssi, candidate->channel);
+        WiFiFastConnect target;
+        std::memcpy(target.bssid, candidate->bssid, sizeof(target.bssid));
+        target.channel = candidate->channel;
+        begin(details.value(), &target, AttemptKind::ROAM);
+    }
+
+    void startAttempt(const AttemptKind kind)
+    {
+        attemptStartUs = esp_timer_get_time();
+        associatedUs = 0;
+        attemptKind = kind;
+    }
+
+    // `fastConnect` is the access point to go to directly, nullptr to scan. Caller holds `linkMutex`.
+    void begin(const WiFiConnectionDetails& details, const WiFiFastConnect* fastConnect, const AttemptKind kind)
+    {
+        startAttempt(kind);
+        linkState = LinkState::CONNECTING;
+        attemptTimer.start(CONNECT_TIMEOUT_MS);
+        if (kind == AttemptKind::FAST_CONNECT)
+            ESP_LOGI(LOG_TAG, "Fast connect to %02X:%02X:%02X:%02X:%02X:%02X on channel %u",
+                     fastConnect->bssid[0], fastConnect->bssid[1], fastConnect->bssid[2],
+                     fastConnect->bssid[3], fastConnect->bssid[4], fastConnect->bssid[5], fastConnect->channel);
+
+        const int32_t channel = fastConnect ? fastConnect->channel : 0;
+        const uint8_t* bssid = fastConnect ? fastConnect->bssid : nullptr;
+        if (isEap(details))
+            connect(details.ssid, details.credentials.eap, channel, bssid);
+        else
+            connect(details.ssid, details.credentials.simple, channel, bssid);
+    }
+
+    /**
+     * The targeted access point did not answer (moved, switched channel, replaced): scan instead. A failed fast
+     * connect also drops the cache; a failed roam leaves it to the connection that follows.
+     * Caller holds `linkMutex`.
+     */
+    void fallBackToScan()
+    {
+        if (attemptKind == AttemptKind::ROAM)
+        {
+            ++roamFallbacks;
+            ESP_LOGW(LOG_TAG, "Roam failed, scanning for the network");
+        }
+        else
+        {
+            ++fastConnectFallbacks;
+            ESP_LOGW(LOG_TAG, "Fast connect failed, scanning for the network");
+            if (networkIndex == 0)
+                ConfigStore::get().setWiFiFastConnect({});
+        }
+        if (const auto details = ConfigStore::get().getKnownWiFiNetwork(networkIndex))
+            begin(details.value(), nullptr, AttemptKind::SCAN);
+    }
+
+    /**
+     * Caches where this connection landed; the store ignores unchanged values, so this costs no flash
+     * write on an ordinary reconnect.
+     */
+    void rememberAccessPoint()
+    {
+        lastConnectFast = attemptKind == AttemptKind::FAST_CONNECT;
+        if (attemptKind == AttemptKind::FAST_CONNECT)
+            ++fastConnects;
+        else if (attemptKind == AttemptKind::ROAM)
+            ++roamConnects;
+        attemptKind = AttemptKind::SCAN;
+
+        WiFiFastConnect fastConnect;
+        if (const uint8_t* bssid = WiFi.BSSID())
+        {
+            std::memcpy(fastConnect.bssid, bssid, sizeof(fastConnect.bssid));
+            fastConnect.channel = static_cast<uint8_t>(WiFi.channel());
+            ConfigStore::get().setWiFiFastConnect(fastConnect);
+        }
+    }
+
+    /**
+     * The static address belongs to the network it was configured for; every other network uses DHCP, also
+     * after it has become the primary.
+     */
+    static void applyStaticIp(const char* ssid)
+    {
+        if (const auto staticIp = ConfigStore::get().getWiFiStaticIp(ssid); staticIp.enabled)
+            WiFi.config(IPAddress(staticIp.ip), IPAddress(staticIp.gateway), IPAddress(staticIp.subnet),
+                        IPAddress(staticIp.dns ? staticIp.dns : staticIp.gateway));
+        else
+            WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE); // back to DHCP
+    }
+
+    static void connect(const char* ssid, const WiFiConnectionDetails::SimpleWiFiConnectionCredentials& details,
+                        const int32_t channel, const uint8_t* bssid)
     {
         esp_wifi_sta_wpa2_ent_disable();
-        WiFi.begin(ssid, details.password[0] == '\0' ? nullptr : details.password);
+        WiFi.begin(ssid, details.password[0] == '\0' ? nullptr : details.password, channel, bssid);
     }
 
-    static void connect(const char* ssid, const WiFiConnectionDetails::EAPWiFiConnectionCredentials& details)
+    static void connect(const char* ssid, const WiFiConnectionDetails::EAPWiFiConnectionCredentials& details,
+                        const int32_t channel, const uint8_t* bssid)
     {
         esp_wifi_sta_wpa2_ent_enable();
         esp_wifi_sta_wpa2_ent_set_identity(reinterpret_cast<const unsigned char*>(details.identity),
@@ -405,7 +772,7 @@ private:
         esp_wifi_sta_wpa2_ent_set_password(reinterpret_cast<const unsigned char*>(details.password),
                                            static_cast<int>(strlen(details.password)));
         esp_wifi_sta_wpa2_ent_set_ttls_phase2_method(static_cast<esp_eap_ttls_phase2_types>(details.phase2Type));
-        WiFi.begin(ssid);
+        WiFi.begin(ssid, nullptr, channel, bssid);
     }
 
     void startTasks()
@@ -418,10 +785,21 @@ private:
                 ESP_LOGE(LOG_TAG, "Failed to create wifiScanQueue");
                 return;
             }
-            xTaskCreate(wifiScanNotifier, "WifiScanNotifier", 4096, this, 1, nullptr);
+            xTaskCreate(wifiScanNotifier, "WifiScanNotifier", 4096, this, 1, &scanTask);
         }
     }
 
+    void wakeScanTask() const
+    {
+        // A full queue already holds a wake-up the task has not acted on; it picks this request up as well.
+        constexpr auto event = WifiScanEvent::StartScan;
+        xQueueSend(wifiScanQueue, &event, 0);
+    }
+
+    /**
+     * Waits for scan requests, starts an asynchronous scan and sleeps until the SCAN_DONE event wakes it. Only
+     * user scans report their status and result; a roaming scan just feeds considerRoaming().
+     */
     static void wifiScanNotifier(void* param)
     {
         auto* manager = static_cast<WiFiManager*>(param);
@@ -431,54 +809,53 @@ private:
             if (xQueueReceive(manager->wifiScanQueue, &event, portMAX_DELAY) == pdTRUE
                 && event == WifiScanEvent::StartScan)
             {
-                manager->setScanStatus(WifiScanStatus::RUNNING);
+                const bool user = manager->userScanPending.exchange(false);
+                const bool roam = manager->roamScanPending.exchange(false);
+                if (!user && !roam) continue; // already served by the scan before
+                if (user)
+                    manager->setScanStatus(WifiScanStatus::RUNNING);
+                const int64_t start = esp_timer_get_time();
+                ulTaskNotifyTake(pdTRUE, 0); // drop a SCAN_DONE left over from a scan started elsewhere
                 WiFi.scanNetworks(true);
-                while (WiFi.scanComplete() == WIFI_SCAN_RUNNING)
-                {
-                    vTaskDelay(pdMS_TO_TICKS(500));
-                }
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SCAN_TIMEOUT_MS));
                 const int16_t scanStatus = WiFi.scanComplete();
                 if (scanStatus < 0)
                 {
                     ESP_LOGE(LOG_TAG, "WiFi scan failed with status: %d", scanStatus);
-                    manager->setScanStatus(WifiScanStatus::FAILED);
+                    if (user)
+                        manager->setScanStatus(WifiScanStatus::FAILED);
                     continue;
                 }
-                WiFiScanResult result = {};
 
-                for (int i = 0; i < scanStatus && result.resultCount < MAX_SCAN_NETWORK_COUNT; ++i)
+                auto& collector = manager->scanCollector;
+                collector.reset();
+                for (int i = 0; i < scanStatus; ++i)
                 {
-                    auto ssid = WiFi.SSID(i);
-                    if (ssid.isEmpty()) continue;
-
-                    if (result.contains(ssid))
-                        continue; // Skip duplicates
-
-                    strncpy(result.networks[result.resultCount].ssid, ssid.c_str(), WIFI_MAX_SSID_LENGTH);
-                    result.networks[result.resultCount].ssid[WIFI_MAX_SSID_LENGTH] = '\0';
-                    result.networks[result.resultCount].encryptionType =
-                        static_cast<WiFiEncryptionType>(WiFi.encryptionType(i));
-                    result.resultCount++;
+                    const auto* record = static_cast<const wifi_ap_record_t*>(WiFi.getScanInfoByIndex(i));
+                    if (!record) continue;
+                    collector.add(reinterpret_cast<const char*>(record->ssid), record->bssid,
+                                  static_cast<WiFiEncryptionType>(record->authmode), record->rssi, record->primary);
                 }
                 WiFi.scanDelete();
+                manager->lastScanUs = static_cast<uint32_t>(esp_timer_get_time() - start);
+                ESP_LOGI(LOG_TAG, "Scan found %d access points, %u networks in %u ms", scanStatus,
+                         collector.getCount(), static_cast<unsigned>(manager->lastScanUs / 1000));
 
-                manager->setScanStatus(WifiScanStatus::COMPLETED);
-                manager->setScanResult(result);
+                if (roam)
+                    manager->considerRoaming(collector);
+                if (user)
+                {
+                    manager->setScanStatus(WifiScanStatus::COMPLETED);
+                    manager->setScanResult(collector.result());
+                }
             }
         }
     } // NOLINT
 
     static const char* loadDeviceName(char* deviceName)
     {
-        Preferences prefs;
-        prefs.begin(PREFERENCES_NAME, true);
-        if (prefs.isKey("deviceName"))
-        {
-            prefs.getString("deviceName", deviceName, DEVICE_NAME_TOTAL_LENGTH);
-            prefs.end();
+        if (ConfigStore::get().getDeviceName(deviceName))
             return deviceName;
-        }
-        prefs.end();
         uint8_t mac[6];
         WiFi.macAddress(mac);
         snprintf(deviceName, DEVICE_NAME_TOTAL_LENGTH,
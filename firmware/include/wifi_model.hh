@@ -1,6 +1,7 @@
 #pragma once
 
 #include <WiFi.h>
+#include <cstdint>
 #include <cstring>
 
 #include "ArduinoJson.h"
@@ -10,7 +11,12 @@
 #define WIFI_MAX_EAP_IDENTITY     128
 #define WIFI_MAX_EAP_USERNAME     128
 #define WIFI_MAX_EAP_PASSWORD     128
-#define MAX_SCAN_NETWORK_COUNT    15
+#define WIFI_MAX_KNOWN_NETWORKS   3 // stored credential sets, tried in turn when reconnecting
+#define MAX_SCAN_NETWORK_COUNT    13 // keeps WiFiScanResult within one BLE attribute (512 bytes)
+
+#define DEVICE_NAME_MAX_LENGTH 28
+#define DEVICE_NAME_TOTAL_LENGTH (DEVICE_NAME_MAX_LENGTH + 1)
+#define DEVICE_BASE_NAME "rgbw-ctrl-"
 
 #pragma pack(push, 1)
 enum class WifiScanEvent : uint8_t
@@ -66,10 +72,14 @@ struct WiFiNetwork
 {
     WiFiEncryptionType encryptionType = WiFiEncryptionType::INVALID;
     char ssid[WIFI_MAX_SSID_LENGTH + 1] = {};
+    int8_t rssi = INT8_MIN; // of the strongest access point advertising the SSID
+    uint8_t channel = 0; // of the strongest access point
+    uint8_t bssidCount = 0; // access points advertising the SSID
 
     bool operator !=(const WiFiNetwork& other) const
     {
-        return encryptionType != other.encryptionType || std::strcmp(ssid, other.ssid) != 0;
+        return encryptionType != other.encryptionType || rssi != other.rssi || channel != other.channel
+            || bssidCount != other.bssidCount || std::strcmp(ssid, other.ssid) != 0;
     }
 
     bool operator ==(const WiFiNetwork& other) const
@@ -78,8 +88,15 @@ struct WiFiNetwork
     }
 };
 
+/**
+ * Networks of the last scan, strongest first. Sent as is over BLE and WebSocket; `version` lets clients
+ * tell this layout from the unversioned one (a count followed by encryption type and SSID only).
+ */
 struct WiFiScanResult
 {
+    static constexpr uint8_t VERSION = 2;
+
+    uint8_t version = VERSION;
     uint8_t resultCount = 0;
     WiFiNetwork networks[MAX_SCAN_NETWORK_COUNT] = {};
 
@@ -96,18 +113,6 @@ struct WiFiScanResult
 
         return false;
     }
-
-    [[nodiscard]] bool contains(const String& ssid) const
-    {
-        for (uint8_t i = 0; i < resultCount; ++i)
-        {
-            if (networks[i].ssid[0] == '\0')
-                continue;
-            if (String(networks[i].ssid) == ssid)
-                return true;
-        }
-        return false;
-    }
 };
 
 struct WiFiDetails
@@ -171,4 +176,41 @@ struct WiFiConnectionDetails
     WiFiConnectionDetailsCredentials credentials = {};
 };
 
+/**
+ * Access point of the last successful connection, so the next connect can skip the channel scan.
+ */
+struct WiFiFastConnect
+{
+    uint8_t bssid[6] = {};
+    uint8_t channel = 0; // 0: nothing cached
+
+    [[nodiscard]] bool isValid() const
+    {
+        return channel != 0;
+    }
+};
+
+/**
+ * Static address configuration; when disabled the address comes from DHCP.
+ */
+struct WiFiStaticIp
+{
+    bool enabled = false;
+    uint32_t ip = 0;
+    uint32_t gateway = 0;
+    uint32_t subnet = 0;
+    uint32_t dns = 0;
+
+    void toJson(const JsonObject& to) const
+    {
+        to["mode"] = enabled ? "static" : "dhcp";
+        to["ip"] = IPAddress(ip).toString();
+        to["gateway"] = IPAddress(gateway).toString();
+        to["subnet"] = IPAddress(subnet).toString();
+        to["dns"] = IPAddress(dns).toString();
+    }
+};
+
 #pragma pack(pop)
+
+static_assert(sizeof(WiFiScanResult) <= 512, "WiFiScanResult must fit one BLE attribute");
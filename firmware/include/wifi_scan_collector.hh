@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+
+#include "wifi_model.hh"
+
+/**
+ * Folds raw scan records (one per access point) into one entry per SSID, keeping the strongest access point's
+ * RSSI, channel and BSSID, and ranks the networks by signal. SSIDs are deduplicated through an open-addressing hash
+ * table over fixed arrays, so a crowded scan costs no heap and no quadratic string comparisons. About 3 KB,
+ * so it is kept out of task stacks.
+ */
+class WiFiScanCollector
+{
+public:
+    static constexpr uint8_t MAX_NETWORKS = 64; // distinct SSIDs considered; later ones are dropped
+
+    struct AccessPoint
+    {
+        uint8_t bssid[6];
+        uint8_t channel;
+        int8_t rssi;
+    };
+
+private:
+    static constexpr uint8_t TABLE_SIZE = 128; // power of two, at most half full
+    static constexpr uint8_t EMPTY = 0xFF;
+
+    WiFiNetwork networks[MAX_NETWORKS] = {};
+    uint32_t hashes[MAX_NETWORKS] = {};
+    uint8_t bssids[MAX_NETWORKS][6] = {}; // of the strongest access point, for roaming
+    uint8_t table[TABLE_SIZE];
+    uint8_t count = 0;
+    uint16_t dropped = 0;
+
+    static_assert((TABLE_SIZE & (TABLE_SIZE - 1)) == 0 && TABLE_SIZE >= 2 * MAX_NETWORKS);
+
+    static uint32_t hash(const char* ssid)
+    {
+        uint32_t value = 2166136261u; // FNV-1a
+        for (; *ssid; ++ssid)
+            value = (value ^ static_cast<uint8_t>(*ssid)) * 16777619u;
+        return value;
+    }
+
+public:
+    WiFiScanCollector()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(std::begin(table), std::end(table), EMPTY);
+        count = 0;
+        dropped = 0;
+    }
+
+    /**
+     * Adds one access point; hidden networks (empty SSID) are skipped.
+     */
+    void add(const char* ssid, const uint8_t* bssid, const WiFiEncryptionType encryptionType, const int8_t rssi,
+             const uint8_t channel)
+    {
+        if (!ssid || ssid[0] == '\0') return;
+
+        const uint32_t ssidHash = hash(ssid);
+        uint8_t slot = ssidHash & (TABLE_SIZE - 1);
+        for (; table[slot] != EMPTY; slot = (slot + 1) & (TABLE_SIZE - 1))
+        {
+            WiFiNetwork& network = networks[table[slot]];
+            if (hashes[table[slot]] != ssidHash || std::strncmp(network.ssid, ssid, WIFI_MAX_SSID_LENGTH) != 0)
+                continue;
+            if (network.bssidCount < UINT8_MAX)
+                ++network.bssidCount;
+            if (rssi > network.rssi)
+            {
+                network.rssi = rssi;
+                network.channel = channel;
+                network.encryptionType = encryptionType;
+                std::memcpy(bssids[table[slot]], bssid, sizeof(bssids[0]));
+            }
+            return;
+        }
+
+        if (count == MAX_NETWORKS)
+        {
+            ++dropped;
+            return;
+        }
+        WiFiNetwork& network = networks[count];
+        std::strncpy(network.ssid, ssid, WIFI_MAX_SSID_LENGTH);
+        network.ssid[WIFI_MAX_SSID_LENGTH] = '\0';
+        network.encryptionType = encryptionType;
+        network.rssi = rssi;
+        network.channel = channel;
+        network.bssidCount = 1;
+        hashes[count] = ssidHash;
+        std::memcpy(bssids[count], bssid, sizeof(bssids[0]));
+        table[slot] = count++;
+    }
+
+    /**
+     * The strongest MAX_SCAN_NETWORK_COUNT networks, strongest first.
+     */
+    [[nodiscard]] WiFiScanResult result() const
+    {
+        uint8_t order[MAX_NETWORKS];
+        for (uint8_t i = 0; i < count; ++i)
+            order[i] = i;
+        WiFiScanResult result;
+        result.resultCount = std::min<uint8_t>(count, MAX_SCAN_NETWORK_COUNT);
+        std::partial_sort(order, order + result.resultCount, order + count,
+                          [this](const uint8_t a, const uint8_t b) { return networks[a].rssi > networks[b].rssi; });
+        for (uint8_t i = 0; i < result.resultCount; ++i)
+            result.networks[i] = networks[order[i]];
+        return result;
+    }
+
+    /**
+     * The strongest access point seen for `ssid`, if any.
+     */
+    [[nodiscard]] std::optional<AccessPoint> strongest(const char* ssid) const
+    {
+        const uint32_t ssidHash = hash(ssid);
+        for (uint8_t slot = ssidHash & (TABLE_SIZE - 1); table[slot] != EMPTY; slot = (slot + 1) & (TABLE_SIZE - 1))
+        {
+            const uint8_t index = table[slot];
+            if (hashes[index] != ssidHash || std::strncmp(networks[index].ssid, ssid, WIFI_MAX_SSID_LENGTH) != 0)
+                continue;
+            AccessPoint accessPoint = {};
+            std::memcpy(accessPoint.bssid, bssids[index], sizeof(accessPoint.bssid));
+            accessPoint.channel = networks[index].channel;
+            accessPoint.rssi = networks[index].rssi;
+            return accessPoint;
+        }
+        return std::nullopt;
+    }
+
+    [[nodiscard]] uint8_t getCount() const { return count; }
+    [[nodiscard]] uint16_t getDropped() const { return dropped; }
+};
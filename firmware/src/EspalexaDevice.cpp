@@ -55,6 +55,11 @@ String EspalexaDevice::getName()
   return _deviceName;
 }
 
+uint16_t EspalexaDevice::getTransitionTime()
+{
+  return _transitionTime;
+}
+
 EspalexaDeviceProperty EspalexaDevice::getLastChangedProperty()
 {
   return _changed;
@@ -113,9 +118,19 @@ uint32_t EspalexaDevice::getKelvin()
   return 1000000/_ct;
 }
 
+//cached, so the getR/G/B/W calls made by a callback convert the color only once per change
 uint32_t EspalexaDevice::getRGB()
 {
-  if (_rgb != 0) return _rgb; //color has not changed
+  if (_rgbDirty)
+  {
+    _rgb = computeRGB();
+    _rgbDirty = false;
+  }
+  return _rgb;
+}
+
+uint32_t EspalexaDevice::computeRGB()
+{
   byte rgb[4]{0, 0, 0, 0};
   
   if (_mode == EspalexaColorMode::none) return 0;
@@ -222,8 +237,7 @@ uint32_t EspalexaDevice::getRGB()
     rgb[1] = 255.0*g;
     rgb[2] = 255.0*b;
   }
-  _rgb = ((rgb[0] << 16) | (rgb[1] << 8) | (rgb[2]));
-  return _rgb;
+  return ((rgb[0] << 16) | (rgb[1] << 8) | (rgb[2]));
 }
 
 //white channel for RGBW lights. Always 0 unless colormode is ct
@@ -304,7 +318,7 @@ void EspalexaDevice::setColorXY(float x, float y)
 {
   _x = x;
   _y = y;
-  _rgb = 0;
+  _rgbDirty = true;
   _mode = EspalexaColorMode::xy;
 }
 
@@ -312,14 +326,14 @@ void EspalexaDevice::setColor(uint16_t hue, uint8_t sat)
 {
   _hue = hue;
   _sat = sat;
-  _rgb = 0;
+  _rgbDirty = true;
   _mode = EspalexaColorMode::hs;
 }
 
 void EspalexaDevice::setColor(uint16_t ct)
 {
   _ct = ct;
-  _rgb = 0;
+  _rgbDirty = true;
   _mode =EspalexaColorMode::ct;
 }
 
@@ -339,9 +353,15 @@ void EspalexaDevice::setColor(uint8_t r, uint8_t g, uint8_t b)
   }
 
   _rgb = ((r << 16) | (g << 8) | b);
+  _rgbDirty = false;
   _mode = EspalexaColorMode::xy;
 }
 
+void EspalexaDevice::setTransitionTime(uint16_t transitionTime)
+{
+  _transitionTime = transitionTime;
+}
+
 void EspalexaDevice::doCallback()
 {
   if (_callback != nullptr) {_callback(_val); return;}
@@ -1,36 +1,242 @@
 #include "async_call.hh"
 
-#include <esp32-hal.h>
-#include <esp_system.h>
+#include <algorithm>
+#include <mutex>
+#include <esp_log.h>
+#include <esp_timer.h>
 #include <freertos/FreeRTOS.h> // NOLINT
 #include <freertos/task.h>
+#include <freertos/semphr.h>
 
 constexpr auto ASYNC_CALL_TAG = "AsyncCall";
+constexpr auto ASYNC_CALL_TASK_NAME = "AsyncCallWorker";
+constexpr uint8_t ASYNC_CALL_WORKERS = 2;
+constexpr uint8_t ASYNC_CALL_MAX_JOBS = 16;
+constexpr uint32_t ASYNC_CALL_STACK_SIZE = 4096;
 
-struct AsyncCallArgs
+static_assert(ASYNC_CALL_MAX_JOBS < UINT8_MAX, "Job slots are addressed with uint8_t");
+
+namespace
+{
+    struct Job
+    {
+        AsyncCallback callback;
+        int64_t dueUs = 0;
+        uint32_t sequence = 0;
+        uint16_t generation = 0;
+        uint8_t heapIndex = UINT8_MAX; // UINT8_MAX while the slot is free
+    };
+
+    /**
+     * Fixed pool of worker tasks fed by a binary min-heap of job slots ordered by due time (FIFO on ties).
+     * Jobs live in a fixed array, so scheduling never allocates and never creates a task.
+     */
+    class Scheduler
+    {
+        std::mutex mutex;
+        SemaphoreHandle_t wake;
+        Job jobs[ASYNC_CALL_MAX_JOBS];
+        uint8_t heap[ASYNC_CALL_MAX_JOBS] = {};
+        uint8_t heapSize = 0;
+        uint32_t sequence = 0;
+        AsyncCallStats stats = {};
+
+    public:
+        Scheduler() : wake(xSemaphoreCreateBinary())
+        {
+            for (uint8_t i = 0; i < ASYNC_CALL_WORKERS; ++i)
+            {
+                if (xTaskCreate(workerTask, ASYNC_CALL_TASK_NAME, ASYNC_CALL_STACK_SIZE, this, 1, nullptr) != pdPASS)
+                    ESP_LOGE(ASYNC_CALL_TAG, "Failed to create worker %u", i);
+            }
+        }
+
+        AsyncCallHandle schedule(AsyncCallback&& callback, const uint32_t delayMs)
+        {
+            AsyncCallHandle handle;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                uint8_t slot = 0;
+                while (slot < ASYNC_CALL_MAX_JOBS && jobs[slot].heapIndex != UINT8_MAX) ++slot;
+                if (slot == ASYNC_CALL_MAX_JOBS)
+                {
+                    ++stats.rejected;
+                    ESP_LOGE(ASYNC_CALL_TAG, "Job queue full, call dropped");
+                    return handle;
+                }
+
+                auto& job = jobs[slot];
+                job.callback = std::move(callback);
+                job.dueUs = esp_timer_get_time() + static_cast<int64_t>(delayMs) * 1000;
+                job.sequence = sequence++;
+                job.heapIndex = heapSize;
+                heap[heapSize++] = slot;
+                siftUp(job.heapIndex);
+
+                stats.queueDepth = heapSize;
+                if (heapSize > stats.maxQueueDepth) stats.maxQueueDepth = heapSize;
+                handle = {slot, job.generation};
+            }
+            xSemaphoreGive(wake);
+            return handle;
+        }
+
+        bool cancel(const AsyncCallHandle handle)
+        {
+            if (!handle.isValid() || handle.slot >= ASYNC_CALL_MAX_JOBS) return false;
+            AsyncCallback callback;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto& job = jobs[handle.slot];
+                if (job.generation != handle.generation || job.heapIndex == UINT8_MAX) return false;
+                removeAt(job.heapIndex);
+                callback = release(job);
+                ++stats.cancelled;
+            }
+            return true; // callback is destroyed outside the lock
+        }
+
+        AsyncCallStats getStats()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return stats;
+        }
+
+    private:
+        [[noreturn]] static void workerTask(void* arg)
+        {
+            auto* scheduler = static_cast<Scheduler*>(arg);
+            while (true)
+            {
+                scheduler->runNext();
+            }
+        }
+
+        void runNext()
+        {
+            AsyncCallback callback;
+            int64_t dueUs = 0;
+            TickType_t wait = portMAX_DELAY;
+            bool moreQueued = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                const int64_t now = esp_timer_get_time();
+                if (heapSize > 0)
+                {
+                    auto& head = jobs[heap[0]];
+                    if (head.dueUs <= now)
+                    {
+                        dueUs = head.dueUs;
+                        removeAt(0);
+                        callback = release(head);
+                        moreQueued = heapSize > 0;
+                    }
+                    else
+                    {
+                        const auto waitMs = static_cast<uint32_t>((head.dueUs - now + 999) / 1000);
+                        wait = std::max<TickType_t>(1, pdMS_TO_TICKS(waitMs));
+                    }
+                }
+            }
+
+            if (!callback)
+            {
+                xSemaphoreTake(wake, wait);
+                return;
+            }
+            // The other worker may be blocked without a timeout (the heap was empty when it went to sleep) and one
+            // give from schedule() wakes only one worker: hand it the rest of the queue, due now or later.
+            if (moreQueued) xSemaphoreGive(wake);
+
+            const int64_t startUs = esp_timer_get_time();
+            callback();
+            const int64_t endUs = esp_timer_get_time();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            ++stats.executed;
+            stats.maxLatencyUs = std::max(stats.maxLatencyUs, static_cast<uint32_t>(startUs - dueUs));
+            stats.maxRuntimeUs = std::max(stats.maxRuntimeUs, static_cast<uint32_t>(endUs - startUs));
+        }
+
+        AsyncCallback release(Job& job)
+        {
+            job.heapIndex = UINT8_MAX;
+            ++job.generation;
+            stats.queueDepth = heapSize;
+            return std::move(job.callback);
+        }
+
+        [[nodiscard]] bool before(const uint8_t a, const uint8_t b) const
+        {
+            const auto& jobA = jobs[heap[a]];
+            const auto& jobB = jobs[heap[b]];
+            if (jobA.dueUs != jobB.dueUs) return jobA.dueUs < jobB.dueUs;
+            return static_cast<int32_t>(jobA.sequence - jobB.sequence) < 0;
+        }
+
+        void swap(const uint8_t a, const uint8_t b)
+        {
+            std::swap(heap[a], heap[b]);
+            jobs[heap[a]].heapIndex = a;
+            jobs[heap[b]].heapIndex = b;
+        }
+
+        void siftUp(uint8_t index)
+        {
+            while (index > 0)
+            {
+                const uint8_t parent = (index - 1) / 2;
+                if (!before(index, parent)) break;
+                swap(index, parent);
+                index = parent;
+            }
+        }
+
+        void siftDown(uint8_t index)
+        {
+            while (true)
+            {
+                const uint8_t left = index * 2 + 1;
+                const uint8_t right = left + 1;
+                uint8_t smallest = index;
+                if (left < heapSize && before(left, smallest)) smallest = left;
+                if (right < heapSize && before(right, smallest)) smallest = right;
+                if (smallest == index) break;
+                swap(index, smallest);
+                index = smallest;
+            }
+        }
+
+        void removeAt(const uint8_t index)
+        {
+            const uint8_t last = --heapSize;
+            if (index != last)
+            {
+                swap(index, last);
+                siftDown(index);
+                siftUp(index);
+            }
+        }
+    };
+
+    Scheduler& scheduler()
+    {
+        static Scheduler instance;
+        return instance;
+    }
+}
+
+AsyncCallHandle async_call(AsyncCallback callback, const uint32_t delayMs)
 {
-    std::function<void()> callback;
-    uint32_t delayMs;
-};
+    return scheduler().schedule(std::move(callback), delayMs);
+}
 
-void doCall(void* args)
+bool async_call_cancel(const AsyncCallHandle handle)
 {
-    const auto* callArgs = static_cast<AsyncCallArgs*>(args);
-    delay(callArgs->delayMs);
-    callArgs->callback();
-    delete callArgs;
-    vTaskDelete(nullptr); // Delete this task
+    return scheduler().cancel(handle);
 }
 
-void async_call(
-    std::function<void()> callback,
-    const uint32_t usStackDepth,
-    const uint32_t delayMs)
+AsyncCallStats async_call_stats()
 {
-    if (auto* args = new AsyncCallArgs{std::move(callback), delayMs};
-        xTaskCreate(doCall, "AsyncCallTask", usStackDepth, args, 1, nullptr) != pdPASS)
-    {
-        ESP_LOGE(ASYNC_CALL_TAG, "Failed to create task");
-        delete args;
-    }
+    return scheduler().getStats();
 }
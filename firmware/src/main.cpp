@@ -1,62 +1,113 @@
 #include <Arduino.h>
 #include <nvs_flash.h>
-#include <LittleFS.h>
 
+#include "config_store.hh"
 #include "wifi_manager.hh"
+#include "asset_bundle.hh"
+#include "boot_profiler.hh"
 #include "board_led.hh"
 #include "alexa_integration.hh"
 #include "output.hh"
+#include "power_manager.hh"
 #include "push_button.hh"
 #include "ota_handler.hh"
 #include "rest_handler.hh"
 #include "websocket_handler.hh"
+#include "main_loop.hh"
+#include "command_handler.hh"
+#include "supply_monitor.hh"
 
 Output output;
-BoardLED boardLED;
+OutputCommandQueue outputCommands;
+ControlCommandQueue controlCommands;
+AssetBundle assetBundle;
 OtaHandler otaHandler;
 PushButton boardButton;
+SupplyMonitor supplyMonitor;
 WiFiManager wifiManager;
 WebServerHandler webServerHandler;
-AlexaIntegration alexaIntegration(output);
+AlexaIntegration alexaIntegration(output, outputCommands);
+PowerManager powerManager(wifiManager, otaHandler);
 BleManager bleManager(output,
                       wifiManager,
                       alexaIntegration,
-                      webServerHandler);
+                      powerManager,
+                      outputCommands,
+                      controlCommands);
 WebSocketHandler webSocketHandler(output,
                                   otaHandler,
                                   wifiManager,
-                                  webServerHandler,
-                                  alexaIntegration,
-                                  bleManager);
+                                  bleManager,
+                                  powerManager,
+                                  outputCommands,
+                                  controlCommands);
 
 RestHandler restHandler(output,
                         otaHandler,
                         wifiManager,
                         alexaIntegration,
-                        bleManager);
+                        bleManager,
+                        powerManager,
+                        outputCommands,
+                        controlCommands,
+                        supplyMonitor,
+                        webSocketHandler);
+BoardLED boardLED(bleManager, wifiManager, otaHandler);
+CommandHandler commandHandler(outputCommands,
+                              controlCommands,
+                              output,
+                              wifiManager,
+                              webServerHandler,
+                              alexaIntegration,
+                              powerManager);
 
 void setup()
 {
+    // Before anything slow: after a restart the output shows its last state from RTC memory right away.
+    output.begin();
+    BootProfiler::mark("output");
     nvs_flash_init();
+    ConfigStore::get().begin();
+    output.restore();
+    BootProfiler::mark("config");
+    MainLoop::get().begin();
+    commandHandler.begin();
     boardLED.begin();
-    output.begin();
+    supplyMonitor.begin();
+    // Before Wi-Fi starts: GOT_IP fires on the event task and must find the Alexa device table complete.
+    alexaIntegration.prepare();
+    BootProfiler::mark("services");
+
+    // Start associating as early as possible; the Wi-Fi task connects while setup() prepares everything else.
     wifiManager.begin();
-    otaHandler.begin(webServerHandler);
-    wifiManager.setGotIpCallback([]()
+    powerManager.begin();
+    wifiManager.gotIp().connect([]
     {
+        BootProfiler::markOnce("gotIp");
         alexaIntegration.begin();
-        webServerHandler.begin(
-            alexaIntegration.createAsyncWebHandler(),
-            webSocketHandler.getAsyncWebHandler(),
-            restHandler.createAsyncWebHandler()
-        );
     });
-
-    if (const auto credentials = WiFiManager::loadCredentials())
+    const auto credentials = WiFiManager::loadCredentials();
+    if (credentials)
         wifiManager.connect(credentials.value());
-    else
+    BootProfiler::mark("wifiStart");
+
+    // The bundle is read-only and never formatted: without a valid one the UI is unavailable, REST and WS are not.
+    if (!assetBundle.begin())
+        ESP_LOGE("main", "Web UI unavailable, flash the assets partition");
+    BootProfiler::mark("assets");
+    otaHandler.begin(webServerHandler);
+    webServerHandler.begin(
+        alexaIntegration.createAsyncWebHandler(),
+        webSocketHandler.getAsyncWebHandler(),
+        restHandler.createAsyncWebHandler(),
+        assetBundle.createAsyncWebHandler()
+    );
+    BootProfiler::mark("webServer");
+
+    if (!credentials)
         bleManager.start();
 
+    boardButton.begin();
     boardButton.setLongPressCallback([]()
     {
         bleManager.start();
@@ -66,25 +117,10 @@ void setup()
     {
         output.toggleAll();
     });
-
-    LittleFS.begin(true);
+    BootProfiler::mark("setup");
 }
 
 void loop()
 {
-    const auto now = millis();
-
-    boardButton.handle(now);
-    alexaIntegration.handle();
-    webSocketHandler.handle(now);
-    bleManager.handle(now);
-    output.handle(now);
-
-    boardLED.handle(
-        now,
-        bleManager.getStatus(),
-        wifiManager.getScanStatus(),
-        wifiManager.getStatus(),
-        otaHandler.getStatus() == OtaStatus::Started
-    );
+    MainLoop::get().run();
 }
@@ -0,0 +1,285 @@
+// Host benchmark of an Alexa color command as EspalexaDevice sees it: Espalexa sets the color from the Hue PUT,
+// then the device callback reads it back with getR(), getG(), getB() and getW(). The current device, compiled
+// separately as in the firmware, is timed against a copy of the code before the dirty-flag cache. Both must
+// give identical colors for every (hue, sat) pair, every mired value and a grid of xy points.
+// Built with -O2 and no sanitizers; `alexa_color_bench [rounds]`
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "EspalexaDevice.h"
+#include "check.hh"
+
+namespace
+{
+    volatile uint32_t sink; // keeps the commands from being optimized away
+
+    /**
+     * The color part of EspalexaDevice before the cache, verbatim apart from the class name: a cached value
+     * of 0 means "not computed", so a black color is converted again on every read.
+     */
+    class LegacyDevice
+    {
+        uint8_t _sat = 0;
+        uint16_t _hue = 0, _ct = 0;
+        float _x = 0.5, _y = 0.5;
+        uint32_t _rgb = 0;
+        EspalexaColorMode _mode = EspalexaColorMode::xy;
+
+    public:
+        [[gnu::noinline]] uint32_t getRGB()
+        {
+            if (_rgb != 0) return _rgb; //color has not changed
+            byte rgb[4]{0, 0, 0, 0};
+
+            if (_mode == EspalexaColorMode::none) return 0;
+
+            if (_mode == EspalexaColorMode::ct)
+            {
+                float temp = 10000 / _ct; //kelvins = 1,000,000/mired (and that /100)
+                float r, g, b;
+
+                if (temp <= 66)
+                {
+                    r = 255;
+                    g = temp;
+                    g = 99.470802 * log(g) - 161.119568;
+                    if (temp <= 19)
+                    {
+                        b = 0;
+                    }
+                    else
+                    {
+                        b = temp - 10;
+                        b = 138.517731 * log(b) - 305.044793;
+                    }
+                }
+                else
+                {
+                    r = temp - 60;
+                    r = 329.698727 * pow(r, -0.13320476);
+                    g = temp - 60;
+                    g = 288.12217 * pow(g, -0.07551485);
+                    b = 255;
+                }
+
+                rgb[0] = (byte)constrain(r, 0.1, 255.1);
+                rgb[1] = (byte)constrain(g, 0.1, 255.1);
+                rgb[2] = (byte)constrain(b, 0.1, 255.1);
+            }
+            else if (_mode == EspalexaColorMode::hs)
+            {
+                float h = ((float)_hue) / 65535.0;
+                float s = ((float)_sat) / 255.0;
+                byte i = floor(h * 6);
+                float f = h * 6 - i;
+                float p = 255 * (1 - s);
+                float q = 255 * (1 - f * s);
+                float t = 255 * (1 - (1 - f) * s);
+                switch (i % 6)
+                {
+                case 0: rgb[0] = 255, rgb[1] = t, rgb[2] = p; break;
+                case 1: rgb[0] = q, rgb[1] = 255, rgb[2] = p; break;
+                case 2: rgb[0] = p, rgb[1] = 255, rgb[2] = t; break;
+                case 3: rgb[0] = p, rgb[1] = q, rgb[2] = 255; break;
+                case 4: rgb[0] = t, rgb[1] = p, rgb[2] = 255; break;
+                case 5: rgb[0] = 255, rgb[1] = p, rgb[2] = q;
+                }
+            }
+            else if (_mode == EspalexaColorMode::xy)
+            {
+                float z = 1.0f - _x - _y;
+                float X = (1.0f / _y) * _x;
+                float Z = (1.0f / _y) * z;
+                float r = (int)255 * (X * 1.656492f - 0.354851f - Z * 0.255038f);
+                float g = (int)255 * (-X * 0.707196f + 1.655397f + Z * 0.036152f);
+                float b = (int)255 * (X * 0.051713f - 0.121364f + Z * 1.011530f);
+                if (r > b && r > g && r > 1.0f)
+                {
+                    g = g / r;
+                    b = b / r;
+                    r = 1.0f;
+                }
+                else if (g > b && g > r && g > 1.0f)
+                {
+                    r = r / g;
+                    b = b / g;
+                    g = 1.0f;
+                }
+                else if (b > r && b > g && b > 1.0f)
+                {
+                    r = r / b;
+                    g = g / b;
+                    b = 1.0f;
+                }
+                r = r <= 0.0031308f ? 12.92f * r : (1.0f + 0.055f) * pow(r, (1.0f / 2.4f)) - 0.055f;
+                g = g <= 0.0031308f ? 12.92f * g : (1.0f + 0.055f) * pow(g, (1.0f / 2.4f)) - 0.055f;
+                b = b <= 0.0031308f ? 12.92f * b : (1.0f + 0.055f) * pow(b, (1.0f / 2.4f)) - 0.055f;
+
+                if (r > b && r > g)
+                {
+                    if (r > 1.0f)
+                    {
+                        g = g / r;
+                        b = b / r;
+                        r = 1.0f;
+                    }
+                }
+                else if (g > b && g > r)
+                {
+                    if (g > 1.0f)
+                    {
+                        r = r / g;
+                        b = b / g;
+                        g = 1.0f;
+                    }
+                }
+                else if (b > r && b > g)
+                {
+                    if (b > 1.0f)
+                    {
+                        r = r / b;
+                        g = g / b;
+                        b = 1.0f;
+                    }
+                }
+                rgb[0] = 255.0 * r;
+                rgb[1] = 255.0 * g;
+                rgb[2] = 255.0 * b;
+            }
+            _rgb = ((rgb[0] << 16) | (rgb[1] << 8) | (rgb[2]));
+            return _rgb;
+        }
+
+        uint8_t getW() { return (getRGB() >> 24) & 0xFF; }
+        uint8_t getR() { return (getRGB() >> 16) & 0xFF; }
+        uint8_t getG() { return (getRGB() >> 8) & 0xFF; }
+        uint8_t getB() { return getRGB() & 0xFF; }
+
+        [[gnu::noinline]] void setColorXY(const float x, const float y)
+        {
+            _x = x;
+            _y = y;
+            _rgb = 0;
+            _mode = EspalexaColorMode::xy;
+        }
+
+        [[gnu::noinline]] void setColor(const uint16_t hue, const uint8_t sat)
+        {
+            _hue = hue;
+            _sat = sat;
+            _rgb = 0;
+            _mode = EspalexaColorMode::hs;
+        }
+
+        [[gnu::noinline]] void setColor(const uint16_t ct)
+        {
+            _ct = ct;
+            _rgb = 0;
+            _mode = EspalexaColorMode::ct;
+        }
+    };
+
+    /**
+     * What a DeviceCallbackFunction does with the color: reads every channel.
+     */
+    template <typename TDevice>
+    uint32_t readBack(TDevice& device)
+    {
+        return device.getR() << 24 | device.getG() << 16 | device.getB() << 8 | device.getW();
+    }
+
+    template <typename TDevice>
+    uint32_t hsCommand(TDevice& device, const uint32_t step)
+    {
+        device.setColor(static_cast<uint16_t>(step * 7), static_cast<uint8_t>(step));
+        return readBack(device);
+    }
+
+    template <typename TDevice>
+    uint32_t ctCommand(TDevice& device, const uint32_t step)
+    {
+        device.setColor(static_cast<uint16_t>(153 + step % 348));
+        return readBack(device);
+    }
+
+    template <typename TDevice>
+    uint32_t xyCommand(TDevice& device, const uint32_t step)
+    {
+        device.setColorXY(0.05f + (step % 64) * 0.01f, 0.05f + (step / 64 % 64) * 0.01f);
+        return readBack(device);
+    }
+
+    void checkIdentical(EspalexaDevice& device, LegacyDevice& legacy)
+    {
+        unsigned long differences = 0;
+        for (uint32_t hue = 0; hue <= 0xFFFF; ++hue)
+        {
+            for (uint32_t sat = 0; sat <= 0xFF; ++sat)
+            {
+                device.setColor(static_cast<uint16_t>(hue), static_cast<uint8_t>(sat));
+                legacy.setColor(static_cast<uint16_t>(hue), static_cast<uint8_t>(sat));
+                differences += readBack(device) != readBack(legacy);
+            }
+        }
+        for (uint32_t step = 0; step < 348; ++step)
+            differences += ctCommand(device, step) != ctCommand(legacy, step);
+        for (uint32_t step = 0; step < 64 * 64; ++step)
+            differences += xyCommand(device, step) != xyCommand(legacy, step);
+        std::printf("colors: %lu differences from the previous code\n", differences);
+        CHECK(differences == 0);
+    }
+
+    template <typename TCommand>
+    double nanosecondsPerCommand(const unsigned rounds, TCommand command)
+    {
+        constexpr uint32_t STEPS = 4096;
+        uint32_t sum = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (unsigned round = 0; round < rounds; ++round)
+            for (uint32_t step = 0; step < STEPS; ++step)
+                sum += command(step + round);
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        sink = sum;
+        return std::chrono::duration<double, std::nano>(elapsed).count() / (rounds * STEPS);
+    }
+
+    template <typename TCommand>
+    void compare(const char* name, const unsigned rounds, EspalexaDevice& device, LegacyDevice& legacy,
+                 TCommand command)
+    {
+        // Interleaved runs, best of five, so frequency scaling affects both sides alike.
+        double legacyNs = 1e9;
+        double currentNs = 1e9;
+        for (int run = 0; run < 5; ++run)
+        {
+            legacyNs = std::min(legacyNs, nanosecondsPerCommand(rounds, [&](const uint32_t step)
+            {
+                return command(legacy, step);
+            }));
+            currentNs = std::min(currentNs, nanosecondsPerCommand(rounds, [&](const uint32_t step)
+            {
+                return command(device, step);
+            }));
+        }
+        std::printf("%s command: previous %7.2f ns, current %7.2f ns, %.2fx\n", name, legacyNs, currentNs,
+                    legacyNs / currentNs);
+    }
+}
+
+int main(const int argc, char** argv)
+{
+    const unsigned rounds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 500;
+    EspalexaDevice device("bench", [](EspalexaDevice*) {}, EspalexaDeviceType::extendedcolor);
+    LegacyDevice legacy;
+
+    checkIdentical(device, legacy);
+
+    compare("hs", rounds, device, legacy, [](auto& target, const uint32_t step) { return hsCommand(target, step); });
+    compare("ct", rounds, device, legacy, [](auto& target, const uint32_t step) { return ctCommand(target, step); });
+    compare("xy", rounds, device, legacy, [](auto& target, const uint32_t step) { return xyCommand(target, step); });
+    return testResult("alexa_color_bench");
+}
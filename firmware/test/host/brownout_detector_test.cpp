@@ -0,0 +1,142 @@
+// Replays the supply voltage traces in traces/ (one reading per line, 10 ms apart, as SupplyMonitor samples)
+// through BrownoutDetector with the firmware's default thresholds, and checks when SUPPLY_VALID and DROP are
+// reported. traces/generate.py describes them and writes them before `make check` runs the test.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "brownout_detector.hh"
+#include "check.hh"
+
+namespace
+{
+    constexpr uint32_t SAMPLE_INTERVAL_MS = 10; // SupplyMonitor::SAMPLE_INTERVAL_MS
+
+    struct Replay
+    {
+        std::vector<float> volts;
+        std::vector<uint32_t> validMs; // when SUPPLY_VALID was reported
+        std::vector<uint32_t> noSupplyMs;
+        std::vector<uint32_t> dropMs;
+        std::vector<float> dropVolts; // trace reading at each drop
+    };
+
+    Replay replay(const char* name)
+    {
+        Replay result;
+        const std::string path = std::string("traces/") + name;
+        FILE* trace = std::fopen(path.c_str(), "r");
+        CHECK_MSG(trace, "cannot open %s", path.c_str());
+        if (!trace) return result;
+        char line[64];
+        while (std::fgets(line, sizeof(line), trace))
+        {
+            float volts;
+            if (line[0] != '#' && std::sscanf(line, "%f", &volts) == 1)
+                result.volts.push_back(volts);
+        }
+        std::fclose(trace);
+
+        BrownoutDetector detector;
+        for (size_t i = 0; i < result.volts.size(); ++i)
+        {
+            const auto ms = static_cast<uint32_t>(i * SAMPLE_INTERVAL_MS);
+            switch (detector.sample(result.volts[i], SAMPLE_INTERVAL_MS))
+            {
+            case BrownoutDetector::Event::SUPPLY_VALID:
+                result.validMs.push_back(ms);
+                break;
+            case BrownoutDetector::Event::NO_SUPPLY:
+                result.noSupplyMs.push_back(ms);
+                break;
+            case BrownoutDetector::Event::DROP:
+                result.dropMs.push_back(ms);
+                result.dropVolts.push_back(result.volts[i]);
+                break;
+            case BrownoutDetector::Event::NONE:
+                break;
+            }
+        }
+        std::printf("%-16s %5zu samples, valid at %s ms, %zu drop(s)", name, result.volts.size(),
+                    result.validMs.empty() ? "-" : std::to_string(result.validMs.front()).c_str(),
+                    result.dropMs.size());
+        for (size_t i = 0; i < result.dropMs.size(); ++i)
+            std::printf(" [%u ms, %.2f V]", result.dropMs[i], result.dropVolts[i]);
+        std::printf("\n");
+        return result;
+    }
+
+    void supplyValidOnceAfterSettling(const Replay& replay)
+    {
+        CHECK(replay.noSupplyMs.empty());
+        CHECK(replay.validMs.size() == 1);
+        if (!replay.validMs.empty())
+            CHECK(replay.validMs.front() < 1000);
+    }
+
+    /**
+     * LED load steps on a healthy supply are not drops.
+     */
+    void testNominal()
+    {
+        const auto result = replay("nominal.txt");
+        supplyValidOnceAfterSettling(result);
+        CHECK(result.dropMs.empty());
+    }
+
+    /**
+     * An adapter sagging over a minute is reported once, when it passes 85 % of the 12 V it settled at
+     * (10.2 V, 55 s into the trace), however slowly it gets there.
+     */
+    void testSlowSag()
+    {
+        const auto result = replay("slow_sag.txt");
+        supplyValidOnceAfterSettling(result);
+        CHECK(result.dropMs.size() == 1);
+        if (!result.dropMs.empty())
+            CHECK_MSG(result.dropMs.front() >= 53000 && result.dropMs.front() <= 57000, "drop at %u ms",
+                      result.dropMs.front());
+    }
+
+    /**
+     * A cut supply is reported once, within 30 ms and while the rail is still well above the regulator's
+     * dropout, which leaves the writer task time to commit.
+     */
+    void testCollapse()
+    {
+        constexpr uint32_t CUT_MS = 5000;
+        const auto result = replay("collapse.txt");
+        supplyValidOnceAfterSettling(result);
+        CHECK(result.dropMs.size() == 1);
+        if (!result.dropMs.empty())
+        {
+            CHECK_MSG(result.dropMs.front() >= CUT_MS && result.dropMs.front() <= CUT_MS + 30, "drop at %u ms",
+                      result.dropMs.front());
+            CHECK(result.dropVolts.front() >= 8.0f);
+        }
+    }
+
+    /**
+     * Without a plausible supply reading the detector stays disarmed and says so once, after settling, so
+     * SupplyMonitor can stop sampling every 10 ms.
+     */
+    void testUsbPowered()
+    {
+        const auto result = replay("usb_powered.txt");
+        CHECK(result.validMs.empty());
+        CHECK(result.dropMs.empty());
+        CHECK(result.noSupplyMs.size() == 1);
+        if (!result.noSupplyMs.empty())
+            CHECK(result.noSupplyMs.front() < 1000);
+    }
+}
+
+int main()
+{
+    testNominal();
+    testSlowSag();
+    testCollapse();
+    testUsbPowered();
+    return testResult("brownout_detector_test");
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+/**
+ * Minimal assertions for the host tests: a failed check is reported with its location and the test exits
+ * non-zero at the end, so `make check` fails.
+ */
+inline int failedChecks = 0;
+
+#define CHECK(condition)                                                                        \
+    do                                                                                          \
+    {                                                                                           \
+        if (!(condition))                                                                       \
+        {                                                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);  \
+            ++failedChecks;                                                                     \
+        }                                                                                       \
+    } while (false)
+
+#define CHECK_MSG(condition, ...)                                                               \
+    do                                                                                          \
+    {                                                                                           \
+        if (!(condition))                                                                       \
+        {                                                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed: ", __FILE__, __LINE__, #condition);  \
+            std::fprintf(stderr, __VA_ARGS__);                                                  \
+            std::fputc('\n', stderr);                                                           \
+            ++failedChecks;                                                                     \
+        }                                                                                       \
+    } while (false)
+
+inline int testResult(const char* name)
+{
+    if (failedChecks)
+        std::fprintf(stderr, "%s: %d check(s) failed\n", name, failedChecks);
+    else
+        std::printf("%s: ok\n", name);
+    return failedChecks ? EXIT_FAILURE : EXIT_SUCCESS;
+}
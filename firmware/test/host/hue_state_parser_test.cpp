@@ -0,0 +1,226 @@
+// Host test and fuzz driver for HueStateParser: known good and malformed bodies, every truncation of the good
+// ones, then random mutations. Each body is copied into a buffer of exactly its length so AddressSanitizer
+// catches any read past the end. `hue_state_parser_test [iterations] [seed]`
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "check.hh"
+#include "hue_state_parser.hh"
+
+namespace
+{
+    bool parse(const std::string& body, HueStateCommand& command)
+    {
+        // No terminator and nothing after the last byte: the parser must stay within `length`.
+        auto* buffer = static_cast<char*>(std::malloc(body.size() ? body.size() : 1));
+        std::memcpy(buffer, body.data(), body.size());
+        const bool parsed = HueStateParser::parse(buffer, body.size(), command);
+        std::free(buffer);
+        return parsed;
+    }
+
+    bool parse(const std::string& body)
+    {
+        HueStateCommand command;
+        return parse(body, command);
+    }
+
+    const std::vector<std::string> VALID = {
+        R"({})",
+        R"({"on":true})",
+        R"({"on":false,"bri":1})",
+        R"({"bri":254,"hue":1000,"sat":200})",
+        R"({"xy":[0.3,0.4]})",
+        R"({"ct":300,"transitiontime":4})",
+        R"({"devicetype":"Echo#livingroom"})",
+        R"({"unknown":{"a":[1,2,{"b":null}],"c":"}"},"on":true})",
+        R"( { "on" : true , "bri" : 1.5e2 } )",
+        "{\r\n\t\"hue\": 65535\r\n}",
+        R"({"name":"a \"quoted\" \\ value","bri":-3})",
+        R"({"averyveryverylongkeythatistruncated":1,"sat":0})",
+    };
+
+    const std::vector<std::string> MALFORMED = {
+        "",
+        " ",
+        "{",
+        "}",
+        "[]",
+        "null",
+        R"({"on"})",
+        R"({"on":})",
+        R"({"on":tru})",
+        R"({"on":True})",
+        R"({"on":true,})",
+        R"({"on":true}})",
+        R"({"on":true} x)",
+        R"({"on":true}{"on":false})",
+        R"({on:true})",
+        R"({'on':true})",
+        R"({"on" true})",
+        R"({"on":true "bri":1})",
+        R"({"bri":-})",
+        R"({"bri":1.})",
+        R"({"bri":.5})",
+        R"({"bri":1e})",
+        R"({"bri":1e+})",
+        R"({"bri":01})",
+        R"({"bri":+1})",
+        R"({"bri":"1"})",
+        R"({"xy":[0.3]})",
+        R"({"xy":[0.3,0.4,0.5]})",
+        R"({"xy":[2,0.4]})",
+        R"({"xy":[0.3,0]})",
+        R"({"xy":0.3})",
+        R"({"devicetype":1})",
+        R"({"a":"unterminated})",
+        R"({"a":"\)",
+        R"({"a":[1,2})",
+        R"({"a":{"b"}})",
+        R"({"a":{1:2}})",
+        R"({"a":[[[[[[[[[[[[1]]]]]]]]]]]]})",
+        "{\"on\":true\x01}",
+    };
+
+    void testValidBodies()
+    {
+        for (const auto& body : VALID)
+            CHECK_MSG(parse(body), "%s", body.c_str());
+
+        HueStateCommand command;
+        CHECK(parse(R"({"bri":254,"hue":1000,"sat":200})", command));
+        CHECK(command.has(HueStateCommand::BRI) && command.bri == 254);
+        CHECK(command.has(HueStateCommand::HUE) && command.hue == 1000);
+        CHECK(command.has(HueStateCommand::SAT) && command.sat == 200);
+        CHECK(!command.has(HueStateCommand::ON));
+
+        CHECK(parse(R"({"xy":[0.3,0.4],"transitiontime":4})", command));
+        CHECK(command.has(HueStateCommand::XY) && command.x > 0.29f && command.x < 0.31f);
+        CHECK(command.has(HueStateCommand::TRANSITION_TIME) && command.transitionTime == 4);
+
+        CHECK(parse(R"( { "on" : true , "bri" : 1.5e2 } )", command));
+        CHECK(command.on && command.bri == 150);
+
+        CHECK(parse(R"({"devicetype":"Echo"})", command));
+        CHECK(command.has(HueStateCommand::DEVICE_TYPE));
+    }
+
+    void testClamping()
+    {
+        HueStateCommand command;
+        CHECK(parse(R"({"bri":300,"sat":-5,"ct":100,"hue":70000})", command));
+        CHECK(command.bri == 254);
+        CHECK(command.sat == 0);
+        CHECK(command.ct == 153);
+        CHECK(command.hue == 65535);
+
+        CHECK(parse(R"({"ct":1e30,"bri":1e-30})", command));
+        CHECK(command.ct == 500);
+        CHECK(command.bri == 0);
+    }
+
+    void testKeysInsideValuesAreIgnored()
+    {
+        HueStateCommand command;
+        CHECK(parse(R"({"name":"\"on\":true,\"bri\":9","other":{"on":true}})", command));
+        CHECK(command.fields == 0);
+    }
+
+    void testTrailingTerminatorIsAccepted()
+    {
+        // The body pool hands over the NUL-terminated buffer; a length covering the terminator is fine.
+        CHECK(parse(std::string(R"({"on":true})") + '\0'));
+    }
+
+    void testMalformedBodies()
+    {
+        for (const auto& body : MALFORMED)
+        {
+            HueStateCommand command;
+            CHECK_MSG(!parse(body, command), "accepted: %s", body.c_str());
+        }
+    }
+
+    void testTruncatedBodies()
+    {
+        for (const auto& body : VALID)
+        {
+            const size_t complete = body.rfind('}') + 1;
+            for (size_t length = 0; length < complete; ++length)
+                CHECK_MSG(!parse(body.substr(0, length)), "accepted truncated: %s", body.substr(0, length).c_str());
+        }
+    }
+
+    std::string mutate(std::string body, std::mt19937& random)
+    {
+        static constexpr char ALPHABET[] = "{}[]\":,\\ .-+eE0123456789truefalsnl\x00\xff";
+        const unsigned mutations = 1 + random() % 4;
+        for (unsigned i = 0; i < mutations; ++i)
+        {
+            const size_t position = body.empty() ? 0 : random() % body.size();
+            const char c = ALPHABET[random() % (sizeof(ALPHABET) - 1)];
+            switch (random() % 5)
+            {
+            case 0:
+                if (!body.empty()) body[position] = c;
+                break;
+            case 1:
+                body.insert(body.begin() + static_cast<long>(position), c);
+                break;
+            case 2:
+                if (!body.empty()) body.erase(position, 1 + random() % 3);
+                break;
+            case 3:
+                body.resize(position);
+                break;
+            default:
+                body.insert(position, body.substr(position, random() % 8));
+                break;
+            }
+        }
+        return body;
+    }
+
+    void fuzz(const unsigned long iterations, const unsigned long seed)
+    {
+        std::mt19937 random(seed);
+        std::vector<std::string> corpus = VALID;
+        corpus.insert(corpus.end(), MALFORMED.begin(), MALFORMED.end());
+
+        for (unsigned long i = 0; i < iterations; ++i)
+        {
+            const std::string body = mutate(corpus[random() % corpus.size()], random);
+            HueStateCommand first;
+            HueStateCommand second;
+            const bool parsed = parse(body, first);
+            CHECK(parsed == parse(body, second));
+            if (!parsed) continue;
+
+            CHECK(first.fields == second.fields);
+            CHECK(first.bri <= 254);
+            CHECK(first.sat <= 254);
+            CHECK(!first.has(HueStateCommand::CT) || (first.ct >= 153 && first.ct <= 500));
+            CHECK(!first.has(HueStateCommand::XY) || (first.x >= 0 && first.x <= 1 && first.y > 0 && first.y <= 1));
+        }
+    }
+}
+
+int main(const int argc, char** argv)
+{
+    const unsigned long iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    const unsigned long seed = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1;
+
+    testValidBodies();
+    testClamping();
+    testKeysInsideValuesAreIgnored();
+    testTrailingTerminatorIsAccepted();
+    testMalformedBodies();
+    testTruncatedBodies();
+    fuzz(iterations, seed);
+    return testResult("hue_state_parser_test");
+}
@@ -0,0 +1,185 @@
+// Host test for the SSDP NOTIFY announcements: a multicast listener on 239.255.255.250:1900 checks that
+// SsdpResponder sends ssdp:alive for every notification type on begin() and again every
+// SSDP_NOTIFY_INTERVAL_MS (shortened by the Makefile), stops while disabled, and sends ssdp:byebye from the
+// shutdown handler esp_restart() runs.
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstring>
+#include <netinet/in.h>
+#include <set>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "check.hh"
+#include "ssdp_notify.hh"
+#include "ssdp_responder.hh"
+
+namespace
+{
+    constexpr uint8_t BRIDGE_IP[4] = {192, 168, 1, 50};
+    constexpr auto BRIDGE_MAC = "a0b1c2d3e4f5";
+    constexpr auto UUID = "uuid:2f402f80-da50-11e1-9b23-a0b1c2d3e4f5";
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Notify
+    {
+        std::string text;
+        Clock::time_point received;
+
+        [[nodiscard]] std::string header(const char* name) const
+        {
+            const std::string key = std::string("\r\n") + name + ": ";
+            const size_t start = text.find(key);
+            if (start == std::string::npos) return {};
+            const size_t value = start + key.size();
+            return text.substr(value, text.find("\r\n", value) - value);
+        }
+    };
+
+    class MulticastListener
+    {
+        int socket = -1;
+
+    public:
+        MulticastListener()
+        {
+            socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+            const int enable = 1;
+            setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+            setsockopt(socket, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+            sockaddr_in local{};
+            local.sin_family = AF_INET;
+            local.sin_port = htons(1900);
+            local.sin_addr.s_addr = htonl(INADDR_ANY);
+            CHECK(bind(socket, reinterpret_cast<sockaddr*>(&local), sizeof(local)) == 0);
+            ip_mreq membership{};
+            membership.imr_multiaddr.s_addr = inet_addr("239.255.255.250");
+            membership.imr_interface.s_addr = htonl(INADDR_LOOPBACK);
+            CHECK(setsockopt(socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) == 0);
+        }
+
+        ~MulticastListener()
+        {
+            close(socket);
+        }
+
+        /**
+         * Collects NOTIFY messages until `count` arrived or `timeoutMs` passed; other SSDP traffic is skipped.
+         */
+        std::vector<Notify> receive(const size_t count, const int timeoutMs)
+        {
+            std::vector<Notify> received;
+            const auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+            while (received.size() < count)
+            {
+                const auto left = std::chrono::duration_cast<std::chrono::microseconds>(deadline - Clock::now());
+                if (left.count() <= 0) break;
+                timeval timeout{static_cast<time_t>(left.count() / 1000000),
+                                static_cast<suseconds_t>(left.count() % 1000000)};
+                setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                char buffer[1024];
+                const ssize_t length = recv(socket, buffer, sizeof(buffer), 0);
+                if (length <= 0) break;
+                std::string text(buffer, static_cast<size_t>(length));
+                if (text.rfind("NOTIFY * HTTP/1.1\r\n", 0) == 0)
+                    received.push_back({std::move(text), Clock::now()});
+            }
+            return received;
+        }
+    };
+
+    long elapsedMs(const Clock::time_point from, const Clock::time_point to)
+    {
+        return static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(to - from).count());
+    }
+
+    /**
+     * One message per notification type, each well-formed and carrying the expected NTS.
+     */
+    void checkRound(const std::vector<Notify>& round, const char* nts)
+    {
+        CHECK_MSG(round.size() == SsdpNotify::TYPE_COUNT, "%zu messages for %s", round.size(), nts);
+        std::set<std::string> types;
+        for (const auto& notify : round)
+        {
+            CHECK(notify.header("HOST") == "239.255.255.250:1900");
+            CHECK(notify.header("NTS") == nts);
+            CHECK(notify.header("CACHE-CONTROL") == "max-age=" + std::to_string(SsdpNotify::MAX_AGE_S));
+            CHECK(notify.header("LOCATION") == "http://192.168.1.50:80/description.xml");
+            CHECK(notify.header("hue-bridgeid") == BRIDGE_MAC);
+            CHECK(notify.text.size() >= 4 && notify.text.compare(notify.text.size() - 4, 4, "\r\n\r\n") == 0);
+
+            const std::string nt = notify.header("NT");
+            const std::string usn = notify.header("USN");
+            CHECK_MSG(usn == (nt == UUID ? nt : std::string(UUID) + "::" + nt), "NT %s, USN %s", nt.c_str(),
+                      usn.c_str());
+            types.insert(nt);
+        }
+        CHECK(types == (std::set<std::string>{"upnp:rootdevice", UUID, "urn:schemas-upnp-org:device:basic:1"}));
+    }
+}
+
+int main()
+{
+    static_assert(SSDP_NOTIFY_INTERVAL_MS < 1000, "build with a short -DSSDP_NOTIFY_INTERVAL_MS");
+    // The advertised lifetime must outlast several announcement intervals of the firmware default.
+    static_assert(SsdpNotify::MAX_AGE_S * 1000 >= 3 * 30000);
+
+    MulticastListener listener;
+
+    // Never destroyed: its task keeps running until the process exits.
+    auto* responder = new SsdpResponder(
+        [](char*, size_t) { return size_t{0}; },
+        [](char* buffer, const size_t size, const bool alive, const uint8_t index)
+        {
+            return SsdpNotify::render(buffer, size, alive, index, BRIDGE_IP, BRIDGE_MAC);
+        },
+        SsdpNotify::TYPE_COUNT);
+
+    const auto started = Clock::now();
+    CHECK(responder->begin());
+    const auto boot = listener.receive(SsdpNotify::TYPE_COUNT, 200);
+    checkRound(boot, "ssdp:alive");
+    if (!boot.empty())
+        CHECK_MSG(elapsedMs(started, boot.front().received) < 100, "first alive after %ld ms",
+                  elapsedMs(started, boot.front().received));
+
+    // Periodic announcements, each a full round one interval after the previous one.
+    for (int round = 0; round < 2 && !boot.empty(); ++round)
+    {
+        const auto previous = Clock::now();
+        const auto periodic = listener.receive(SsdpNotify::TYPE_COUNT, 3 * SSDP_NOTIFY_INTERVAL_MS);
+        checkRound(periodic, "ssdp:alive");
+        if (periodic.empty()) break;
+        const long waited = elapsedMs(previous, periodic.front().received);
+        CHECK_MSG(waited >= SSDP_NOTIFY_INTERVAL_MS / 2 && waited <= SSDP_NOTIFY_INTERVAL_MS * 3 / 2,
+                  "periodic alive after %ld ms", waited);
+    }
+
+    // A new IP (begin() again) announces right away instead of waiting for the interval.
+    const auto reannounced = Clock::now();
+    CHECK(responder->begin());
+    const auto afterIpChange = listener.receive(SsdpNotify::TYPE_COUNT, 200);
+    checkRound(afterIpChange, "ssdp:alive");
+    if (!afterIpChange.empty())
+        CHECK(elapsedMs(reannounced, afterIpChange.front().received) < 100);
+
+    // Not discoverable: no announcements, and no byebye for a bridge that was withdrawn.
+    responder->setEnabled(false);
+    CHECK(listener.receive(1, 2 * SSDP_NOTIFY_INTERVAL_MS).empty());
+    hostRunShutdownHandlers();
+    CHECK(listener.receive(1, 100).empty());
+
+    // Restart while discoverable: one byebye per notification type.
+    responder->setEnabled(true);
+    listener.receive(SsdpNotify::TYPE_COUNT, 3 * SSDP_NOTIFY_INTERVAL_MS); // drain the alive round it resumes with
+    hostRunShutdownHandlers();
+    checkRound(listener.receive(SsdpNotify::TYPE_COUNT, 200), "ssdp:byebye");
+
+    CHECK(responder->getStats().announcements >= 4);
+    return testResult("ssdp_notify_test");
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+// Host stand-in for the parts of the Arduino core used by the tested headers.
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <esp_log.h>
+
+typedef uint8_t byte;
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+class String : public std::string
+{
+public:
+    String(const char* text = "") : std::string(text) // NOLINT(google-explicit-constructor)
+    {
+    }
+};
+
+inline unsigned long millis()
+{
+    static const auto start = std::chrono::steady_clock::now();
+    return static_cast<unsigned long>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+/**
+ * Same layout as the core's: converts to a uint32_t holding the four bytes in network order in memory.
+ */
+class IPAddress
+{
+    uint8_t bytes[4] = {};
+
+public:
+    IPAddress() = default;
+
+    IPAddress(const uint8_t a, const uint8_t b, const uint8_t c, const uint8_t d) : bytes{a, b, c, d}
+    {
+    }
+
+    IPAddress(const uint32_t address) // NOLINT(google-explicit-constructor)
+    {
+        std::memcpy(bytes, &address, sizeof(bytes));
+    }
+
+    operator uint32_t() const // NOLINT(google-explicit-constructor)
+    {
+        uint32_t address;
+        std::memcpy(&address, bytes, sizeof(address));
+        return address;
+    }
+
+    uint8_t operator[](const int index) const
+    {
+        return bytes[index];
+    }
+};
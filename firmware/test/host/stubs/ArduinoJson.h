@@ -0,0 +1,20 @@
+#pragma once
+
+// Host stand-in: accepts and discards the values written by toJson() methods.
+
+struct JsonVariant
+{
+    template <typename T>
+    JsonVariant& operator=(const T&)
+    {
+        return *this;
+    }
+};
+
+struct JsonObject
+{
+    JsonVariant operator[](const char*) const
+    {
+        return {};
+    }
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+// Host stand-in for AsyncUDP on a POSIX socket. Only sending is implemented; received packets are not
+// dispatched to onPacket().
+
+#include <arpa/inet.h>
+#include <functional>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <Arduino.h>
+
+class AsyncUDPPacket
+{
+public:
+    const uint8_t* data() const { return nullptr; }
+    size_t length() const { return 0; }
+    IPAddress remoteIP() const { return {}; }
+    uint16_t remotePort() const { return 0; }
+};
+
+class AsyncUDP
+{
+    int socket = -1;
+    std::function<void(AsyncUDPPacket&)> handler;
+
+public:
+    ~AsyncUDP()
+    {
+        close();
+    }
+
+    bool listenMulticast(const IPAddress& address, const uint16_t port)
+    {
+        close();
+        socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+        if (socket < 0) return false;
+        const int enable = 1;
+        setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        setsockopt(socket, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+        const unsigned char loop = 1;
+        setsockopt(socket, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+        in_addr loopback{htonl(INADDR_LOOPBACK)};
+        setsockopt(socket, IPPROTO_IP, IP_MULTICAST_IF, &loopback, sizeof(loopback));
+
+        sockaddr_in local{};
+        local.sin_family = AF_INET;
+        local.sin_port = htons(port);
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(socket, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0)
+        {
+            close();
+            return false;
+        }
+        ip_mreq membership{};
+        membership.imr_multiaddr.s_addr = static_cast<uint32_t>(address);
+        membership.imr_interface = loopback;
+        if (setsockopt(socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0)
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void onPacket(std::function<void(AsyncUDPPacket&)> callback)
+    {
+        handler = std::move(callback);
+    }
+
+    size_t writeTo(const uint8_t* data, const size_t length, const IPAddress& address, const uint16_t port)
+    {
+        if (socket < 0) return 0;
+        sockaddr_in remote{};
+        remote.sin_family = AF_INET;
+        remote.sin_port = htons(port);
+        remote.sin_addr.s_addr = static_cast<uint32_t>(address);
+        const ssize_t sent = sendto(socket, data, length, 0, reinterpret_cast<sockaddr*>(&remote), sizeof(remote));
+        return sent > 0 ? static_cast<size_t>(sent) : 0;
+    }
+
+    void close()
+    {
+        if (socket >= 0) ::close(socket);
+        socket = -1;
+    }
+};
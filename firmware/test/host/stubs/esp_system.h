@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+
+typedef void (*shutdown_handler_t)();
+
+inline uint32_t esp_random()
+{
+    static std::mt19937 random(std::random_device{}());
+    return random();
+}
+
+inline shutdown_handler_t hostShutdownHandlers[8] = {};
+
+inline int esp_register_shutdown_handler(const shutdown_handler_t handler)
+{
+    for (auto& slot : hostShutdownHandlers)
+    {
+        if (!slot)
+        {
+            slot = handler;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Host only: what esp_restart() does before resetting the chip.
+ */
+inline void hostRunShutdownHandlers()
+{
+    for (const auto handler : hostShutdownHandlers)
+        if (handler) handler();
+}
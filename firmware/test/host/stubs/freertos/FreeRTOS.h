@@ -0,0 +1,15 @@
+#pragma once
+
+// Host stand-in: a 1 kHz tick, tasks on std::thread.
+
+#include <cstdint>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xffffffffu
+#define pdMS_TO_TICKS(ms) (static_cast<TickType_t>(ms))
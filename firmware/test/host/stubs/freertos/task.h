@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <freertos/FreeRTOS.h>
+
+struct HostTask
+{
+    std::mutex mutex;
+    std::condition_variable notified;
+    uint32_t notifications = 0;
+};
+
+typedef HostTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+inline HostTask*& hostCurrentTask()
+{
+    thread_local HostTask* task = nullptr;
+    return task;
+}
+
+/**
+ * The task runs detached for the rest of the process, like a FreeRTOS task that never returns.
+ */
+inline BaseType_t xTaskCreate(const TaskFunction_t function, const char*, uint32_t, void* argument, UBaseType_t,
+                              TaskHandle_t* handle)
+{
+    auto* task = new HostTask;
+    if (handle) *handle = task;
+    std::thread([function, argument, task]
+    {
+        hostCurrentTask() = task;
+        function(argument);
+    }).detach();
+    return pdPASS;
+}
+
+inline void xTaskNotifyGive(const TaskHandle_t task)
+{
+    {
+        std::lock_guard<std::mutex> lock(task->mutex);
+        ++task->notifications;
+    }
+    task->notified.notify_one();
+}
+
+inline uint32_t ulTaskNotifyTake(const BaseType_t clearOnExit, const TickType_t ticks)
+{
+    HostTask* task = hostCurrentTask();
+    std::unique_lock<std::mutex> lock(task->mutex);
+    const auto pending = [task] { return task->notifications > 0; };
+    if (ticks == portMAX_DELAY)
+        task->notified.wait(lock, pending);
+    else
+        task->notified.wait_for(lock, std::chrono::milliseconds(ticks), pending);
+    const uint32_t count = task->notifications;
+    if (count) task->notifications = clearOnExit ? 0 : count - 1;
+    return count;
+}
+
+inline void vTaskDelay(const TickType_t ticks)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
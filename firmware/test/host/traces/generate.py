@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""Writes the supply voltage traces replayed by brownout_detector_test.
+
+One reading per line, 10 ms apart, as SupplyMonitor samples them. The traces are modelled on the board, not
+captured from it: the GPIO34 divider reading (23.05 V full scale, 1 mV ADC steps after calibration, about
+50 mV of noise), a 12 V adapter, and the bulk capacitance discharging into the LED load once mains is cut.
+`make check` runs it before brownout_detector_test; the seed keeps the output stable, so only traces recorded
+on a device are committed.
+"""
+import math
+import random
+
+SAMPLE_MS = 10
+VOLTS_PER_MV = 23.05 / 2114  # Sensor::readVoltage() scale
+NOISE_VOLTS = 0.05
+
+random.seed(43)
+
+
+def reading(volts):
+    volts = max(0.0, volts + random.gauss(0.0, NOISE_VOLTS))
+    return round(volts / VOLTS_PER_MV) * VOLTS_PER_MV
+
+
+def write(name, description, volts):
+    with open(name, "w") as trace:
+        trace.write(f"# {description}\n")
+        for value in volts:
+            trace.write(f"{reading(value):.3f}\n")
+
+
+def seconds(s):
+    return int(s * 1000 / SAMPLE_MS)
+
+
+def nominal():
+    # 60 s on a healthy 12 V adapter, with the LEDs switching between off, full and half load.
+    volts = []
+    for i in range(seconds(60)):
+        t = i * SAMPLE_MS / 1000
+        load = 0.0 if t % 20 < 5 else 0.45 if t % 20 < 12 else 0.2
+        volts.append(12.1 - load)
+    return volts
+
+
+def slow_sag():
+    # 10 s at 12 V, then an overloaded adapter sags linearly to 9.6 V over 60 s and stays there.
+    volts = [12.0] * seconds(10)
+    volts += [12.0 - 2.4 * i / seconds(60) for i in range(seconds(60))]
+    volts += [9.6] * seconds(10)
+    return volts
+
+
+def collapse():
+    # 5 s at 12 V, then mains is cut: the bulk capacitance discharges into the LEDs (time constant 60 ms).
+    volts = [12.0] * seconds(5)
+    volts += [12.0 * math.exp(-i * SAMPLE_MS / 60) for i in range(seconds(1))]
+    return volts
+
+
+def usb_powered():
+    # USB powered, divider not fitted: the input floats around 0.2 V.
+    return [0.2] * seconds(10)
+
+
+write("nominal.txt", "healthy 12 V supply with LED load steps, 60 s", nominal())
+write("slow_sag.txt", "12 V for 10 s, then a linear sag to 9.6 V over 60 s", slow_sag())
+write("collapse.txt", "12 V for 5 s, then the supply is cut (60 ms discharge)", collapse())
+write("usb_powered.txt", "no supply divider reading (USB powered)", usb_powered())